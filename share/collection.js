@@ -27,7 +27,13 @@ var c4 =
   config:
   {
     width: 324,
-    height: 200
+    height: 200,
+    /* One of "average", "min", "max", "minmax" and "lttb". "minmax" and
+     * "lttb" keep spikes visible in zoomed out views. */
+    consolidation: "average",
+    /* Maximum number of instances per "multi_instance_data_json" request,
+     * see SELECTORS_MAX in src/action_multi_instance_data_json.c. */
+    multi_max: 256
   }
 };
 
@@ -415,6 +421,134 @@ function inst_redraw (inst, def, data_list) /* {{{ */
   inst.chart.redraw ();
 } /* }}} function inst_redraw */
 
+/*
+ * Decoding of the binary data format. See "ident_data_to_binary" in
+ * src/graph_ident.h for a description of the layout.
+ */
+function binary_supported () /* {{{ */
+{
+  return ((typeof (ArrayBuffer) != "undefined")
+      && (typeof (DataView) != "undefined")
+      && (typeof (Float32Array) != "undefined")
+      && (typeof (Float64Array) != "undefined")
+      && (typeof (XMLHttpRequest) != "undefined")
+      && ("responseType" in new XMLHttpRequest ()));
+} /* }}} function binary_supported */
+
+function binary_decode_string (bytes) /* {{{ */
+{
+  var str = "";
+  var i;
+
+  if (typeof (TextDecoder) != "undefined")
+    return (new TextDecoder ("utf-8").decode (bytes));
+
+  for (i = 0; i < bytes.length; i++)
+    str += String.fromCharCode (bytes[i]);
+
+  /* Convert the UTF-8 byte sequence to a JavaScript string. */
+  try
+  {
+    return (decodeURIComponent (escape (str)));
+  }
+  catch (e)
+  {
+    return (str);
+  }
+} /* }}} function binary_decode_string */
+
+function binary_decode (buffer) /* {{{ */
+{
+  var view = new DataView (buffer);
+  var data_list = new Array ();
+  var value_size;
+  var pos;
+
+  if ((buffer.byteLength < 8)
+      || (binary_decode_string (new Uint8Array (buffer, 0, 4)) != "C4DS")
+      || (view.getUint8 (4) != 1))
+    return (null);
+
+  value_size = view.getUint8 (5);
+  if ((value_size != 4) && (value_size != 8))
+    return (null);
+
+  pos = 8;
+  while ((pos + 24) <= buffer.byteLength)
+  {
+    var record_size = view.getUint32 (pos, /* little endian = */ true);
+    var values_num = view.getUint32 (pos + 4, true);
+    var strings = new Array ();
+    var values;
+    var str_pos;
+    var i;
+
+    if ((record_size < 24) || ((pos + record_size) > buffer.byteLength))
+      return (null);
+
+    str_pos = pos + 24;
+    for (i = 0; i < 6; i++)
+    {
+      var len = view.getUint16 (str_pos, true);
+      strings.push (binary_decode_string (new Uint8Array (buffer,
+              str_pos + 2, len)));
+      str_pos += 2 + len;
+    }
+    str_pos = pos + (Math.ceil ((str_pos - pos) / 8) * 8);
+
+    if (value_size == 4)
+      values = new Float32Array (buffer, str_pos, values_num);
+    else
+      values = new Float64Array (buffer, str_pos, values_num);
+
+    var data = new Array ();
+    for (i = 0; i < values_num; i++)
+      data.push (isNaN (values[i]) ? null : values[i]);
+
+    data_list.push (
+        {
+          file:
+          {
+            host: strings[0],
+            plugin: strings[1],
+            plugin_instance: strings[2],
+            type: strings[3],
+            type_instance: strings[4]
+          },
+          data_source: strings[5],
+          first_value_time: view.getFloat64 (pos + 8, true),
+          interval: view.getFloat64 (pos + 16, true),
+          data: data
+        });
+
+    pos += record_size;
+  }
+
+  return (data_list);
+} /* }}} function binary_decode */
+
+function binary_fetch_data (params, callback) /* {{{ */
+{
+  var req = new XMLHttpRequest ();
+
+  params.format = "binary";
+
+  req.open ("GET", "collection.fcgi?" + $.param (params), /* async = */ true);
+  req.responseType = "arraybuffer";
+  req.onload = function ()
+  {
+    var data_list;
+
+    if (req.status != 200)
+      return;
+
+    data_list = binary_decode (req.response);
+    if (data_list)
+      callback (data_list);
+  };
+  req.send (null);
+} /* }}} function binary_fetch_data */
+
 function inst_fetch_data (inst, begin, end) /* {{{ */
 {
   var def;
@@ -429,6 +563,17 @@ function inst_fetch_data (inst, begin, end) /* {{{ */
   params.begin = begin || inst.begin;
   params.end = end || inst.end;
   params.resolution = (params.end - params.begin) / c4.config.width;
+  params.consolidation = c4.config.consolidation;
+
+  if (binary_supported ())
+  {
+    binary_fetch_data (params,
+        function (data)
+        {
+          inst_redraw (inst, def, data);
+        });
+    return;
+  }
 
   $.getJSON ("collection.fcgi", params,
       function (data)
@@ -437,6 +582,98 @@ function inst_fetch_data (inst, begin, end) /* {{{ */
       }); /* getJSON */
 } /* }}} inst_fetch_data */
 
+/* Fetches the data of the instances in "group", which all share the same time
+ * range, with one request. */
+function multi_fetch_group (group) /* {{{ */
+{
+  var params = new Object ();
+  var i;
+
+  if (group[0].inst.begin && group[0].inst.end)
+  {
+    params.begin = group[0].inst.begin;
+    params.end = group[0].inst.end;
+    params.resolution = (params.end - params.begin) / c4.config.width;
+  }
+  params.consolidation = c4.config.consolidation;
+
+  for (i = 0; i < group.length; i++)
+  {
+    var inst_params = instance_get_params (group[i].inst);
+    var name;
+
+    for (name in inst_params)
+      params[i + "." + name] = inst_params[name];
+  }
+
+  /* POST, because the parameters of a large dashboard don't fit in a
+   * URL. */
+  $.ajax ({
+    type: "POST",
+    url: "collection.fcgi?action=multi_instance_data_json",
+    data: params,
+    dataType: "json",
+    success: function (data)
+    {
+      var j;
+
+      if (!data)
+        return;
+
+      for (j = 0; (j < group.length) && (j < data.length); j++)
+        if (data[j])
+          inst_redraw (group[j].inst, group[j].def, data[j]);
+    }
+  });
+} /* }}} function multi_fetch_group */
+
+/* Fetches the data of several instances with as few requests as possible.
+ * Instances are grouped by time range, since the server applies one range to
+ * all instances of a request. */
+function multi_fetch_data (instances) /* {{{ */
+{
+  var groups = new Object ();
+  var key;
+  var i;
+
+  for (i = 0; i < instances.length; i++)
+  {
+    var inst = instances[i];
+    var def = inst_get_defs (inst);
+
+    if (!def)
+      continue;
+
+    key = inst.begin + ":" + inst.end;
+    if (!groups[key])
+      groups[key] = new Array ();
+    groups[key].push ({ inst: inst, def: def });
+  }
+
+  for (key in groups)
+  {
+    var group = groups[key];
+
+    /* The server ignores instances beyond its limit, so large groups are
+     * split into several requests. */
+    for (i = 0; i < group.length; i += c4.config.multi_max)
+      multi_fetch_group (group.slice (i, i + c4.config.multi_max));
+  }
+} /* }}} function multi_fetch_data */
+
+function json_graph_update_all () /* {{{ */
+{
+  var i;
+
+  for (i = 0; i < c4.instances.length; i++)
+  {
+    if (!c4.instances[i].container)
+      c4.instances[i].container = "c4-graph" + i;
+  }
+
+  multi_fetch_data (c4.instances);
+} /* }}} json_graph_update_all */
+
 function json_graph_update (index) /* {{{ */
 {
   var inst;
@@ -722,11 +959,7 @@ $(document).ready(function() {
 
     graph_recalc_width ();
 
-    var i;
-    for (i = 0; i < c4.instances.length; i++)
-    {
-      json_graph_update (i);
-    }
+    json_graph_update_all ();
 });
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -26,22 +26,30 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <dirent.h> /* for PATH_MAX */
 #include <assert.h>
 #include <math.h>
+#include <unistd.h>
 
 #include <rrd.h>
 
 #include "common.h"
 #include "action_graph.h"
 #include "graph.h"
+#include "graph_config.h"
+#include "graph_ident.h"
 #include "graph_instance.h"
 #include "graph_list.h"
+#include "graph_svg.h"
 #include "utils_cgi.h"
 #include "utils_array.h"
+#include "utils_filecache.h"
+#include "utils_renderpool.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
@@ -49,9 +57,18 @@
 struct graph_data_s
 {
   rrd_args_t *args;
-  rrd_info_t *info;
+  int argc;
+  char **argv;
   time_t mtime;
   time_t expires;
+  char etag[64];
+  /* Key of the image in the render cache. */
+  uint64_t cache_key;
+  int width;
+  int height;
+  _Bool svg;
+  /* Render with "graph_svg_render" instead of librrd. */
+  _Bool internal;
   long now;
   long begin;
   long end;
@@ -62,93 +79,351 @@ static void emulate_graph (int argc, char **argv) /* {{{ */
 {
   int i;
 
-  printf ("rrdtool \\\n");
+  resp_printf ("rrdtool \\\n");
   for (i = 0; i < argc; i++)
   {
     if (i < (argc - 1))
-      printf ("  \"%s\" \\\n", argv[i]);
+      resp_printf ("  \"%s\" \\\n", argv[i]);
     else
-      printf ("  \"%s\"\n", argv[i]);
+      resp_printf ("  \"%s\"\n", argv[i]);
   }
 } /* }}} void emulate_graph */
 
-static int ag_info_print (rrd_info_t *info) /* {{{ */
-{
-  if (info->type == RD_I_VAL)
-    printf ("[info] %s = %g;\n", info->key, info->value.u_val);
-  else if (info->type == RD_I_CNT)
-    printf ("[info] %s = %lu;\n", info->key, info->value.u_cnt);
-  else if (info->type == RD_I_STR)
-    printf ("[info] %s = %s;\n", info->key, info->value.u_str);
-  else if (info->type == RD_I_INT)
-    printf ("[info] %s = %i;\n", info->key, info->value.u_int);
-  else if (info->type == RD_I_BLO)
-    printf ("[info] %s = [blob, %lu bytes];\n", info->key, info->value.u_blo.size);
-  else
-    printf ("[info] %s = [unknown type %#x];\n", info->key, info->type);
+int graph_param_get_size (const char *name, int default_value) /* {{{ */
+{
+  const char *tmp;
+  char *endptr;
+  long value;
+
+  tmp = param (name);
+  if (tmp == NULL)
+    return (default_value);
+
+  errno = 0;
+  endptr = NULL;
+  value = strtol (tmp, &endptr, /* base = */ 10);
+  if ((errno != 0) || (endptr == tmp))
+    return (default_value);
+
+  if (value < GRAPH_SIZE_MIN)
+    return (GRAPH_SIZE_MIN);
+  else if (value > GRAPH_SIZE_MAX)
+    return (GRAPH_SIZE_MAX);
+  return ((int) value);
+} /* }}} int graph_param_get_size */
+
+/* The "format" parameter selects "png" (the default) or "svg". */
+static _Bool param_want_svg (void) /* {{{ */
+{
+  const char *tmp;
 
-  return (0);
-} /* }}} int ag_info_print */
+  tmp = param ("format");
+  if (tmp == NULL)
+    return (0);
+
+  return (strcasecmp ("svg", tmp) == 0);
+} /* }}} _Bool param_want_svg */
 
-static int output_graph (graph_data_t *data) /* {{{ */
+/* The "renderer" parameter selects "rrdtool" (the default) or "internal". */
+static _Bool param_want_internal (void) /* {{{ */
+{
+  const char *tmp;
+
+  tmp = param ("renderer");
+  if (tmp == NULL)
+    return (0);
+
+  return (strcasecmp ("internal", tmp) == 0);
+} /* }}} _Bool param_want_internal */
+
+void graph_print_expires (long now, long begin, long end, /* {{{ */
+    int width)
 {
-  rrd_info_t *img;
   char time_buffer[256];
   time_t expires;
   int status;
 
-  for (img = data->info; img != NULL; img = img->next)
-    if ((strcmp ("image", img->key) == 0)
-        && (img->type == RD_I_BLO))
-      break;
+  if (end >= now)
+  {
+    /* The end of the timespan can be seen. */
+    long secs_per_pixel;
+
+    secs_per_pixel = (end - begin) / ((width > 0) ? width : 1);
+
+    expires = (time_t) (now + secs_per_pixel);
+  }
+  else /* if (end < now) */
+  {
+    expires = (time_t) (now + 86400);
+  }
+  status = time_to_rfc1123 (expires, time_buffer, sizeof (time_buffer));
+  if (status == 0)
+    resp_header ("Expires: %s", time_buffer);
+} /* }}} void graph_print_expires */
+
+/* Computes the entity tag of the graph and returns true if the client's copy
+ * is still current. The graph is determined by the graph and instance
+ * selectors, the configuration, the time span and the data. The entity tag
+ * also identifies the image in the render cache. */
+static _Bool check_not_modified (graph_config_t *cfg, /* {{{ */
+    graph_instance_t *inst, graph_data_t *data)
+{
+  graph_ident_t *selectors[2];
+  char buffer[256];
+  uint64_t hash;
+  size_t i;
+  int j;
+
+  selectors[0] = graph_get_selector (cfg);
+  selectors[1] = inst_get_selector (inst);
+
+  hash = http_etag_update (HTTP_ETAG_INIT, "graph");
+  for (i = 0; i < sizeof (selectors) / sizeof (selectors[0]); i++)
+  {
+    if (selectors[i] == NULL)
+      continue;
+
+    for (j = 0; j < _GIF_LAST; j++)
+    {
+      hash = http_etag_update (hash, "\037");
+      hash = http_etag_update (hash,
+          ident_get_field (selectors[i], (graph_ident_field_t) j));
+    }
+    ident_destroy (selectors[i]);
+  }
+
+  snprintf (buffer, sizeof (buffer),
+      "\037%li\037%li\037%li\037%li\037%ix%i\037%s\037%s",
+      data->begin, data->end, (long) data->mtime,
+      (long) graph_config_get_mtime (),
+      data->width, data->height, data->svg ? "svg" : "png",
+      data->internal ? "internal" : "rrdtool");
+  hash = http_etag_update (hash, buffer);
 
-  if (img == NULL)
+  http_etag_format (hash, data->etag, sizeof (data->etag));
+  return (http_check_conditional (data->etag, data->mtime));
+} /* }}} _Bool check_not_modified */
+
+static void output_headers (const graph_data_t *data, /* {{{ */
+    size_t content_length)
+{
+  /* Without a Content-Length header, SVG images are compressed on the
+   * fly. PNG images are compressed already. */
+  if (data->svg)
+    resp_header ("Content-Type: image/svg+xml");
+  else
+  {
+    resp_header ("Content-Type: image/png");
+    resp_header ("Content-Length: %lu", (unsigned long) content_length);
+  }
+  if (data->etag[0] != 0)
+    http_print_validators (data->etag, data->mtime);
+  print_time_args (data->begin, data->end);
+  graph_print_expires (data->now, data->begin, data->end, data->width);
+  resp_header ("X-Generator: "PACKAGE_STRING);
+} /* }}} void output_headers */
+
+/* Sends the image from the render cache, if it is there. Returns ENOENT
+ * otherwise. */
+static int output_cached (const graph_data_t *data) /* {{{ */
+{
+  size_t size;
+  int fd = -1;
+  int status;
+
+  /* Without an entity tag, e.g. without a time span, the image isn't
+   * identified by the request. */
+  if ((graph_config_get_render_cache_size () == 0) || (data->etag[0] == 0))
     return (ENOENT);
 
-  printf ("Content-Type: image/png\n"
-      "Content-Length: %lu\n",
-      img->value.u_blo.size);
-  if (data->mtime > 0)
+  status = filecache_open (graph_config_get_render_cache_dir (),
+      data->cache_key, &fd, &size);
+  if (status != 0)
+    return (status);
+
+  output_headers (data, size);
+
+  /* The headers are out already; all we can do is stop. */
+  status = resp_write_fd (fd, size);
+  if (status != 0)
+    fprintf (stderr, "output_cached: Reading cached image failed: %s\n",
+        strerror (status));
+
+  close (fd);
+  return (0);
+} /* }}} int output_cached */
+
+static void output_image (const graph_data_t *data, /* {{{ */
+    const char *image, size_t image_size)
+{
+  size_t cache_size;
+
+  output_headers (data, image_size);
+  resp_write (image, image_size);
+
+  cache_size = graph_config_get_render_cache_size ();
+  if ((cache_size > 0) && (data->etag[0] != 0))
+    filecache_put (graph_config_get_render_cache_dir (), data->cache_key,
+        image, image_size, cache_size);
+} /* }}} void output_image */
+
+/* Runs librrd and returns the image or an error message. Called with a
+ * render slot held, see "renderpool_run". */
+static int render_rrd (void *user_data, /* {{{ */
+    char **ret_data, size_t *ret_size)
+{
+  graph_data_t *data = user_data;
+  rrd_info_t *info;
+  rrd_info_t *img;
+  int status = 0;
+
+  rrd_clear_error ();
+  info = rrd_graph_v (data->argc, data->argv);
+  if ((info == NULL) || rrd_test_error ())
   {
-    int status;
-    
-    status = time_to_rfc1123 (data->mtime, time_buffer, sizeof (time_buffer));
-    if (status == 0)
-      printf ("Last-Modified: %s\n", time_buffer);
+    *ret_data = strdup (rrd_get_error ());
+    status = -1;
+  }
+  else
+  {
+    for (img = info; img != NULL; img = img->next)
+      if ((strcmp ("image", img->key) == 0)
+          && (img->type == RD_I_BLO))
+        break;
+
+    if (img == NULL)
+    {
+      *ret_data = strdup ("The \"image\" info was not found.");
+      status = -1;
+    }
+    else
+    {
+      *ret_data = malloc (img->value.u_blo.size);
+      if (*ret_data == NULL)
+      {
+        status = ENOMEM;
+      }
+      else
+      {
+        memcpy (*ret_data, img->value.u_blo.ptr, img->value.u_blo.size);
+        *ret_size = img->value.u_blo.size;
+      }
+    }
   }
 
-  /* Print Expires header. */
-  if (data->end >= data->now)
+  if ((status != 0) && (*ret_data != NULL))
+    *ret_size = strlen (*ret_data);
+
+  if (info != NULL)
+    rrd_info_free (info);
+
+  return (status);
+} /* }}} int render_rrd */
+
+struct render_buffer_s
+{
+  char *data;
+  size_t size;
+  size_t alloc;
+  _Bool failed;
+};
+typedef struct render_buffer_s render_buffer_t;
+
+static void render_buffer_print (void *ctx, /* {{{ */
+    const char *str, unsigned int len)
+{
+  render_buffer_t *b = ctx;
+
+  if (b->failed)
+    return;
+
+  if ((b->size + len) > b->alloc)
   {
-    /* The end of the timespan can be seen. */
-    long secs_per_pixel;
+    size_t tmp_alloc = (b->alloc == 0) ? 65536 : b->alloc;
+    char *tmp;
 
-    /* FIXME: Handle graphs with width != 400. */
-    secs_per_pixel = (data->end - data->begin) / 400;
+    while (tmp_alloc < (b->size + len))
+      tmp_alloc *= 2;
 
-    expires = (time_t) (data->now + secs_per_pixel);
+    tmp = realloc (b->data, tmp_alloc);
+    if (tmp == NULL)
+    {
+      b->failed = 1;
+      return;
+    }
+    b->data = tmp;
+    b->alloc = tmp_alloc;
   }
-  else /* if (data->end < data->now) */
+
+  memcpy (b->data + b->size, str, len);
+  b->size += len;
+} /* }}} void render_buffer_print */
+
+struct internal_render_s
+{
+  graph_config_t *cfg;
+  graph_instance_t *inst;
+  const graph_data_t *data;
+};
+typedef struct internal_render_s internal_render_t;
+
+/* Called with a render slot held, see "renderpool_run". */
+static int render_internal (void *user_data, /* {{{ */
+    char **ret_data, size_t *ret_size)
+{
+  internal_render_t *r = user_data;
+  render_buffer_t buffer;
+  int status;
+
+  memset (&buffer, 0, sizeof (buffer));
+  status = graph_svg_render (r->cfg, r->inst, r->data->begin, r->data->end,
+      r->data->width, r->data->height, render_buffer_print, &buffer);
+  if ((status != 0) || buffer.failed)
   {
-    expires = (time_t) (data->now + 86400);
+    free (buffer.data);
+    return ((status != 0) ? status : ENOMEM);
   }
-  status = time_to_rfc1123 (expires, time_buffer, sizeof (time_buffer));
-  if (status == 0)
-    printf ("Expires: %s\n", time_buffer);
 
-  printf ("X-Generator: "PACKAGE_STRING"\n");
-  printf ("\n");
+  *ret_data = buffer.data;
+  *ret_size = buffer.size;
+  return (0);
+} /* }}} int render_internal */
+
+/* Renders the graph with the in-process SVG renderer from the data
+ * provider's data. The result is cached like the images rendered by
+ * librrd. */
+static int output_internal (graph_config_t *cfg, /* {{{ */
+    graph_instance_t *inst, graph_data_t *data)
+{
+  internal_render_t r = { cfg, inst, data };
+  char *image = NULL;
+  size_t image_size = 0;
+  int status;
 
-  fwrite (img->value.u_blo.ptr, img->value.u_blo.size,
-      /* nmemb = */ 1, stdout);
+  data->cache_key = http_etag_update (HTTP_ETAG_INIT, "internal");
+  data->cache_key = http_etag_update (data->cache_key, data->etag);
+  if (output_cached (data) == 0)
+    return (0);
+
+  status = renderpool_run (render_internal, &r, &image, &image_size);
+  if ((status == EBUSY) || (status == ETIMEDOUT))
+    renderpool_print_unavailable ();
+  else if (status != 0)
+  {
+    resp_header ("Content-Type: text/plain");
+    resp_printf ("graph_svg_render failed.\n");
+  }
+  else
+    output_image (data, image, image_size);
 
+  free (image);
   return (0);
-} /* }}} int output_graph */
+} /* }}} int output_internal */
 
-#define OUTPUT_ERROR(...) do {             \
-  printf ("Content-Type: text/plain\n\n"); \
-  printf (__VA_ARGS__);                    \
-  return (0);                              \
+#define OUTPUT_ERROR(...) do {              \
+  resp_header ("Content-Type: text/plain"); \
+  resp_printf (__VA_ARGS__);                \
+  return (0);                               \
 } while (0)
 
 int action_graph (void) /* {{{ */
@@ -160,6 +435,8 @@ int action_graph (void) /* {{{ */
 
   int argc;
   char **argv;
+  char *image = NULL;
+  size_t image_size = 0;
 
   cfg = gl_graph_get_selected ();
   if (cfg == NULL)
@@ -169,6 +446,44 @@ int action_graph (void) /* {{{ */
   if (inst == NULL)
     OUTPUT_ERROR ("inst_get_selected (%p) failed.\n", (void *) cfg);
 
+  memset (&data, 0, sizeof (data));
+  data.width = graph_param_get_size ("width", GRAPH_WIDTH_DEFAULT);
+  data.height = graph_param_get_size ("height", GRAPH_HEIGHT_DEFAULT);
+  data.svg = param_want_svg ();
+  data.internal = param_want_internal ();
+  /* The internal renderer only does SVG. */
+  if (data.internal)
+    data.svg = 1;
+
+  status = get_time_args (&data.begin, &data.end, &data.now);
+  if (status == 0)
+    align_time_args (&data.begin, &data.end,
+        (data.end - data.begin) / data.width);
+  data.mtime = inst_get_mtime (inst);
+
+  /* Answer conditional requests before building the graph. */
+  if ((status == 0) && check_not_modified (cfg, inst, &data))
+  {
+    print_time_args (data.begin, data.end);
+    graph_print_expires (data.now, data.begin, data.end, data.width);
+    return (0);
+  }
+
+  if (data.internal)
+  {
+    if (status != 0)
+      OUTPUT_ERROR ("get_time_args failed with status %i.\n", status);
+    return (output_internal (cfg, inst, &data));
+  }
+
+  /* The entity tag covers everything the arguments for librrd are built
+   * from, so cached images are served without building them: that may
+   * require reading the data sources from the files. */
+  data.cache_key = http_etag_update (HTTP_ETAG_INIT, "rrdtool");
+  data.cache_key = http_etag_update (data.cache_key, data.etag);
+  if (output_cached (&data) == 0)
+    return (0);
+
   data.args = ra_create ();
   if (data.args == NULL)
     return (ENOMEM);
@@ -176,9 +491,12 @@ int action_graph (void) /* {{{ */
   array_append (data.args->options, "graph");
   array_append (data.args->options, "-");
   array_append (data.args->options, "--imgformat");
-  array_append (data.args->options, "PNG");
+  array_append (data.args->options, data.svg ? "SVG" : "PNG");
+  array_append (data.args->options, "--width");
+  array_append_format (data.args->options, "%i", data.width);
+  array_append (data.args->options, "--height");
+  array_append_format (data.args->options, "%i", data.height);
 
-  status = get_time_args (&data.begin, &data.end, &data.now);
   if (status == 0)
   {
     array_append (data.args->options, "-s");
@@ -202,38 +520,24 @@ int action_graph (void) /* {{{ */
     return (-1);
   }
 
-  rrd_clear_error ();
-  data.info = rrd_graph_v (argc, argv);
-  if ((data.info == NULL) || rrd_test_error ())
+  /* Limit the number of concurrent librrd runs, so heavy graphs can't tie
+   * up every FastCGI process. */
+  data.argc = argc;
+  data.argv = argv;
+  status = renderpool_run (render_rrd, &data, &image, &image_size);
+  if ((status == EBUSY) || (status == ETIMEDOUT))
+    renderpool_print_unavailable ();
+  else if (status != 0)
   {
-    printf ("Content-Type: text/plain\n\n");
-    printf ("rrd_graph_v failed: %s\n", rrd_get_error ());
+    resp_header ("Content-Type: text/plain");
+    resp_printf ("rrd_graph_v failed: %.*s\n", (int) image_size,
+        (image != NULL) ? image : "");
     emulate_graph (argc, argv);
   }
   else
-  {
-    int status;
-
-    data.mtime = inst_get_mtime (inst);
-
-    status = output_graph (&data);
-    if (status != 0)
-    {
-      rrd_info_t *ptr;
-
-      printf ("Content-Type: text/plain\n\n");
-      printf ("output_graph failed. Maybe the \"image\" info was not found?\n\n");
-
-      for (ptr = data.info; ptr != NULL; ptr = ptr->next)
-      {
-        ag_info_print (ptr);
-      }
-    }
-  }
-
-  if (data.info != NULL)
-    rrd_info_free (data.info);
+    output_image (&data, image, image_size);
 
+  free (image);
   ra_argv_free (argv);
   ra_destroy (data.args);
   data.args = NULL;
@@ -24,7 +24,23 @@
 #ifndef ACTION_GRAPH_H
 #define ACTION_GRAPH_H 1
 
+/* Default size of the graph area, in pixels, as used by rrdtool. */
+#define GRAPH_WIDTH_DEFAULT 400
+#define GRAPH_HEIGHT_DEFAULT 100
+
+/* Limits for the "width" and "height" parameters. */
+#define GRAPH_SIZE_MIN 10
+#define GRAPH_SIZE_MAX 4096
+
 int action_graph (void);
 
+/* Reads the "width" or "height" parameter. Invalid values are replaced by
+ * "default_value", values out of range are clamped. */
+int graph_param_get_size (const char *name, int default_value);
+
+/* Adds an "Expires" header: graphs showing the present expire when the next
+ * pixel is due, graphs of the past after a day. */
+void graph_print_expires (long now, long begin, long end, int width);
+
 #endif /* ACTION_GRAPH_H */
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -35,6 +35,7 @@
 #include "graph_instance.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
@@ -42,12 +43,6 @@
 /* Expire data after one day. */
 #define EXPIRES_SECS 86400
 
-static void write_callback (__attribute__((unused)) void *ctx, /* {{{ */
-    const char *str, unsigned int len)
-{
-  fwrite ((void *) str, /* size = */ len, /* nmemb = */ 1, stdout);
-} /* }}} void write_callback */
-
 int action_graph_def_json (void) /* {{{ */
 {
   graph_config_t *cfg;
@@ -72,22 +67,22 @@ int action_graph_def_json (void) /* {{{ */
   handler_config.beautify = 1;
   handler_config.indentString = "  ";
 
-  handler = yajl_gen_alloc2 (write_callback,
+  handler = yajl_gen_alloc2 (resp_yajl_print,
       &handler_config,
       /* alloc functions = */ NULL,
       /* context = */ NULL);
   if (handler == NULL)
     return (-1);
 
-  printf ("Content-Type: application/json\n");
+  resp_header ("Content-Type: application/json");
 
   now = time (NULL);
   status = time_to_rfc1123 (now + EXPIRES_SECS, time_buffer, sizeof (time_buffer));
   if (status == 0)
-    printf ("Expires: %s\n"
-        "Cache-Control: public\n",
-        time_buffer);
-  printf ("\n");
+  {
+    resp_header ("Expires: %s", time_buffer);
+    resp_header ("Cache-Control: public");
+  }
 
   status = graph_def_to_json (cfg, inst, handler);
 
@@ -0,0 +1,490 @@
+/**
+ * collection4 - action_graph_sprite.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <rrd.h>
+
+#include "action_graph_sprite.h"
+#include "action_graph.h"
+#include "action_multi_instance_data_json.h"
+#include "common.h"
+#include "graph.h"
+#include "graph_config.h"
+#include "graph_instance.h"
+#include "rrd_args.h"
+#include "utils_array.h"
+#include "utils_cgi.h"
+#include "utils_filecache.h"
+#include "utils_renderpool.h"
+#include "utils_response.h"
+
+#include <fcgiapp.h>
+#include <fcgi_stdio.h>
+
+/* Upper bound for the number of graphs in one sprite. */
+#define SPRITE_TILES_MAX 64
+
+/* Default size of one graph, including the legend. */
+#define SPRITE_WIDTH_DEFAULT 400
+#define SPRITE_HEIGHT_DEFAULT 200
+
+#define OUTPUT_ERROR(...) do {              \
+  resp_header ("Content-Type: text/plain"); \
+  resp_printf (__VA_ARGS__);                \
+  return (0);                               \
+} while (0)
+
+struct sprite_tile_s
+{
+  graph_instance_t *inst;
+  rrd_args_t *args;
+  char **argv;
+  int argc;
+};
+typedef struct sprite_tile_s sprite_tile_t;
+
+struct sprite_data_s
+{
+  sprite_tile_t tiles[SPRITE_TILES_MAX];
+  size_t tiles_num;
+  int width;
+  int height;
+  long now;
+  long begin;
+  long end;
+  time_t mtime;
+  /* Hash of all arguments passed to librrd and of the modification times.
+   * Used as entity tag and as key in the render cache. */
+  uint64_t hash;
+  char etag[64];
+};
+typedef struct sprite_data_s sprite_data_t;
+
+struct sprite_buffer_s
+{
+  char *data;
+  size_t size;
+  size_t alloc;
+};
+typedef struct sprite_buffer_s sprite_buffer_t;
+
+static int sb_append (sprite_buffer_t *sb, /* {{{ */
+    const char *data, size_t data_size)
+{
+  if ((sb->size + data_size) > sb->alloc)
+  {
+    size_t tmp_alloc;
+    char *tmp;
+
+    tmp_alloc = (sb->alloc == 0) ? 65536 : sb->alloc;
+    while (tmp_alloc < (sb->size + data_size))
+      tmp_alloc *= 2;
+
+    tmp = realloc (sb->data, tmp_alloc);
+    if (tmp == NULL)
+      return (ENOMEM);
+
+    sb->data = tmp;
+    sb->alloc = tmp_alloc;
+  }
+
+  memcpy (sb->data + sb->size, data, data_size);
+  sb->size += data_size;
+
+  return (0);
+} /* }}} int sb_append */
+
+/* Returns a pointer to the first occurrence of "needle" in the range
+ * [begin, end), or NULL. The SVG data returned by librrd is not null
+ * terminated. */
+static const char *find_string (const char *begin, /* {{{ */
+    const char *end, const char *needle)
+{
+  size_t needle_len = strlen (needle);
+  const char *ptr;
+
+  for (ptr = begin; (ptr + needle_len) <= end; ptr++)
+    if (memcmp (ptr, needle, needle_len) == 0)
+      return (ptr);
+
+  return (NULL);
+} /* }}} const char *find_string */
+
+/* Copies the content of an SVG document into "sb", moved down by "y" pixels.
+ * IDs, e.g. of glyphs and clip paths, are prefixed with the index of the
+ * tile so they are unique within the sprite. */
+static int sb_append_tile (sprite_buffer_t *sb, /* {{{ */
+    const char *svg, size_t svg_size, size_t index, int y)
+{
+  static const char *id_patterns[] = { "id=\"", "href=\"#", "url(#" };
+
+  const char *svg_end = svg + svg_size;
+  const char *begin;
+  const char *end;
+  const char *ptr;
+  const char *copied;
+  char prefix[32];
+  char buffer[64];
+  size_t prefix_len;
+  int status;
+
+  /* Skip the XML declaration and the opening "svg" tag. */
+  begin = find_string (svg, svg_end, "<svg");
+  if (begin != NULL)
+    begin = find_string (begin, svg_end, ">");
+  if (begin == NULL)
+    return (EINVAL);
+  begin++;
+
+  /* Find the last closing "svg" tag. */
+  end = NULL;
+  for (ptr = find_string (begin, svg_end, "</svg>"); ptr != NULL;
+      ptr = find_string (ptr + 1, svg_end, "</svg>"))
+    end = ptr;
+  if (end == NULL)
+    return (EINVAL);
+
+  snprintf (prefix, sizeof (prefix), "t%zu-", index);
+  prefix_len = strlen (prefix);
+
+  snprintf (buffer, sizeof (buffer), "<g transform=\"translate(0,%i)\">", y);
+  status = sb_append (sb, buffer, strlen (buffer));
+
+  copied = begin;
+  for (ptr = begin; (status == 0) && (ptr < end); ptr++)
+  {
+    size_t i;
+
+    for (i = 0; i < sizeof (id_patterns) / sizeof (id_patterns[0]); i++)
+    {
+      size_t pattern_len = strlen (id_patterns[i]);
+
+      if (((size_t) (end - ptr) < pattern_len)
+          || (memcmp (ptr, id_patterns[i], pattern_len) != 0))
+        continue;
+
+      ptr += pattern_len;
+      status = sb_append (sb, copied, (size_t) (ptr - copied));
+      if (status == 0)
+        status = sb_append (sb, prefix, prefix_len);
+      copied = ptr;
+      ptr--;
+      break;
+    }
+  }
+
+  if (status == 0)
+    status = sb_append (sb, copied, (size_t) (end - copied));
+  if (status == 0)
+    status = sb_append (sb, "</g>\n", strlen ("</g>\n"));
+
+  return (status);
+} /* }}} int sb_append_tile */
+
+static int tile_init (sprite_tile_t *tile, /* {{{ */
+    graph_config_t *cfg, const sprite_data_t *data)
+{
+  int status;
+
+  tile->args = ra_create ();
+  if (tile->args == NULL)
+    return (ENOMEM);
+
+  array_append (tile->args->options, "graph");
+  array_append (tile->args->options, "-");
+  array_append (tile->args->options, "--imgformat");
+  array_append (tile->args->options, "SVG");
+  /* Make the size include the legend so the tiles are evenly spaced. */
+  array_append (tile->args->options, "--full-size-mode");
+  array_append (tile->args->options, "--width");
+  array_append_format (tile->args->options, "%i", data->width);
+  array_append (tile->args->options, "--height");
+  array_append_format (tile->args->options, "%i", data->height);
+  array_append (tile->args->options, "-s");
+  array_append_format (tile->args->options, "%li", data->begin);
+  array_append (tile->args->options, "-e");
+  array_append_format (tile->args->options, "%li", data->end);
+
+  status = inst_get_rrdargs (cfg, tile->inst, tile->args);
+  if (status != 0)
+  {
+    fprintf (stderr, "tile_init: inst_get_rrdargs failed with status %i.\n",
+        status);
+    return (status);
+  }
+
+  tile->argc = ra_argc (tile->args);
+  tile->argv = ra_argv (tile->args);
+  if ((tile->argc < 0) || (tile->argv == NULL))
+    return (ENOMEM);
+
+  return (0);
+} /* }}} int tile_init */
+
+static void tile_free (sprite_tile_t *tile) /* {{{ */
+{
+  ra_argv_free (tile->argv);
+  ra_destroy (tile->args);
+  memset (tile, 0, sizeof (*tile));
+} /* }}} void tile_free */
+
+/* Looks up all selected instances and prepares their arguments. Instances
+ * which don't exist get an empty tile. */
+static void sprite_get_tiles (sprite_data_t *data) /* {{{ */
+{
+  multi_graph_cache_t cache;
+  char buffer[64];
+  int i;
+
+  memset (&cache, 0, sizeof (cache));
+  data->hash = http_etag_update (HTTP_ETAG_INIT, "graph_sprite");
+  data->mtime = 0;
+
+  for (data->tiles_num = 0; data->tiles_num < SPRITE_TILES_MAX;
+      data->tiles_num++)
+  {
+    sprite_tile_t *tile = data->tiles + data->tiles_num;
+    graph_config_t *cfg;
+    time_t inst_mtime;
+    char prefix[32];
+
+    snprintf (prefix, sizeof (prefix), "%zu.", data->tiles_num);
+    if (!multi_have_selector (prefix))
+      break;
+
+    cfg = multi_get_graph (&cache, prefix);
+    if (cfg != NULL)
+      tile->inst = inst_get_selected_prefix (cfg, prefix);
+
+    if ((tile->inst == NULL) || (tile_init (tile, cfg, data) != 0))
+    {
+      tile_free (tile);
+      data->hash = http_etag_update (data->hash, "null\036");
+      continue;
+    }
+
+    for (i = 0; i < tile->argc; i++)
+    {
+      data->hash = http_etag_update (data->hash, tile->argv[i]);
+      data->hash = http_etag_update (data->hash, "\037");
+    }
+
+    inst_mtime = inst_get_mtime (tile->inst);
+    snprintf (buffer, sizeof (buffer), "%li\036", (long) inst_mtime);
+    data->hash = http_etag_update (data->hash, buffer);
+
+    if (data->mtime < inst_mtime)
+      data->mtime = inst_mtime;
+  }
+
+  http_etag_format (data->hash, data->etag, sizeof (data->etag));
+} /* }}} void sprite_get_tiles */
+
+static void sprite_headers (const sprite_data_t *data) /* {{{ */
+{
+  resp_header ("Content-Type: image/svg+xml");
+  http_print_validators (data->etag, data->mtime);
+  print_time_args (data->begin, data->end);
+  graph_print_expires (data->now, data->begin, data->end, data->width);
+  resp_header ("X-Generator: "PACKAGE_STRING);
+} /* }}} void sprite_headers */
+
+/* Renders all tiles into "sb". Graphs which fail to render leave a gap;
+ * running out of memory fails the whole sprite so it is never cached. */
+static int sprite_render (sprite_data_t *data, /* {{{ */
+    sprite_buffer_t *sb)
+{
+  char buffer[512];
+  size_t i;
+  int status;
+
+  snprintf (buffer, sizeof (buffer),
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+      "xmlns:xlink=\"http://www.w3.org/1999/xlink\" "
+      "width=\"%i\" height=\"%i\" viewBox=\"0 0 %i %i\">\n",
+      data->width, data->height * (int) data->tiles_num,
+      data->width, data->height * (int) data->tiles_num);
+  status = sb_append (sb, buffer, strlen (buffer));
+
+  for (i = 0; (status == 0) && (i < data->tiles_num); i++)
+  {
+    sprite_tile_t *tile = data->tiles + i;
+    rrd_info_t *info;
+    rrd_info_t *img;
+
+    if (tile->argv == NULL)
+      continue;
+
+    rrd_clear_error ();
+    info = rrd_graph_v (tile->argc, tile->argv);
+    if ((info == NULL) || rrd_test_error ())
+    {
+      fprintf (stderr, "sprite_render: rrd_graph_v failed: %s\n",
+          rrd_get_error ());
+      if (info != NULL)
+        rrd_info_free (info);
+      continue;
+    }
+
+    for (img = info; img != NULL; img = img->next)
+      if ((strcmp ("image", img->key) == 0)
+          && (img->type == RD_I_BLO))
+        break;
+
+    if (img != NULL)
+      status = sb_append_tile (sb, (const char *) img->value.u_blo.ptr,
+          img->value.u_blo.size, i, ((int) i) * data->height);
+
+    rrd_info_free (info);
+  }
+
+  if (status == 0)
+    status = sb_append (sb, "</svg>\n", strlen ("</svg>\n"));
+
+  return (status);
+} /* }}} int sprite_render */
+
+/* Called with a render slot held, see "renderpool_run". */
+static int sprite_render_cb (void *user_data, /* {{{ */
+    char **ret_data, size_t *ret_size)
+{
+  sprite_buffer_t sb;
+  int status;
+
+  memset (&sb, 0, sizeof (sb));
+  status = sprite_render (user_data, &sb);
+  if (status != 0)
+  {
+    free (sb.data);
+    return (status);
+  }
+
+  *ret_data = sb.data;
+  *ret_size = sb.size;
+  return (0);
+} /* }}} int sprite_render_cb */
+
+static int sprite_output (sprite_data_t *data) /* {{{ */
+{
+  char *sprite = NULL;
+  size_t sprite_size = 0;
+  size_t cache_size;
+  size_t size;
+  int fd = -1;
+  int status;
+
+  cache_size = graph_config_get_render_cache_size ();
+  if ((cache_size > 0)
+      && (filecache_open (graph_config_get_render_cache_dir (),
+          data->hash, &fd, &size) == 0))
+  {
+    sprite_headers (data);
+    status = resp_write_fd (fd, size);
+    if (status != 0)
+      fprintf (stderr, "sprite_output: Reading cached sprite failed: %s\n",
+          strerror (status));
+    close (fd);
+    return (0);
+  }
+
+  status = renderpool_run (sprite_render_cb, data, &sprite, &sprite_size);
+  if ((status == EBUSY) || (status == ETIMEDOUT))
+  {
+    renderpool_print_unavailable ();
+    return (0);
+  }
+  else if (status != 0)
+  {
+    free (sprite);
+    OUTPUT_ERROR ("sprite_render failed with status %i.\n", status);
+  }
+
+  sprite_headers (data);
+  resp_write (sprite, sprite_size);
+
+  if (cache_size > 0)
+    filecache_put (graph_config_get_render_cache_dir (), data->hash,
+        sprite, sprite_size, cache_size);
+
+  free (sprite);
+  return (0);
+} /* }}} int sprite_output */
+
+int action_graph_sprite (void) /* {{{ */
+{
+  sprite_data_t *data;
+  size_t i;
+  int status;
+
+  /* Too large for the stack of a FastCGI process. */
+  data = malloc (sizeof (*data));
+  if (data == NULL)
+    return (ENOMEM);
+  memset (data, 0, sizeof (*data));
+
+  data->width = graph_param_get_size ("width", SPRITE_WIDTH_DEFAULT);
+  data->height = graph_param_get_size ("height", SPRITE_HEIGHT_DEFAULT);
+
+  status = get_time_args (&data->begin, &data->end, &data->now);
+  if (status != 0)
+  {
+    free (data);
+    OUTPUT_ERROR ("get_time_args failed with status %i.\n", status);
+  }
+  align_time_args (&data->begin, &data->end,
+      (data->end - data->begin) / data->width);
+
+  sprite_get_tiles (data);
+
+  if (data->tiles_num == 0)
+  {
+    resp_header ("Content-Type: text/plain");
+    resp_printf ("No instances selected.\n");
+  }
+  else if (http_check_conditional (data->etag, data->mtime))
+  {
+    print_time_args (data->begin, data->end);
+    graph_print_expires (data->now, data->begin, data->end, data->width);
+  }
+  else
+  {
+    sprite_output (data);
+  }
+
+  for (i = 0; i < data->tiles_num; i++)
+    tile_free (data->tiles + i);
+  free (data);
+
+  return (0);
+} /* }}} int action_graph_sprite */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,35 @@
+/**
+ * collection4 - action_graph_sprite.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef ACTION_GRAPH_SPRITE_H
+#define ACTION_GRAPH_SPRITE_H 1
+
+/* Renders the graphs of several instances into one SVG image, one below the
+ * other. The instances are selected like in "multi_instance_data_json", i.e.
+ * with parameters such as "0.host", "1.host", and so on. Every graph is
+ * "width" x "height" pixels including the legend, so the graph of instance
+ * <n> starts at y = n * height. */
+int action_graph_sprite (void);
+
+#endif /* ACTION_GRAPH_SPRITE_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <stdint.h>
 #include <inttypes.h>
@@ -33,8 +34,13 @@
 #include "common.h"
 #include "graph.h"
 #include "graph_instance.h"
+#include "graph_config.h"
+#include "graph_ident.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_consolidate.h"
+#include "utils_response.h"
+#include "utils_shmcache.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
@@ -42,11 +48,23 @@
 /* Expire data after one day. */
 #define EXPIRES_SECS 86400
 
-static void write_callback (__attribute__((unused)) void *ctx, /* {{{ */
-    const char *str, unsigned int len)
+/* Number of significant digits of data values, unless the "precision"
+ * parameter says otherwise. */
+#define DEFAULT_PRECISION 6
+
+/* Largest response body kept in the data cache. */
+#define DATA_CACHE_ENTRY_SIZE (128 * 1024)
+
+/* Passes output on to the response writer and keeps a copy for the data
+ * cache, unless it grows too large. */
+struct data_capture_s
 {
-  fwrite ((void *) str, /* size = */ len, /* nmemb = */ 1, stdout);
-} /* }}} void write_callback */
+  char *data;
+  size_t size;
+  size_t alloc;
+  _Bool overflow;
+};
+typedef struct data_capture_s data_capture_t;
 
 static int param_get_resolution (dp_time_t *resolution) /* {{{ */
 {
@@ -71,81 +89,316 @@ static int param_get_resolution (dp_time_t *resolution) /* {{{ */
   return (0);
 } /* }}} int param_get_resolution */
 
-int action_instance_data_json (void) /* {{{ */
+static int param_get_precision (void) /* {{{ */
 {
-  graph_config_t *cfg;
-  graph_instance_t *inst;
+  const char *tmp;
+  char *endptr;
+  long value;
 
-  time_t tt_begin = 0;
-  time_t tt_end = 0;
-  time_t tt_now = 0;
+  tmp = param ("precision");
+  if (tmp == NULL)
+    return (DEFAULT_PRECISION);
 
-  dp_time_t dp_begin = { 0, 0 };
-  dp_time_t dp_end = { 0, 0 };
-  dp_time_t dp_resolution = { 0, 0 };
+  endptr = NULL;
+  value = strtol (tmp, &endptr, /* base = */ 10);
+  if ((endptr == tmp) || (value < 1))
+    return (DEFAULT_PRECISION);
+  else if (value > 17)
+    return (17);
 
-  yajl_gen_config handler_config;
-  yajl_gen handler;
+  return ((int) value);
+} /* }}} int param_get_precision */
 
-  time_t expires;
-  char time_buffer[128];
+/* Consolidation function, see utils_consolidate.h. Defaults to
+ * "average". */
+static consolidation_t param_get_consolidation (void) /* {{{ */
+{
+  consolidation_t cf = CONSOLIDATE_AVERAGE;
+  const char *tmp;
+
+  tmp = param ("consolidation");
+  if (tmp != NULL)
+    consolidation_parse (tmp, &cf);
+
+  return (cf);
+} /* }}} consolidation_t param_get_consolidation */
+
+/* Returns non-zero if the client asked for the binary format described in
+ * graph_ident.h instead of JSON. */
+static _Bool param_want_binary (void) /* {{{ */
+{
+  const char *tmp;
+
+  tmp = param ("format");
+  if (tmp == NULL)
+    return (0);
+
+  return (strcasecmp ("binary", tmp) == 0);
+} /* }}} _Bool param_want_binary */
+
+/* Size of values in the binary format: "float32" (the default) is plenty for
+ * drawing a graph and halves the transfer size. */
+static size_t param_get_value_size (void) /* {{{ */
+{
+  const char *tmp;
+
+  tmp = param ("dtype");
+  if ((tmp != NULL) && (strcasecmp ("float64", tmp) == 0))
+    return (8);
+
+  return (4);
+} /* }}} size_t param_get_value_size */
+
+static void data_capture_print (void *ctx, /* {{{ */
+    const char *str, unsigned int len)
+{
+  data_capture_t *c = ctx;
+
+  resp_write (str, (size_t) len);
+
+  if (c->overflow)
+    return;
+
+  if ((c->size + len) > DATA_CACHE_ENTRY_SIZE)
+  {
+    c->overflow = 1;
+    return;
+  }
+
+  if ((c->size + len) > c->alloc)
+  {
+    size_t new_alloc = (c->alloc == 0) ? 4096 : c->alloc;
+    char *tmp;
+
+    while (new_alloc < (c->size + len))
+      new_alloc *= 2;
+
+    tmp = realloc (c->data, new_alloc);
+    if (tmp == NULL)
+    {
+      c->overflow = 1;
+      return;
+    }
+    c->data = tmp;
+    c->alloc = new_alloc;
+  }
+
+  memcpy (c->data + c->size, str, len);
+  c->size += len;
+} /* }}} void data_capture_print */
+
+/* The key identifies the instance, all parameters influencing the output and
+ * the state of the data: once one of the files is updated, the key changes
+ * and the old cache entry is eventually evicted. */
+int instance_data_key (graph_instance_t *inst, /* {{{ */
+    const instance_data_args_t *args, time_t mtime,
+    char *buffer, size_t buffer_size)
+{
+  graph_ident_t *selector;
+  int i;
   int status;
 
-  cfg = gl_graph_get_selected ();
-  if (cfg == NULL)
+  status = snprintf (buffer, buffer_size,
+      "%s\037%zu\037%s\037%i\037%ld\037%ld\037%ld.%09ld\037%ld",
+      args->binary ? "binary" : "json", args->value_size,
+      consolidation_to_string (args->cf), args->precision,
+      args->begin, args->end,
+      (long) args->resolution.tv_sec, (long) args->resolution.tv_nsec,
+      (long) mtime);
+  if ((status < 0) || (((size_t) status) >= buffer_size))
     return (ENOMEM);
 
-  inst = inst_get_selected (cfg);
-  if (inst == NULL)
-    return (EINVAL);
+  selector = inst_get_selector (inst);
+  if (selector == NULL)
+    return (ENOMEM);
+
+  for (i = 0; i < _GIF_LAST; i++)
+  {
+    strlcat (buffer, "\037", buffer_size);
+    strlcat (buffer, ident_get_field (selector, (graph_ident_field_t) i),
+        buffer_size);
+  }
+  ident_destroy (selector);
+
+  if (strlen (buffer) >= (buffer_size - 1))
+    return (ENOMEM);
+
+  return (0);
+} /* }}} int instance_data_key */
+
+static _Bool data_cache_enabled (void) /* {{{ */
+{
+  size_t entries_num;
+
+  entries_num = graph_config_get_data_cache_entries ();
+  if (entries_num == 0)
+  {
+    shmcache_close ();
+    return (0);
+  }
+
+  return (shmcache_open (graph_config_get_data_cache_file (), entries_num,
+        DATA_CACHE_ENTRY_SIZE) == 0);
+} /* }}} _Bool data_cache_enabled */
+
+int instance_data_args_get (instance_data_args_t *args) /* {{{ */
+{
+  int status;
+
+  memset (args, 0, sizeof (*args));
 
   /* Get selected time(s) */
-  tt_begin = tt_end = tt_now = 0;
-  status = get_time_args (&tt_begin, &tt_end, &tt_now);
+  status = get_time_args (&args->begin, &args->end, &args->now);
   if (status != 0)
     return (status);
 
-  dp_begin.tv_sec = tt_begin;
-  dp_begin.tv_nsec = 0;
-  dp_end.tv_sec = tt_end;
-  dp_end.tv_nsec = 0;
+  args->resolution.tv_sec = (args->end - args->begin) / 324;
+  param_get_resolution (&args->resolution);
 
-  dp_resolution.tv_sec = (tt_end - tt_begin) / 324;
-  param_get_resolution (&dp_resolution);
+  align_time_args (&args->begin, &args->end,
+      (long) args->resolution.tv_sec);
 
-  memset (&handler_config, 0, sizeof (handler_config));
-  handler_config.beautify = 0;
-  handler_config.indentString = "  ";
+  args->dp_begin.tv_sec = (time_t) args->begin;
+  args->dp_begin.tv_nsec = 0;
+  args->dp_end.tv_sec = (time_t) args->end;
+  args->dp_end.tv_nsec = 0;
 
-  handler = yajl_gen_alloc2 (write_callback,
-      &handler_config,
-      /* alloc functions = */ NULL,
-      /* context = */ NULL);
-  if (handler == NULL)
-    return (-1);
+  args->cf = param_get_consolidation ();
+  args->precision = param_get_precision ();
+  args->binary = param_want_binary ();
+  args->value_size = param_get_value_size ();
 
-  printf ("Content-Type: application/json\n");
+  return (0);
+} /* }}} int instance_data_args_get */
+
+void instance_data_print_expires (const instance_data_args_t *args) /* {{{ */
+{
+  time_t expires;
+  char time_buffer[128];
+  int status;
 
   /* By default, permit caching until 1/1000th after the last data. If that
    * data is in the past, assume the entire data is in the past and allow
    * caching for one day. */
-  expires = tt_end + ((tt_end - tt_begin) / 1000);
-  if (expires < tt_now)
-    expires = tt_now + 86400;
+  expires = (time_t) (args->end + ((args->end - args->begin) / 1000));
+  if (expires < (time_t) args->now)
+    expires = (time_t) (args->now + EXPIRES_SECS);
 
   status = time_to_rfc1123 (expires, time_buffer, sizeof (time_buffer));
   if (status == 0)
-    printf ("Expires: %s\n"
-        "Cache-Control: public\n",
-        time_buffer);
-  printf ("\n");
+  {
+    resp_header ("Expires: %s", time_buffer);
+    resp_header ("Cache-Control: public");
+  }
+} /* }}} void instance_data_print_expires */
+
+int instance_data_write (graph_instance_t *inst, /* {{{ */
+    const instance_data_args_t *args, time_t mtime)
+{
+  char key[SHMCACHE_KEY_MAX];
+  _Bool use_cache;
+  data_capture_t capture;
+  int status;
+
+  use_cache = data_cache_enabled ()
+    && (instance_data_key (inst, args, mtime, key, sizeof (key)) == 0);
+
+  if (use_cache)
+  {
+    void *data = NULL;
+    size_t data_size = 0;
+
+    status = shmcache_get (key, &data, &data_size);
+    if (status == 0)
+    {
+      resp_write (data, data_size);
+      free (data);
+      return (0);
+    }
+  }
+
+  memset (&capture, 0, sizeof (capture));
+  capture.overflow = !use_cache;
+
+  if (args->binary)
+  {
+    status = inst_data_to_binary (inst, args->dp_begin, args->dp_end,
+        args->resolution, args->cf, args->value_size,
+        data_capture_print, &capture);
+  }
+  else
+  {
+    yajl_gen_config handler_config;
+    yajl_gen handler;
+
+    memset (&handler_config, 0, sizeof (handler_config));
+    handler_config.beautify = 0;
+    handler_config.indentString = "  ";
 
-  status = inst_data_to_json (inst,
-      dp_begin, dp_end, dp_resolution, handler);
+    handler = yajl_gen_alloc2 (data_capture_print,
+        &handler_config,
+        /* alloc functions = */ NULL,
+        /* context = */ &capture);
+    if (handler == NULL)
+      return (-1);
 
-  yajl_gen_free (handler);
+    status = inst_data_to_json (inst, args->dp_begin, args->dp_end,
+        args->resolution, args->cf, args->precision, handler);
+
+    yajl_gen_free (handler);
+  }
+
+  if ((status == 0) && !capture.overflow)
+    shmcache_put (key, capture.data, capture.size);
+  free (capture.data);
 
   return (status);
+} /* }}} int instance_data_write */
+
+int action_instance_data_json (void) /* {{{ */
+{
+  graph_config_t *cfg;
+  graph_instance_t *inst;
+  instance_data_args_t args;
+  char key[SHMCACHE_KEY_MAX];
+  time_t mtime;
+  int status;
+
+  cfg = gl_graph_get_selected ();
+  if (cfg == NULL)
+    return (ENOMEM);
+
+  inst = inst_get_selected (cfg);
+  if (inst == NULL)
+    return (EINVAL);
+
+  status = instance_data_args_get (&args);
+  if (status != 0)
+    return (status);
+
+  print_time_args (args.begin, args.end);
+  instance_data_print_expires (&args);
+
+  /* Answer conditional requests before fetching any data. Checking the
+   * files' modification times is not free, so it's done only once. */
+  mtime = inst_get_mtime (inst);
+  if (instance_data_key (inst, &args, mtime, key, sizeof (key)) == 0)
+  {
+    char etag[64];
+
+    http_etag_format (http_etag_update (HTTP_ETAG_INIT, key),
+        etag, sizeof (etag));
+    if (http_check_conditional (etag, mtime))
+      return (0);
+    http_print_validators (etag, mtime);
+  }
+
+  if (args.binary)
+    resp_header ("Content-Type: application/octet-stream");
+  else
+    resp_header ("Content-Type: application/json");
+
+  return (instance_data_write (inst, &args, mtime));
 } /* }}} int action_instance_data_json */
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -24,6 +24,46 @@
 #ifndef ACTION_GRAPH_DATA_JSON_H
 #define ACTION_GRAPH_DATA_JSON_H 1
 
+#include <time.h>
+
+#include "data_provider.h"
+#include "graph_types.h"
+#include "utils_consolidate.h"
+
+/* Parameters shared by the data actions. */
+struct instance_data_args_s
+{
+  long begin;
+  long end;
+  long now;
+  dp_time_t dp_begin;
+  dp_time_t dp_end;
+  dp_time_t resolution;
+  consolidation_t cf;
+  int precision;
+  _Bool binary;
+  size_t value_size;
+};
+typedef struct instance_data_args_s instance_data_args_t;
+
+/* Reads the time range, "resolution", "consolidation", "precision",
+ * "format" and "dtype" parameters. The time range is aligned to the
+ * resolution, see "align_time_args". */
+int instance_data_args_get (instance_data_args_t *args);
+void instance_data_print_expires (const instance_data_args_t *args);
+
+/* Builds a string identifying the response for "inst": the selector, the
+ * parameters and the modification time of the files, "mtime", as returned by
+ * "inst_get_mtime". Used as the data cache key and to compute entity tags. */
+int instance_data_key (graph_instance_t *inst,
+    const instance_data_args_t *args, time_t mtime,
+    char *buffer, size_t buffer_size);
+
+/* Writes the data of "inst" to the response body, using the shared data
+ * cache if possible. "mtime" is passed on to "instance_data_key". */
+int instance_data_write (graph_instance_t *inst,
+    const instance_data_args_t *args, time_t mtime);
+
 int action_instance_data_json (void);
 
 #endif /* ACTION_GRAPH_DATA_JSON_H */
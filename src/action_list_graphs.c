@@ -31,13 +31,14 @@
 #include "graph.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
 
 static int left_menu (__attribute__((unused)) void *user_data) /* {{{ */
 {
-  printf ("\n<ul class=\"menu left\">\n"
+  resp_printf ("\n<ul class=\"menu left\">\n"
       "  <li><a href=\"%s?action=search\">Search</a></li>\n"
       "  <li><a href=\"%s?action=list_hosts\">All hosts</a></li>\n"
       "</ul>\n",
@@ -65,7 +66,7 @@ static int print_one_graph (graph_config_t *cfg, /* {{{ */
   graph_get_params (cfg, params, sizeof (params));
   html_escape_buffer (params, sizeof (params));
 
-  printf ("      <li class=\"graph\"><a href=\"%s?action=show_graph;%s\">"
+  resp_printf ("      <li class=\"graph\"><a href=\"%s?action=show_graph;%s\">"
       "%s</a> <span class=\"num_instances\">(%lu&nbsp;%s)</span></li>\n",
       script_name (), params, title,
       (unsigned long) num_instances,
@@ -84,13 +85,13 @@ static int print_all_graphs (__attribute__((unused)) void *user_data) /* {{{ */
       && (strcmp ("true", dynamic) == 0))
     include_dynamic = 1;
 
-  printf ("    <ul class=\"graph_list\">\n");
+  resp_printf ("    <ul class=\"graph_list\">\n");
   gl_graph_get_all (include_dynamic, print_one_graph, /* user_data = */ NULL);
-  printf ("    </ul>\n");
+  resp_printf ("    </ul>\n");
 
   if (!include_dynamic)
   {
-    printf ("    <div><a href=\"%s?action=list_graphs;dynamic=true\">"
+    resp_printf ("    <div><a href=\"%s?action=list_graphs;dynamic=true\">"
         "List dynamic graphs, too."
         "</a></div>\n", script_name ());
   }
@@ -31,16 +31,11 @@
 #include "graph.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
 
-static void write_callback (__attribute__((unused)) void *ctx, /* {{{ */
-    const char *str, unsigned int len)
-{
-  fwrite ((void *) str, /* size = */ len, /* nmemb = */ 1, stdout);
-} /* }}} void write_callback */
-
 static int print_one_graph (graph_config_t *cfg, /* {{{ */
     void *user_data)
 {
@@ -125,22 +120,22 @@ int action_list_graphs_json (void) /* {{{ */
   handler_config.beautify = 1;
   handler_config.indentString = "  ";
 
-  handler = yajl_gen_alloc2 (write_callback,
+  handler = yajl_gen_alloc2 (resp_yajl_print,
       &handler_config,
       /* alloc functions = */ NULL,
       /* context = */ NULL);
   if (handler == NULL)
     return (-1);
 
-  printf ("Content-Type: application/json\n");
+  resp_header ("Content-Type: application/json");
 
   now = time (NULL);
   status = time_to_rfc1123 (now + 300, time_buffer, sizeof (time_buffer));
   if (status == 0)
-    printf ("Expires: %s\n"
-        "Cache-Control: public\n",
-        time_buffer);
-  printf ("\n");
+  {
+    resp_header ("Expires: %s", time_buffer);
+    resp_header ("Cache-Control: public");
+  }
 
   print_all_graphs (handler);
 
@@ -0,0 +1,191 @@
+/**
+ * collection4 - action_multi_instance_data_json.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "action_multi_instance_data_json.h"
+#include "action_instance_data_json.h"
+#include "common.h"
+#include "data_provider.h"
+#include "graph.h"
+#include "graph_instance.h"
+#include "graph_list.h"
+#include "utils_cgi.h"
+#include "utils_response.h"
+#include "utils_shmcache.h"
+
+#include <fcgiapp.h>
+#include <fcgi_stdio.h>
+
+/* Upper bound for the number of instances in one request. Further selectors
+ * are ignored; keep in sync with "multi_max" in share/collection.js. */
+#define SELECTORS_MAX 256
+
+static const char *graph_param (const char *prefix, /* {{{ */
+    const char *prim_key, const char *sec_key)
+{
+  const char *val;
+
+  val = param_prefixed (prefix, prim_key);
+  if (val != NULL)
+    return (val);
+
+  return (param_prefixed (prefix, sec_key));
+} /* }}} const char *graph_param */
+
+graph_config_t *multi_get_graph (multi_graph_cache_t *cache, /* {{{ */
+    const char *prefix)
+{
+  const char *fields[5];
+  char key[sizeof (cache->key)];
+  size_t i;
+
+  fields[0] = graph_param (prefix, "graph_host", "host");
+  fields[1] = graph_param (prefix, "graph_plugin", "plugin");
+  fields[2] = graph_param (prefix, "graph_plugin_instance", "plugin_instance");
+  fields[3] = graph_param (prefix, "graph_type", "type");
+  fields[4] = graph_param (prefix, "graph_type_instance", "type_instance");
+
+  key[0] = 0;
+  for (i = 0; i < sizeof (fields) / sizeof (fields[0]); i++)
+  {
+    if (fields[i] == NULL)
+      return (NULL);
+
+    /* Use a separator which can't appear in a parameter. */
+    strlcat (key, fields[i], sizeof (key));
+    strlcat (key, "\n", sizeof (key));
+  }
+
+  if ((cache->cfg != NULL) && (strcmp (cache->key, key) == 0))
+    return (cache->cfg);
+
+  cache->cfg = gl_graph_get_selected_prefix (prefix);
+  memcpy (cache->key, key, sizeof (cache->key));
+
+  return (cache->cfg);
+} /* }}} graph_config_t *multi_get_graph */
+
+_Bool multi_have_selector (const char *prefix) /* {{{ */
+{
+  return ((param_prefixed (prefix, "host") != NULL)
+      || (param_prefixed (prefix, "graph_host") != NULL));
+} /* }}} _Bool multi_have_selector */
+
+int action_multi_instance_data_json (void) /* {{{ */
+{
+  instance_data_args_t args;
+  multi_graph_cache_t cache;
+  graph_instance_t *instances[SELECTORS_MAX];
+  time_t mtimes[SELECTORS_MAX];
+  size_t instances_num;
+
+  uint64_t hash;
+  time_t mtime;
+  char etag[64];
+
+  size_t i;
+  int status;
+
+  status = instance_data_args_get (&args);
+  if (status != 0)
+    return (status);
+
+  /* Batches are always sent as JSON. */
+  args.binary = 0;
+
+  /* Look up all instances first: the entity tag covers all of them and has
+   * to be checked before any data is fetched. */
+  memset (&cache, 0, sizeof (cache));
+  hash = HTTP_ETAG_INIT;
+  mtime = 0;
+  for (instances_num = 0; instances_num < SELECTORS_MAX; instances_num++)
+  {
+    graph_config_t *cfg;
+    graph_instance_t *inst;
+    char prefix[32];
+    char key[SHMCACHE_KEY_MAX];
+
+    snprintf (prefix, sizeof (prefix), "%zu.", instances_num);
+    if (!multi_have_selector (prefix))
+      break;
+
+    inst = NULL;
+    cfg = multi_get_graph (&cache, prefix);
+    if (cfg != NULL)
+      inst = inst_get_selected_prefix (cfg, prefix);
+    instances[instances_num] = inst;
+    mtimes[instances_num] = (inst != NULL) ? inst_get_mtime (inst) : 0;
+
+    if ((inst == NULL)
+        || (instance_data_key (inst, &args, mtimes[instances_num],
+            key, sizeof (key)) != 0))
+    {
+      hash = http_etag_update (hash, "null\036");
+      continue;
+    }
+
+    hash = http_etag_update (hash, key);
+    hash = http_etag_update (hash, "\036");
+
+    if (mtime < mtimes[instances_num])
+      mtime = mtimes[instances_num];
+  }
+
+  print_time_args (args.begin, args.end);
+  instance_data_print_expires (&args);
+
+  http_etag_format (hash, etag, sizeof (etag));
+  if (http_check_conditional (etag, mtime))
+    return (0);
+  http_print_validators (etag, mtime);
+
+  resp_header ("Content-Type: application/json");
+
+  /* One element per selector, in the order of the selectors: the data of
+   * the instance, as returned by "instance_data_json", or null if the
+   * instance doesn't exist. The array is written by hand so each element can
+   * come from the data cache. */
+  data_provider_batch_begin ();
+  resp_write ("[", 1);
+  for (i = 0; i < instances_num; i++)
+  {
+    if (i > 0)
+      resp_write (",", 1);
+
+    if (instances[i] == NULL)
+      resp_write ("null", 4);
+    else
+      instance_data_write (instances[i], &args, mtimes[i]);
+  }
+  resp_write ("]", 1);
+  data_provider_batch_end ();
+
+  return (0);
+} /* }}} int action_multi_instance_data_json */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
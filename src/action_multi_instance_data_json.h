@@ -0,0 +1,53 @@
+/**
+ * collection4 - action_multi_instance_data_json.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef ACTION_MULTI_INSTANCE_DATA_JSON_H
+#define ACTION_MULTI_INSTANCE_DATA_JSON_H 1
+
+#include "graph_types.h"
+
+/* Remembers the last graph lookup: the instances on a page often belong to
+ * the same graph. Initialize with zeros. */
+struct multi_graph_cache_s
+{
+  char key[1024];
+  graph_config_t *cfg;
+};
+typedef struct multi_graph_cache_s multi_graph_cache_t;
+
+/* Returns the graph selected by the parameters starting with "prefix". */
+graph_config_t *multi_get_graph (multi_graph_cache_t *cache,
+    const char *prefix);
+
+/* Returns true if there is a selector with the given prefix. */
+_Bool multi_have_selector (const char *prefix);
+
+/* Returns the data of several instances in one response. The instances are
+ * selected like in "instance_data_json", with the parameter names prefixed
+ * by the index of the instance, e.g. "0.host", "0.plugin", ..., "1.host",
+ * and so on. The time range and the other parameters apply to all
+ * instances. */
+int action_multi_instance_data_json (void);
+
+#endif /* ACTION_MULTI_INSTANCE_DATA_JSON_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
@@ -37,6 +38,7 @@
 #include "graph_list.h"
 #include "utils_cgi.h"
 #include "utils_search.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
@@ -46,19 +48,12 @@
 struct callback_data_s
 {
   graph_config_t *cfg;
-  int graph_index;
-  int graph_limit;
-  _Bool graph_more;
-  int inst_index;
-  int inst_limit;
-  _Bool inst_more;
-  const char *search_term;
 };
 typedef struct callback_data_s callback_data_t;
 
 static int left_menu (__attribute__((unused)) void *user_data) /* {{{ */
 {
-  printf ("\n<ul class=\"menu left\">\n"
+  resp_printf ("\n<ul class=\"menu left\">\n"
       "  <li><a href=\"%s?action=list_graphs\">All graphs</a></li>\n"
       "  <li><a href=\"%s?action=list_hosts\">All hosts</a></li>\n"
       "</ul>\n",
@@ -77,57 +72,17 @@ static int print_graph_inst_html (graph_config_t *cfg, /* {{{ */
 
   if (data->cfg != cfg)
   {
-    data->graph_index++;
-    if (data->graph_index >= data->graph_limit)
-    {
-      data->graph_more = 1;
-      return (1);
-    }
-
     if (data->cfg != NULL)
-      printf ("  </ul></li>\n");
+      resp_printf ("  </ul></li>\n");
 
     memset (desc, 0, sizeof (desc));
     graph_get_title (cfg, desc, sizeof (desc));
     html_escape_buffer (desc, sizeof (desc));
 
-    printf ("  <li class=\"graph\">%s\n"
+    resp_printf ("  <li class=\"graph\">%s\n"
         "  <ul class=\"instance_list\">\n", desc);
 
     data->cfg = cfg;
-    data->inst_index = -1;
-    data->inst_more = 0;
-  }
-
-  data->inst_index++;
-  if (data->inst_index >= data->inst_limit)
-  {
-    if (!data->inst_more)
-    {
-      char *search_term_html = html_escape (data->search_term);
-      char param_search_term[1024];
-
-      memset (params, 0, sizeof (params));
-      graph_get_params (cfg, params, sizeof (params));
-      html_escape_buffer (params, sizeof (params));
-
-      param_search_term[0] = 0;
-      if (search_term_html != NULL)
-      {
-        snprintf (param_search_term, sizeof (param_search_term), ";q=%s",
-            search_term_html);
-        param_search_term[sizeof (param_search_term) - 1] = 0;
-      }
-
-      free (search_term_html);
-
-      printf ("    <li class=\"instance more\"><a href=\"%s"
-          "?action=show_graph;%s%s\">More &#x2026;</a></li>\n",
-          script_name (), params, param_search_term);
-
-      data->inst_more = 1;
-    }
-    return (0);
   }
 
   memset (params, 0, sizeof (params));
@@ -138,7 +93,7 @@ static int print_graph_inst_html (graph_config_t *cfg, /* {{{ */
   inst_describe (cfg, inst, desc, sizeof (desc));
   html_escape_buffer (desc, sizeof (desc));
 
-  printf ("    <li class=\"instance\"><a href=\"%s?action=show_instance;%s\">%s</a></li>\n",
+  resp_printf ("    <li class=\"instance\"><a href=\"%s?action=show_instance;%s\">%s</a></li>\n",
       script_name (), params, desc);
 
   return (0);
@@ -148,41 +103,86 @@ struct page_data_s
 {
   char *search_term;
   search_info_t *search_info;
+  const char *cursor;
 };
 typedef struct page_data_s page_data_t;
 
+static void print_page_link (const page_data_t *pg_data, /* {{{ */
+    const char *cursor, const char *class, const char *label)
+{
+  char search_term_uri[1024];
+  char cursor_uri[4096];
+
+  uri_escape_copy (search_term_uri, pg_data->search_term,
+      sizeof (search_term_uri));
+  html_escape_buffer (search_term_uri, sizeof (search_term_uri));
+
+  uri_escape_copy (cursor_uri, cursor, sizeof (cursor_uri));
+  html_escape_buffer (cursor_uri, sizeof (cursor_uri));
+
+  resp_printf ("      <li class=\"%s\"><a href=\"%s?action=search;q=%s;"
+      "cursor=%s\">%s</a></li>\n",
+      class, script_name (), search_term_uri, cursor_uri, label);
+} /* }}} void print_page_link */
+
 static int print_search_result (void *user_data) /* {{{ */
 {
   page_data_t *pg_data = user_data;
-  callback_data_t cb_data = { /* cfg = */ NULL,
-    /* graph_index = */ -1, /* graph_limit = */ 20, /* graph_more = */ 0,
-    /* inst_index = */  -1, /* inst_limit = */   5, /* inst more = */  0,
-    /* search_term = */ pg_data->search_term };
+  callback_data_t cb_data = { /* cfg = */ NULL };
+  gl_page_t page;
   char *search_term_html;
+  int status;
 
   assert (pg_data->search_term != NULL);
 
   search_term_html = html_escape (pg_data->search_term);
-  printf ("    <h2>Search results for &quot;%s&quot;</h2>\n",
+  resp_printf ("    <h2>Search results for &quot;%s&quot;</h2>\n",
       search_term_html);
   free (search_term_html);
 
-  printf ("    <ul id=\"search-output\" class=\"graph_list\">\n");
+  status = gl_search_page (pg_data->search_info, pg_data->cursor,
+      RESULT_LIMIT, &page);
+  if (status != 0)
+  {
+    resp_printf ("    <p class=\"error\">Searching failed with status %i.</p>\n",
+        status);
+    return (status);
+  }
+
+  if (page.total == 0)
+  {
+    resp_printf ("    <p>No matching graphs found.</p>\n");
+    gl_page_free (&page);
+    return (0);
+  }
+
+  resp_printf ("    <p>Showing instances %lu&#x2013;%lu of %lu.</p>\n",
+      (unsigned long) (page.offset + 1),
+      (unsigned long) (page.offset + page.num),
+      (unsigned long) page.total);
 
-  gl_search (pg_data->search_info, print_graph_inst_html,
-      /* user_data = */ &cb_data);
+  resp_printf ("    <ul id=\"search-output\" class=\"graph_list\">\n");
 
+  gl_page_foreach (&page, print_graph_inst_html, /* user_data = */ &cb_data);
 
   if (cb_data.cfg != NULL)
-    printf ("      </ul></li>\n");
+    resp_printf ("      </ul></li>\n");
 
-  if (cb_data.graph_more)
+  resp_printf ("    </ul>\n");
+
+  if (page.have_prev || page.have_next)
   {
-    printf ("    <li class=\"graph more\">More ...</li>\n");
+    resp_printf ("    <ul class=\"menu pager\">\n");
+    if (page.have_prev)
+      print_page_link (pg_data, page.prev_cursor, "prev",
+          "&#x2190; Previous");
+    if (page.have_next)
+      print_page_link (pg_data, page.next_cursor, "next",
+          "Next &#x2192;");
+    resp_printf ("    </ul>\n");
   }
 
-  printf ("    </ul>\n");
-
+  gl_page_free (&page);
   return (0);
 } /* }}} int print_search_result */
 
@@ -201,7 +201,7 @@ static int print_search_form (void *user_data) /* {{{ */
     search_term_html[0] = 0;
   }
 
-  printf ("<form action=\"%s\" method=\"get\">\n"
+  resp_printf ("<form action=\"%s\" method=\"get\">\n"
       "  <input type=\"hidden\" name=\"action\" value=\"search\" />\n"
       "  <fieldset>\n"
       "    <legend>Advanced search</legend>\n"
@@ -276,6 +276,7 @@ int action_search (void) /* {{{ */
   {
     pg_data.search_info = search_parse (pg_data.search_term);
   }
+  pg_data.cursor = param ("cursor");
 
   status = search_html (&pg_data);
 
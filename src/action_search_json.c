@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 
@@ -33,16 +34,18 @@
 #include "graph_instance.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_search.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
 
 #define RESULT_LIMIT 10
+#define RESULT_LIMIT_MAX 100
 
 struct callback_data_s
 {
   graph_config_t *cfg;
-  int limit;
   _Bool first;
 };
 typedef struct callback_data_s callback_data_t;
@@ -56,14 +59,14 @@ static int json_begin_graph (graph_config_t *cfg) /* {{{ */
 
   graph_get_title (cfg, desc, sizeof (desc));
 
-  printf ("{\"title\":\"%s\",\"instances\":[", desc);
+  resp_printf ("{\"title\":\"%s\",\"instances\":[", desc);
 
   return (0);
 } /* }}} int json_begin_graph */
 
 static int json_end_graph (void) /* {{{ */
 {
-  printf ("]}");
+  resp_printf ("]}");
 
   return (0);
 } /* }}} int json_end_graph */
@@ -83,7 +86,7 @@ static int json_print_instance (graph_config_t *cfg, /* {{{ */
   memset (params, 0, sizeof (params));
   inst_get_params (cfg, inst, params, sizeof (params));
 
-  printf ("{\"description\":\"%s\",\"params\":\"%s\"}",
+  resp_printf ("{\"description\":\"%s\",\"params\":\"%s\"}",
       desc, params);
 
   return (0);
@@ -100,7 +103,7 @@ static int json_print_graph_instance (graph_config_t *cfg, /* {{{ */
     if (!data->first)
     {
       json_end_graph ();
-      printf (",\n");
+      resp_printf (",\n");
     }
     json_begin_graph (cfg);
 
@@ -109,53 +112,93 @@ static int json_print_graph_instance (graph_config_t *cfg, /* {{{ */
   }
   else /* if (not first instance) */
   {
-    printf (",\n");
+    resp_printf (",\n");
   }
 
   json_print_instance (cfg, inst);
 
-  if (data->limit > 0)
-    data->limit--;
-
-  if (data->limit == 0)
-    return (1);
-
   return (0);
 } /* }}} int json_print_graph_instance */
 
+static size_t param_get_limit (void) /* {{{ */
+{
+  const char *tmp;
+  char *endptr;
+  long value;
+
+  tmp = param ("limit");
+  if (tmp == NULL)
+    return (RESULT_LIMIT);
+
+  endptr = NULL;
+  value = strtol (tmp, &endptr, /* base = */ 10);
+  if ((endptr == tmp) || (value < 1))
+    return (RESULT_LIMIT);
+  else if (value > RESULT_LIMIT_MAX)
+    return (RESULT_LIMIT_MAX);
+
+  return ((size_t) value);
+} /* }}} size_t param_get_limit */
+
 static int list_graphs_json (const char *term) /* {{{ */
 {
   callback_data_t data;
+  search_info_t *si;
+  gl_page_t page;
 
   time_t now;
   char time_buffer[128];
   int status;
 
-  printf ("Content-Type: application/json\n");
+  si = NULL;
+  if (term != NULL)
+  {
+    si = search_parse (term);
+    if (si == NULL)
+      return (ENOMEM);
+  }
+
+  status = gl_search_page (si, param ("cursor"), param_get_limit (), &page);
+  search_destroy (si);
+  if (status != 0)
+    return (status);
+
+  resp_header ("Content-Type: application/json");
 
   now = time (NULL);
   status = time_to_rfc1123 (now + 300, time_buffer, sizeof (time_buffer));
   if (status == 0)
-    printf ("Expires: %s\n"
-        "Cache-Control: public\n",
-        time_buffer);
-  printf ("\n");
+  {
+    resp_header ("Expires: %s", time_buffer);
+    resp_header ("Cache-Control: public");
+  }
+
+  if (page.have_next)
+  {
+    char term_uri[1024];
+    char cursor_uri[4096];
+
+    uri_escape_copy (term_uri, (term != NULL) ? term : "", sizeof (term_uri));
+    uri_escape_copy (cursor_uri, page.next_cursor, sizeof (cursor_uri));
+    resp_header ("Link: <%s?action=search_json;q=%s;limit=%lu;cursor=%s>; "
+        "rel=\"next\"",
+        script_name (), term_uri, (unsigned long) param_get_limit (),
+        cursor_uri);
+  }
+  resp_header ("X-Total-Count: %lu", (unsigned long) page.total);
 
   data.cfg = NULL;
-  data.limit = RESULT_LIMIT;
   data.first = 1;
 
-  printf ("[\n");
-  if (term == NULL)
-    gl_instance_get_all (json_print_graph_instance, /* user_data = */ &data);
-  else
-    gl_search_string (term, json_print_graph_instance, /* user_data = */ &data);
+  resp_printf ("[\n");
+  gl_page_foreach (&page, json_print_graph_instance, /* user_data = */ &data);
 
   if (!data.first)
     json_end_graph ();
 
-  printf ("\n]");
+  resp_printf ("\n]");
 
+  gl_page_free (&page);
   return (0);
 } /* }}} int list_graphs_json */
 
@@ -165,6 +208,11 @@ int action_search_json (void) /* {{{ */
   int status;
 
   search = strtolower_copy (param ("q"));
+  if ((search != NULL) && (search[0] == 0))
+  {
+    free (search);
+    search = NULL;
+  }
 
   status = list_graphs_json (search);
 
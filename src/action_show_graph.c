@@ -36,14 +36,15 @@
 #include "graph_instance.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
 
-#define OUTPUT_ERROR(...) do {             \
-  printf ("Content-Type: text/plain\n\n"); \
-  printf (__VA_ARGS__);                    \
-  return (0);                              \
+#define OUTPUT_ERROR(...) do {              \
+  resp_header ("Content-Type: text/plain"); \
+  resp_printf (__VA_ARGS__);                \
+  return (0);                               \
 } while (0)
 
 #define MAX_SHOW_GRAPHS 10
@@ -64,11 +65,11 @@ static int show_time_selector (__attribute__((unused)) void *user_data) /* {{{ *
   param_set (pl, "end", NULL);
   param_set (pl, "button", NULL);
 
-  printf ("<form action=\"%s\" method=\"get\">\n", script_name ());
+  resp_printf ("<form action=\"%s\" method=\"get\">\n", script_name ());
 
   param_print_hidden (pl);
 
-  printf ("  <select name=\"begin\">\n"
+  resp_printf ("  <select name=\"begin\">\n"
       "    <option value=\"-3600\">Hour</option>\n"
       "    <option value=\"-86400\">Day</option>\n"
       "    <option value=\"-604800\">Week</option>\n"
@@ -77,7 +78,7 @@ static int show_time_selector (__attribute__((unused)) void *user_data) /* {{{ *
       "  </select>\n"
       "  <input type=\"submit\" name=\"button\" value=\"Go\" />\n");
 
-  printf ("</form>\n");
+  resp_printf ("</form>\n");
 
   param_destroy (pl);
 
@@ -88,7 +89,7 @@ static int left_menu (void *user_data) /* {{{ */
 {
   show_graph_data_t *data = user_data;
 
-  printf ("\n<ul class=\"menu left\">\n");
+  resp_printf ("\n<ul class=\"menu left\">\n");
 
   if ((data->search_term != NULL) && (data->search_term[0] != 0))
   {
@@ -98,12 +99,12 @@ static int left_menu (void *user_data) /* {{{ */
     graph_get_params (data->cfg, params, sizeof (params));
     html_escape_buffer (params, sizeof (params));
 
-    printf ("  <li><a href=\"%s?action=show_graph;%s\">"
+    resp_printf ("  <li><a href=\"%s?action=show_graph;%s\">"
         "All instances</a></li>\n",
         script_name (), params);
   }
 
-  printf ("  <li><a href=\"%s?action=list_graphs\">All graphs</a></li>\n"
+  resp_printf ("  <li><a href=\"%s?action=list_graphs\">All graphs</a></li>\n"
       "</ul>\n",
       script_name ());
 
@@ -170,7 +171,7 @@ static int show_instance_cb (graph_instance_t *inst, /* {{{ */
   inst_get_params (data->cfg, inst, params, sizeof (params));
   html_escape_buffer (params, sizeof (params));
 
-  printf ("  <li class=\"instance\"><a href=\"%s?action=show_instance;%s\">"
+  resp_printf ("  <li class=\"instance\"><a href=\"%s?action=show_instance;%s\">"
       "%s</a></li>\n",
       script_name (), params, descr);
 
@@ -182,18 +183,18 @@ static int show_graph (void *user_data) /* {{{ */
   show_graph_data_t *data = user_data;
 
   if ((data->search_term == NULL) || (data->search_term[0] == 0))
-    printf ("<h2>All instances</h2>\n");
+    resp_printf ("<h2>All instances</h2>\n");
   else
   {
     char *search_term_html = html_escape (data->search_term);
-    printf ("<h2>Instances matching &quot;%s&quot;</h2>\n",
+    resp_printf ("<h2>Instances matching &quot;%s&quot;</h2>\n",
         search_term_html);
     free (search_term_html);
   }
 
-  printf ("<ul class=\"instance_list\">\n");
+  resp_printf ("<ul class=\"instance_list\">\n");
   graph_inst_foreach (data->cfg, show_instance_cb, data);
-  printf ("</ul>\n");
+  resp_printf ("</ul>\n");
 
   return (0);
 } /* }}} int show_graph */
@@ -36,16 +36,11 @@
 #include "graph_instance.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
 
-static void write_callback (__attribute__((unused)) void *ctx, /* {{{ */
-    const char *str, unsigned int len)
-{
-  fwrite ((void *) str, /* size = */ len, /* nmemb = */ 1, stdout);
-} /* }}} void write_callback */
-
 int action_show_graph_json (void) /* {{{ */
 {
   graph_config_t *cfg;
@@ -65,7 +60,7 @@ int action_show_graph_json (void) /* {{{ */
   handler_config.beautify = 1;
   handler_config.indentString = "  ";
 
-  handler = yajl_gen_alloc2 (write_callback,
+  handler = yajl_gen_alloc2 (resp_yajl_print,
       &handler_config,
       /* alloc functions = */ NULL,
       /* context = */ NULL);
@@ -75,15 +70,15 @@ int action_show_graph_json (void) /* {{{ */
     return (-1);
   }
 
-  printf ("Content-Type: application/json\n");
+  resp_header ("Content-Type: application/json");
 
   now = time (NULL);
   status = time_to_rfc1123 (now + 300, time_buffer, sizeof (time_buffer));
   if (status == 0)
-    printf ("Expires: %s\n"
-        "Cache-Control: public\n",
-        time_buffer);
-  printf ("\n");
+  {
+    resp_header ("Expires: %s", time_buffer);
+    resp_header ("Cache-Control: public");
+  }
 
   status = graph_to_json (cfg, handler);
 
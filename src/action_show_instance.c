@@ -36,18 +36,23 @@
 #include "graph_instance.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
 
-#define OUTPUT_ERROR(...) do {             \
-  printf ("Content-Type: text/plain\n\n"); \
-  printf (__VA_ARGS__);                    \
-  return (0);                              \
+#define OUTPUT_ERROR(...) do {              \
+  resp_header ("Content-Type: text/plain"); \
+  resp_printf (__VA_ARGS__);                \
+  return (0);                               \
 } while (0)
 
 #define MAX_SHOW_GRAPHS 10
 
+/* Size of the graphs when several are loaded as one sprite. */
+#define SPRITE_WIDTH 400
+#define SPRITE_HEIGHT 200
+
 #define SGD_FORMAT_JSON 0
 #define SGD_FORMAT_RRD  1
 
@@ -57,6 +62,11 @@ struct show_graph_data_s
   graph_instance_t *inst;
   int graph_count;
   int format;
+
+  /* Selectors of the first instances for "graph_sprite", e.g.
+   * ";0.host=...;0.plugin=...". Only used if several graphs are shown. */
+  char sprite_params[MAX_SHOW_GRAPHS * 1024];
+  int sprite_count;
 };
 typedef struct show_graph_data_s show_graph_data_t;
 
@@ -64,20 +74,20 @@ static void show_breadcrump_field (const char *str, /* {{{ */
     const char *field_name)
 {
   if ((str == NULL) || (str[0] == 0))
-    printf ("<em>none</em>");
+    resp_printf ("<em>none</em>");
   else if (IS_ANY (str))
-    printf ("<em>any</em>");
+    resp_printf ("<em>any</em>");
   else if (IS_ALL (str))
-    printf ("<em>all</em>");
+    resp_printf ("<em>all</em>");
   else
   {
     char *str_html = html_escape (str);
 
     if (field_name != NULL)
-      printf ("<a href=\"%s?action=search;q=%s:%s\">%s</a>",
+      resp_printf ("<a href=\"%s?action=search;q=%s:%s\">%s</a>",
           script_name (), field_name, str_html, str_html);
     else
-      printf ("<a href=\"%s?action=search;q=%s\">%s</a>",
+      resp_printf ("<a href=\"%s?action=search;q=%s\">%s</a>",
           script_name (), str_html, str_html);
 
     free (str_html);
@@ -101,17 +111,17 @@ static int show_breadcrump (graph_config_t *cfg, /* {{{ */
     ident = graph_get_selector (cfg);
   }
 
-  printf ("<div class=\"breadcrump\">%s: &quot;", prefix);
+  resp_printf ("<div class=\"breadcrump\">%s: &quot;", prefix);
   show_breadcrump_field (ident_get_host (ident), "host");
-  printf ("&nbsp;/ ");
+  resp_printf ("&nbsp;/ ");
   show_breadcrump_field (ident_get_plugin (ident), "plugin");
-  printf ("&nbsp;&ndash; ");
+  resp_printf ("&nbsp;&ndash; ");
   show_breadcrump_field (ident_get_plugin_instance (ident), "plugin_instance");
-  printf ("&nbsp;/ ");
+  resp_printf ("&nbsp;/ ");
   show_breadcrump_field (ident_get_type (ident), "type");
-  printf ("&nbsp;&ndash; ");
+  resp_printf ("&nbsp;&ndash; ");
   show_breadcrump_field (ident_get_type_instance (ident), "type_instance");
-  printf ("&quot;</div>\n");
+  resp_printf ("&quot;</div>\n");
 
   ident_destroy (ident);
   return (0);
@@ -126,24 +136,24 @@ static int show_time_selector (__attribute__((unused)) void *user_data) /* {{{ *
   param_set (pl, "end", NULL);
   param_set (pl, "button", NULL);
 
-  printf ("<form action=\"%s\" method=\"get\">\n", script_name ());
+  resp_printf ("<form action=\"%s\" method=\"get\">\n", script_name ());
 
   param_print_hidden (pl);
 
-  printf ("  <select name=\"begin\">\n"
+  resp_printf ("  <select name=\"begin\">\n"
       "    <option value=\"-3600\">Hour</option>\n"
       "    <option value=\"-86400\">Day</option>\n"
       "    <option value=\"-604800\">Week</option>\n"
       "    <option value=\"-2678400\">Month</option>\n"
       "    <option value=\"-31622400\">Year</option>\n"
       "  </select><br />\n");
-  printf ("  <input id=\"format-json\" type=\"radio\" name=\"format\" value=\"JSON\" checked=\"checked\" />"
+  resp_printf ("  <input id=\"format-json\" type=\"radio\" name=\"format\" value=\"JSON\" checked=\"checked\" />"
       "<label for=\"format-json\">&nbsp;JavaScript</label><br />\n"
       "  <input id=\"format-rrd\" type=\"radio\" name=\"format\" value=\"RRD\" />"
       "<label for=\"format-rrd\">&nbsp;RRDtool</label>\n<br />");
-  printf ("  <input type=\"submit\" name=\"button\" value=\"Go\" />\n");
+  resp_printf ("  <input type=\"submit\" name=\"button\" value=\"Go\" />\n");
 
-  printf ("</form>\n");
+  resp_printf ("</form>\n");
 
   param_destroy (pl);
 
@@ -168,7 +178,7 @@ static int left_menu (void *user_data) /* {{{ */
   if (IS_ANY (host))
     host = NULL;
 
-  printf ("\n<ul class=\"menu left\">\n"
+  resp_printf ("\n<ul class=\"menu left\">\n"
       "  <li><a href=\"%s?action=show_graph;%s\">All instances</a></li>\n"
       "  <li><a href=\"%s?action=list_graphs\">All graphs</a></li>\n",
       script_name (), params,
@@ -181,10 +191,10 @@ static int left_menu (void *user_data) /* {{{ */
     html_escape_copy (host_html, host, sizeof (host_html));
     uri_escape_copy (host_uri, host, sizeof (host_uri));
 
-    printf ("  <li><a href=\"%s?action=search;q=host:%s\">Host &quot;%s&quot;</a></li>\n",
+    resp_printf ("  <li><a href=\"%s?action=search;q=host:%s\">Host &quot;%s&quot;</a></li>\n",
         script_name (), host_uri, host_html);
   }
-  printf ("</ul>\n");
+  resp_printf ("</ul>\n");
 
   host = NULL;
   ident_destroy (ident);
@@ -266,8 +276,8 @@ static int show_instance_json (graph_config_t *cfg, /* {{{ */
     return (EINVAL);
   }
 
-  printf ("<div id=\"c4-graph%i\" class=\"graph-json\"></div>\n", index);
-  printf ("<script type=\"text/javascript\">c4.instances[%i] = %s;</script>\n",
+  resp_printf ("<div id=\"c4-graph%i\" class=\"graph-json\"></div>\n", index);
+  resp_printf ("<script type=\"text/javascript\">c4.instances[%i] = %s;</script>\n",
       index, (const char *) json_buffer);
 
   yajl_gen_free (handler);
@@ -276,8 +286,9 @@ static int show_instance_json (graph_config_t *cfg, /* {{{ */
 
 static int show_instance_rrdtool (graph_config_t *cfg, /* {{{ */
     graph_instance_t *inst,
-    long begin, long end, int index)
+    long begin, long end, const show_graph_data_t *data)
 {
+  int index = data->graph_count;
   char title[128];
   char descr[128];
   char params[1024];
@@ -299,17 +310,32 @@ static int show_instance_rrdtool (graph_config_t *cfg, /* {{{ */
       begin, end);
   time_params[sizeof (time_params) - 1] = 0;
 
-  if (index < MAX_SHOW_GRAPHS)
-    printf ("<div class=\"graph-img\"><img src=\"%s?action=graph;%s%s\" "
+  if (index < data->sprite_count)
+  {
+    char sprite_params[sizeof (data->sprite_params)];
+
+    memcpy (sprite_params, data->sprite_params, sizeof (sprite_params));
+    html_escape_buffer (sprite_params, sizeof (sprite_params));
+
+    resp_printf ("<div class=\"graph-img\"><div class=\"graph-sprite\" "
+        "style=\"width: %ipx; height: %ipx; "
+        "background: url('%s?action=graph_sprite;width=%i;height=%i%s%s') "
+        "0 -%ipx no-repeat;\" title=\"%s / %s\"></div></div>\n",
+        SPRITE_WIDTH, SPRITE_HEIGHT,
+        script_name (), SPRITE_WIDTH, SPRITE_HEIGHT, time_params,
+        sprite_params, index * SPRITE_HEIGHT, title, descr);
+  }
+  else if (index < MAX_SHOW_GRAPHS)
+    resp_printf ("<div class=\"graph-img\"><img src=\"%s?action=graph;%s%s\" "
         "title=\"%s / %s\" /></div>\n",
         script_name (), params, time_params, title, descr);
   else
-    printf ("<a href=\"%s?action=show_instance;%s\">Show graph "
+    resp_printf ("<a href=\"%s?action=show_instance;%s\">Show graph "
         "&quot;%s / %s&quot;</a>\n",
         script_name (), params, title, descr);
 
 #if 0
-  printf ("<div><a href=\"%s?action=instance_data_json;%s%s\">"
+  resp_printf ("<div><a href=\"%s?action=instance_data_json;%s%s\">"
       "Get graph data as JSON</a></div>\n",
       script_name (), params, time_params);
 #endif
@@ -339,12 +365,12 @@ static int show_instance_cb (graph_config_t *cfg, /* {{{ */
   if (status != 0)
     return (status);
 
-  printf ("<h2>Instance &quot;%s&quot;</h2>\n", descr);
+  resp_printf ("<h2>Instance &quot;%s&quot;</h2>\n", descr);
 
   show_breadcrump (cfg, inst);
 
   if (data->format == SGD_FORMAT_RRD)
-    show_instance_rrdtool (cfg, inst, begin, end, data->graph_count);
+    show_instance_rrdtool (cfg, inst, begin, end, data);
   else
     show_instance_json (cfg, inst, begin, end, data->graph_count);
 
@@ -353,12 +379,66 @@ static int show_instance_cb (graph_config_t *cfg, /* {{{ */
   return (0);
 } /* }}} int show_instance_cb */
 
+/* Collects the selectors of the first MAX_SHOW_GRAPHS instances, prefixed
+ * with their index. */
+static int sprite_collect_cb (graph_config_t *cfg, /* {{{ */
+    graph_instance_t *inst,
+    void *user_data)
+{
+  show_graph_data_t *data = user_data;
+  char params[1024];
+  char *field;
+
+  if (data->sprite_count >= MAX_SHOW_GRAPHS)
+    return (0);
+
+  memset (params, 0, sizeof (params));
+  inst_get_params (cfg, inst, params, sizeof (params));
+
+  field = params;
+  while (field != NULL)
+  {
+    char tmp[sizeof (params) + 16];
+    char *next;
+
+    next = strchr (field, ';');
+    if (next != NULL)
+    {
+      *next = 0;
+      next++;
+    }
+
+    if (field[0] != 0)
+    {
+      snprintf (tmp, sizeof (tmp), ";%i.%s", data->sprite_count, field);
+      strlcat (data->sprite_params, tmp, sizeof (data->sprite_params));
+    }
+
+    field = next;
+  }
+
+  data->sprite_count++;
+  return (0);
+} /* }}} int sprite_collect_cb */
+
 static int show_instance (void *user_data) /* {{{ */
 {
   show_graph_data_t *data = user_data;
   /* char params[1024]; */
   int status;
 
+  /* Load several graphs as one sprite instead of one request per graph. */
+  if (data->format == SGD_FORMAT_RRD)
+  {
+    inst_get_all_selected (data->cfg,
+        /* callback = */ sprite_collect_cb, /* user data = */ data);
+    if (data->sprite_count < 2)
+    {
+      data->sprite_params[0] = 0;
+      data->sprite_count = 0;
+    }
+  }
+
   status = inst_get_all_selected (data->cfg,
       /* callback = */ show_instance_cb, /* user data = */ data);
   if (status != 0)
@@ -370,7 +450,7 @@ static int show_instance (void *user_data) /* {{{ */
   graph_get_params (data->cfg, params, sizeof (params));
   html_escape_buffer (params, sizeof (params));
 
-  printf ("<div style=\"clear: both;\"><a href=\"%s?action=graph_def_json;%s\">"
+  resp_printf ("<div style=\"clear: both;\"><a href=\"%s?action=graph_def_json;%s\">"
       "Get graph definition as JSON</a></div>\n",
       script_name (), params);
 #endif
@@ -40,6 +40,7 @@
 #include "common.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
@@ -86,7 +87,7 @@ int ds_list_from_rrd_file (char *file, /* {{{ */
   info = rrd_info (rrd_argc, rrd_argv);
   if (info == NULL)
   {
-    printf ("%s: rrd_info (%s) failed.\n", __func__, file);
+    resp_printf ("%s: rrd_info (%s) failed.\n", __func__, file);
     return (-1);
   }
 
@@ -200,17 +201,28 @@ static int uint32_to_rgb (uint32_t color, double *rgb) /* {{{ */
   return (0);
 } /* }}} int uint32_to_rgb */
 
-uint32_t get_random_color (void) /* {{{ */
+/* Derives the hue from a hash of "name", so a series keeps its color across
+ * requests and processes. */
+uint32_t get_color_by_name (const char *name) /* {{{ */
 {
   double hsv[3] = { 0.0, 1.0, 1.0 };
   double rgb[3] = { 0.0, 0.0, 0.0 };
+  uint32_t hash = 2166136261U;
+  const char *ptr;
 
-  hsv[0] = 360.0 * ((double) rand ()) / (((double) RAND_MAX) + 1.0);
+  /* FNV-1a */
+  for (ptr = name; (ptr != NULL) && (*ptr != 0); ptr++)
+  {
+    hash ^= (uint32_t) ((unsigned char) *ptr);
+    hash *= 16777619U;
+  }
+
+  hsv[0] = 360.0 * ((double) hash) / 4294967296.0;
 
   hsv_to_rgb (hsv, rgb);
 
   return (rgb_to_uint32 (rgb));
-} /* }}} uint32_t get_random_color */
+} /* }}} uint32_t get_color_by_name */
 
 uint32_t fade_color (uint32_t color) /* {{{ */
 {
@@ -224,23 +236,214 @@ uint32_t fade_color (uint32_t color) /* {{{ */
   return (rgb_to_uint32 (rgb));
 } /* }}} uint32_t fade_color */
 
+/* {{{ format_double */
+/* Powers of ten which can be represented exactly as double. */
+static const double format_double_pow10[] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define FORMAT_DOUBLE_POW10_MAX 22
+
+/* Returns the sign of (value * 10^scale - x), computed exactly using a fused
+ * multiply-add. */
+static int format_double_compare (double value, int scale, /* {{{ */
+    double x)
+{
+  double diff;
+
+  if (scale >= 0)
+    diff = fma (value, format_double_pow10[scale], -x);
+  else
+    diff = -fma (x, format_double_pow10[-scale], -value);
+
+  if (diff < 0.0)
+    return (-1);
+  else if (diff > 0.0)
+    return (1);
+  return (0);
+} /* }}} int format_double_compare */
+
+int format_double (char *buffer, size_t buffer_size, /* {{{ */
+    double value, int digits)
+{
+  char digit_buf[24];
+  uint64_t mantissa;
+  uint64_t mantissa_max;
+  double scaled;
+  int exponent;
+  int scale;
+  int status;
+  int num_digits;
+  size_t pos;
+  int i;
+
+  if ((buffer == NULL) || (buffer_size < 1))
+    return (-1);
+
+  if (digits < 1)
+    digits = 1;
+
+  /* Use the slow path for everything the fast path can't represent exactly:
+   * infinity, more digits than a double holds and exponents outside of the
+   * table of exact powers of ten. */
+  if (!isfinite (value) || (digits > FORMAT_DOUBLE_DIGITS_MAX))
+    return (snprintf (buffer, buffer_size, "%.*g", digits, value));
+
+  if (value == 0.0)
+    return (snprintf (buffer, buffer_size, "0"));
+
+  pos = 0;
+  if (value < 0.0)
+  {
+    digit_buf[0] = '-';
+    pos = 1;
+    value = -value;
+  }
+
+  /* Estimate floor (log10 (value)) from the binary exponent and correct it
+   * using the table. */
+  frexp (value, &exponent);
+  exponent = (int) floor (((double) (exponent - 1)) * 0.30102999566398120);
+  if ((exponent < -FORMAT_DOUBLE_POW10_MAX)
+      || ((exponent + 1) > FORMAT_DOUBLE_POW10_MAX))
+    return (snprintf (buffer, buffer_size, "%.*g", digits,
+          (pos > 0) ? -value : value));
+
+  if ((exponent >= -1)
+      && (value >= format_double_pow10[exponent + 1]))
+    exponent++;
+  else if ((exponent < -1)
+      && (value >= (1.0 / format_double_pow10[-(exponent + 1)])))
+    exponent++;
+
+  scale = digits - 1 - exponent;
+  if ((scale > FORMAT_DOUBLE_POW10_MAX) || (scale < -FORMAT_DOUBLE_POW10_MAX))
+    return (snprintf (buffer, buffer_size, "%.*g", digits,
+          (pos > 0) ? -value : value));
+
+  /* Scale the value so that the integer part has exactly "digits" digits.
+   * The scaled value is rounded, so the rounding decision is checked
+   * against the exact product below. */
+  if (scale >= 0)
+    scaled = value * format_double_pow10[scale];
+  else
+    scaled = value / format_double_pow10[-scale];
+
+  mantissa = (uint64_t) floor (scaled);
+  if ((mantissa > 0)
+      && (format_double_compare (value, scale, (double) mantissa) < 0))
+    mantissa--;
+
+  /* Round half to even, like printf. */
+  status = format_double_compare (value, scale, ((double) mantissa) + 0.5);
+  if ((status > 0) || ((status == 0) && ((mantissa % 2) == 1)))
+    mantissa++;
+
+  mantissa_max = (uint64_t) format_double_pow10[digits];
+  if (mantissa >= mantissa_max)
+  {
+    /* Rounding overflowed, e.g. 9.9999996 -> 10.0000 */
+    mantissa = mantissa_max / 10;
+    exponent++;
+  }
+
+  /* Strip trailing zeros. */
+  num_digits = digits;
+  while ((num_digits > 1) && ((mantissa % 10) == 0))
+  {
+    mantissa /= 10;
+    num_digits--;
+  }
+
+  /* Write the digits back to front. */
+  for (i = num_digits - 1; i >= 0; i--)
+  {
+    digit_buf[pos + i] = (char) ('0' + (mantissa % 10));
+    mantissa /= 10;
+  }
+
+  /* The rest mimics printf's "%g" format. */
+  {
+    const char *d = digit_buf + pos;
+    char out[64];
+    size_t out_len = 0;
+
+    if (pos > 0)
+      out[out_len++] = '-';
+
+    if ((exponent < -4) || (exponent >= digits))
+    {
+      int e = exponent;
+
+      out[out_len++] = d[0];
+      if (num_digits > 1)
+      {
+        out[out_len++] = '.';
+        for (i = 1; i < num_digits; i++)
+          out[out_len++] = d[i];
+      }
+      out[out_len++] = 'e';
+      out[out_len++] = (e < 0) ? '-' : '+';
+      if (e < 0)
+        e = -e;
+      if (e >= 100)
+        out[out_len++] = (char) ('0' + (e / 100));
+      out[out_len++] = (char) ('0' + ((e / 10) % 10));
+      out[out_len++] = (char) ('0' + (e % 10));
+    }
+    else if (exponent >= 0)
+    {
+      for (i = 0; i <= exponent; i++)
+        out[out_len++] = (i < num_digits) ? d[i] : '0';
+      if (num_digits > (exponent + 1))
+      {
+        out[out_len++] = '.';
+        for (i = exponent + 1; i < num_digits; i++)
+          out[out_len++] = d[i];
+      }
+    }
+    else /* if (exponent < 0) */
+    {
+      out[out_len++] = '0';
+      out[out_len++] = '.';
+      for (i = exponent + 1; i < 0; i++)
+        out[out_len++] = '0';
+      for (i = 0; i < num_digits; i++)
+        out[out_len++] = d[i];
+    }
+
+    if (out_len >= buffer_size)
+      out_len = buffer_size - 1;
+    memcpy (buffer, out, out_len);
+    buffer[out_len] = 0;
+
+    return ((int) out_len);
+  }
+} /* }}} int format_double */
+/* }}} format_double */
+
 int print_debug (const char *format, ...) /* {{{ */
 {
   static _Bool have_header = 0;
 
+  char buffer[4096];
   va_list ap;
   int status;
 
   if (!have_header)
   {
-    printf ("Content-Type: text/plain\n\n");
+    resp_header ("Content-Type: text/plain");
     have_header = 1;
   }
 
   va_start (ap, format);
-  status = vprintf (format, ap);
+  status = vsnprintf (buffer, sizeof (buffer), format, ap);
   va_end (ap);
 
+  if (status > 0)
+    resp_printf ("%s", buffer);
+
   return (status);
 } /* }}} int print_debug */
 
@@ -339,4 +542,45 @@ int get_time_args (long *ret_begin, long *ret_end, /* {{{ */
   return (0);
 } /* }}} int get_time_args */
 
+int align_time_args (long *begin, long *end, long default_step) /* {{{ */
+{
+  const char *align_str;
+  long step = default_step;
+
+  if ((begin == NULL) || (end == NULL))
+    return (EINVAL);
+
+  align_str = param ("align");
+  if (align_str != NULL)
+  {
+    char *endptr = NULL;
+    long tmp;
+
+    if (strcmp ("none", align_str) == 0)
+      return (0);
+
+    errno = 0;
+    tmp = strtol (align_str, &endptr, /* base = */ 10);
+    if ((endptr != align_str) && (errno == 0) && (tmp > 0))
+      step = tmp;
+  }
+
+  if (step <= 1)
+    return (0);
+
+  /* Round "begin" down and "end" up, so the aligned range contains the
+   * requested one. */
+  *begin -= ((*begin % step) + step) % step;
+  if ((*end % step) != 0)
+    *end += step - (((*end % step) + step) % step);
+
+  return (0);
+} /* }}} int align_time_args */
+
+void print_time_args (long begin, long end) /* {{{ */
+{
+  resp_header ("X-Time-Begin: %li", begin);
+  resp_header ("X-Time-End: %li", end);
+} /* }}} void print_time_args */
+
 /* vim: set sw=2 sts=2 et fdm=marker : */
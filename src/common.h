@@ -41,9 +41,16 @@ size_t c_strlcat (char *dst, const char *src, size_t size);
 int ds_list_from_rrd_file (char *file,
     size_t *ret_dses_num, char ***ret_dses);
 
-uint32_t get_random_color (void);
+uint32_t get_color_by_name (const char *name);
 uint32_t fade_color (uint32_t color);
 
+/* Formats "value" like printf's "%.*g" with "digits" significant digits,
+ * but without going through the printf machinery for the common case. Returns
+ * the number of characters written. */
+#define FORMAT_DOUBLE_DIGITS_MAX 15
+int format_double (char *buffer, size_t buffer_size,
+    double value, int digits);
+
 char *strtolower (char *str);
 char *strtolower_copy (const char *str);
 
@@ -56,5 +63,17 @@ char *strtolower_copy (const char *str);
 int get_time_args (long *ret_begin, long *ret_end,
     long *ret_now);
 
+/*
+ * Snaps the time range to multiples of "default_step" seconds, e.g. the
+ * resolution, by rounding "begin" down and "end" up. Relative ranges, such as
+ * "the last hour", then resolve to the same range for a while, so they can
+ * be cached. The "align" parameter overrides the step, e.g. with the step of
+ * an RRA; "align=none" disables alignment.
+ */
+int align_time_args (long *begin, long *end, long default_step);
+
+/* Adds headers telling the client which time range was used. */
+void print_time_args (long begin, long end);
+
 #endif /* COMMON_H */
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,194 @@
+/**
+ * collection4 - consolidate_bench.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+/* Microbenchmark for the window statistics kernels of "utils_consolidate.c".
+ * Not installed; build with "make consolidate_bench". The kernels are
+ * static, so the source file is included rather than linked. */
+#include "utils_consolidate.c"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_VALUES_DEFAULT (4 * 1024 * 1024)
+#define BENCH_RUNS 10
+
+struct bench_kernel_s
+{
+  const char *name;
+  window_stats_func_t func;
+};
+typedef struct bench_kernel_s bench_kernel_t;
+
+static double bench_now_ms (void) /* {{{ */
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ((((double) ts.tv_sec) * 1000.0)
+      + (((double) ts.tv_nsec) / 1000000.0));
+} /* }}} double bench_now_ms */
+
+/* Runs "func" over all windows and returns the best time of BENCH_RUNS runs
+ * in milliseconds. The statistics of all windows are stored in "ret". */
+static double bench_run (window_stats_func_t func, /* {{{ */
+    const double *values, size_t windows_num, size_t window_size,
+    window_stats_t *ret)
+{
+  double best = INFINITY;
+  int run;
+
+  for (run = 0; run < BENCH_RUNS; run++)
+  {
+    double begin = bench_now_ms ();
+    double elapsed;
+    size_t i;
+
+    for (i = 0; i < windows_num; i++)
+      (*func) (values + (i * window_size), window_size, ret + i);
+
+    elapsed = bench_now_ms () - begin;
+    if (elapsed < best)
+      best = elapsed;
+  }
+
+  return (best);
+} /* }}} double bench_run */
+
+static _Bool bench_stats_equal (const window_stats_t *s0, /* {{{ */
+    const window_stats_t *s1)
+{
+  double diff;
+
+  if ((s0->count != s1->count) || (s0->min != s1->min)
+      || (s0->max != s1->max))
+    return (0);
+
+  /* The vector kernels add in a different order. */
+  diff = fabs (s0->sum - s1->sum);
+  return (diff <= (1e-9 * fabs (s0->sum)));
+} /* }}} _Bool bench_stats_equal */
+
+int main (int argc, char **argv) /* {{{ */
+{
+  static const size_t window_sizes[] = { 16, 64, 256 };
+  bench_kernel_t kernels[3];
+  size_t kernels_num = 0;
+  size_t values_num = BENCH_VALUES_DEFAULT;
+  window_stats_t *reference;
+  window_stats_t *result;
+  double *values;
+  int status = EXIT_SUCCESS;
+  size_t i;
+  size_t j;
+  size_t k;
+
+  if (argc > 1)
+    values_num = (size_t) strtoul (argv[1], NULL, 0);
+  if (values_num < window_sizes[2])
+  {
+    fprintf (stderr, "Usage: %s [<number of values>]\n", argv[0]);
+    exit (EXIT_FAILURE);
+  }
+
+  kernels[kernels_num].name = "scalar";
+  kernels[kernels_num].func = window_stats_scalar;
+  kernels_num++;
+#if CONSOLIDATE_HAVE_X86_KERNELS
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2"))
+  {
+    kernels[kernels_num].name = "sse2";
+    kernels[kernels_num].func = window_stats_sse2;
+    kernels_num++;
+  }
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    kernels[kernels_num].name = "avx2";
+    kernels[kernels_num].func = window_stats_avx2;
+    kernels_num++;
+  }
+#endif
+
+  values = malloc (sizeof (*values) * values_num);
+  reference = malloc (sizeof (*reference) * (values_num / window_sizes[0]));
+  result = malloc (sizeof (*result) * (values_num / window_sizes[0]));
+  if ((values == NULL) || (reference == NULL) || (result == NULL))
+  {
+    fprintf (stderr, "malloc failed\n");
+    exit (EXIT_FAILURE);
+  }
+
+  /* Roughly one value in ten is missing, as with a host that was down for a
+   * while. */
+  srand (42);
+  for (i = 0; i < values_num; i++)
+  {
+    if ((rand () % 10) == 0)
+      values[i] = NAN;
+    else
+      values[i] = ((double) rand ()) / ((double) RAND_MAX) * 100.0;
+  }
+
+  printf ("Reducing %zu values, best of %i runs, in ms:\n\n",
+      values_num, BENCH_RUNS);
+  printf ("  window");
+  for (k = 0; k < kernels_num; k++)
+    printf (" %8s", kernels[k].name);
+  printf ("\n");
+
+  for (j = 0; j < (sizeof (window_sizes) / sizeof (window_sizes[0])); j++)
+  {
+    size_t window_size = window_sizes[j];
+    size_t windows_num = values_num / window_size;
+
+    printf ("  %6zu", window_size);
+    for (k = 0; k < kernels_num; k++)
+    {
+      window_stats_t *ret = (k == 0) ? reference : result;
+      double ms;
+
+      ms = bench_run (kernels[k].func, values, windows_num, window_size, ret);
+      printf (" %8.1f", ms);
+
+      for (i = 0; (k > 0) && (i < windows_num); i++)
+      {
+        if (!bench_stats_equal (reference + i, result + i))
+        {
+          fprintf (stderr, "\n%s: window %zu differs from scalar.\n",
+              kernels[k].name, i);
+          status = EXIT_FAILURE;
+          break;
+        }
+      }
+    }
+    printf ("\n");
+  }
+
+  free (values);
+  free (reference);
+  free (result);
+
+  exit (status);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -41,6 +41,63 @@ static data_provider_t *data_provider = NULL;
 
 static lcc_connection_t *collectd_connection = NULL;
 
+/* Identifiers flushed since "data_provider_batch_begin", sorted. */
+static _Bool batch_active = 0;
+static char **batch_flushed = NULL;
+static size_t batch_flushed_num = 0;
+
+static int compare_string_ptr (const void *v0, const void *v1) /* {{{ */
+{
+  return (strcmp (*((char * const *) v0), *((char * const *) v1)));
+} /* }}} int compare_string_ptr */
+
+/* Returns true if "ident_str" has been flushed in the current batch.
+ * Otherwise remembers it and returns false. */
+static _Bool batch_check_flushed (const char *ident_str) /* {{{ */
+{
+  char **tmp;
+  size_t lo;
+  size_t hi;
+
+  if (!batch_active)
+    return (0);
+
+  if (bsearch (&ident_str, batch_flushed, batch_flushed_num,
+        sizeof (*batch_flushed), compare_string_ptr) != NULL)
+    return (1);
+
+  tmp = realloc (batch_flushed,
+      (batch_flushed_num + 1) * sizeof (*batch_flushed));
+  if (tmp == NULL)
+    return (0);
+  batch_flushed = tmp;
+
+  /* Find the insert position. */
+  lo = 0;
+  hi = batch_flushed_num;
+  while (lo < hi)
+  {
+    size_t mid = lo + ((hi - lo) / 2);
+
+    if (strcmp (batch_flushed[mid], ident_str) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  tmp = batch_flushed + lo;
+  memmove (tmp + 1, tmp, (batch_flushed_num - lo) * sizeof (*tmp));
+  *tmp = strdup (ident_str);
+  if (*tmp == NULL)
+  {
+    memmove (tmp, tmp + 1, (batch_flushed_num - lo) * sizeof (*tmp));
+    return (0);
+  }
+  batch_flushed_num++;
+
+  return (0);
+} /* }}} _Bool batch_check_flushed */
+
 static int data_provider_ident_flush (const graph_ident_t *ident) /* {{{ */
 {
   char *ident_str;
@@ -54,6 +111,13 @@ static int data_provider_ident_flush (const graph_ident_t *ident) /* {{{ */
   if (ident_str == NULL)
     return (ENOMEM);
 
+  /* A flush applies to all data sources of the file. */
+  if (batch_check_flushed (ident_str))
+  {
+    free (ident_str);
+    return (0);
+  }
+
   if (collectd_connection == NULL)
   {
     /* TODO: Make socket path configurable */
@@ -148,6 +212,25 @@ int data_provider_get_ident_ds_names (graph_ident_t *ident, /* {{{ */
         ident, callback, user_data));
 } /* }}} int data_provider_get_ident_ds_names */
 
+void data_provider_batch_begin (void) /* {{{ */
+{
+  data_provider_batch_end ();
+  batch_active = 1;
+} /* }}} void data_provider_batch_begin */
+
+void data_provider_batch_end (void) /* {{{ */
+{
+  size_t i;
+
+  for (i = 0; i < batch_flushed_num; i++)
+    free (batch_flushed[i]);
+  free (batch_flushed);
+
+  batch_flushed = NULL;
+  batch_flushed_num = 0;
+  batch_active = 0;
+} /* }}} void data_provider_batch_end */
+
 int data_provider_get_ident_data (graph_ident_t *ident, /* {{{ */
     const char *ds_name,
     dp_time_t begin, dp_time_t end,
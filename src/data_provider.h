@@ -72,6 +72,11 @@ int data_provider_register (const char *name, data_provider_t *p);
 int data_provider_get_idents (dp_get_idents_callback callback, void *user_data);
 int data_provider_get_ident_ds_names (graph_ident_t *ident,
     dp_list_get_ident_ds_names_callback callback, void *user_data);
+/* Between these calls, each file is flushed only once, no matter how many
+ * data sources or instances are fetched from it. */
+void data_provider_batch_begin (void);
+void data_provider_batch_end (void);
+
 int data_provider_get_ident_data (graph_ident_t *ident,
     const char *ds_name,
     dp_time_t begin, dp_time_t end,
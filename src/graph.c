@@ -242,6 +242,20 @@ int graph_get_title (graph_config_t *cfg, /* {{{ */
   return (0);
 } /* }}} int graph_get_title */
 
+const char *graph_get_vertical_label (const graph_config_t *cfg) /* {{{ */
+{
+  if (cfg == NULL)
+    return (NULL);
+  return (cfg->vertical_label);
+} /* }}} const char *graph_get_vertical_label */
+
+_Bool graph_show_zero (const graph_config_t *cfg) /* {{{ */
+{
+  if (cfg == NULL)
+    return (0);
+  return (cfg->show_zero);
+} /* }}} _Bool graph_show_zero */
+
 int graph_get_params (graph_config_t *cfg, /* {{{ */
     char *buffer, size_t buffer_size)
 {
@@ -429,148 +443,6 @@ int graph_inst_find_all_matching (graph_config_t *cfg, /* {{{ */
   return (0);
 } /* }}} int graph_inst_find_all_matching */
 
-/* Lightweight variant of the "graph_search_inst" which is used if the
- * search_info_t doesn't select any field values explicitely. */
-static int graph_search_inst_noselector (graph_config_t *cfg, /* {{{ */
-    search_info_t *si, graph_inst_callback_t cb, void *user_data)
-{
-  char title[1024];
-  int status;
-  size_t i;
-
-  /* parameters have already been checked in "graph_search_inst" */
-
-  status = graph_get_title (cfg, title, sizeof (title));
-  if (status != 0)
-  {
-    fprintf (stderr, "graph_search_inst_noselector: "
-        "graph_get_title failed\n");
-    return (status);
-  }
-  strtolower (title);
-
-  for (i = 0; i < cfg->instances_num; i++)
-  {
-    if (search_graph_inst_matches (si, cfg, cfg->instances[i], title))
-    {
-      status = (*cb) (cfg, cfg->instances[i], user_data);
-      if (status != 0)
-        return (status);
-    }
-  } /* for (cfg->instances_num) */
-
-  return (0);
-} /* }}} int graph_search_inst_noselector */
-
-/* When this function is called from graph_list, it will already have checked
- * that the selector of the graph does not contradict the field selections contained in
- * the search_info_t. We still have to check if the instance contradicts the
- * search parameters, though, since the "ANY" wildcard is filled in now -
- * possibly with contradicting values. */
-int graph_search_inst (graph_config_t *cfg, search_info_t *si, /* {{{ */
-    graph_inst_callback_t cb,
-    void *user_data)
-{
-  char title[1024];
-  int status;
-  size_t i;
-  graph_ident_t *search_selector;
-
-  if ((cfg == NULL) || (si == NULL) || (cb == NULL))
-    return (EINVAL);
-
-  if (!search_has_selector (si))
-    return (graph_search_inst_noselector (cfg, si, cb, user_data));
-
-  search_selector = search_to_ident (si);
-  if (search_selector == NULL)
-    return (ENOMEM);
-
-  status = graph_get_title (cfg, title, sizeof (title));
-  if (status != 0)
-  {
-    ident_destroy (search_selector);
-    fprintf (stderr, "graph_search_inst: graph_get_title failed\n");
-    return (status);
-  }
-  strtolower (title);
-
-  for (i = 0; i < cfg->instances_num; i++)
-  {
-    graph_ident_t *inst_selector;
-
-    inst_selector = inst_get_selector (cfg->instances[i]);
-    if (inst_selector == NULL)
-      continue;
-
-    /* If the two selectors contradict one another, there is no point in
-     * calling the (more costly) "search_graph_inst_matches" function. */
-    if (!ident_intersect (search_selector, inst_selector))
-    {
-      ident_destroy (inst_selector);
-      continue;
-    }
-
-    if (search_graph_inst_matches (si, cfg, cfg->instances[i], title))
-    {
-      status = (*cb) (cfg, cfg->instances[i], user_data);
-      if (status != 0)
-      {
-        ident_destroy (search_selector);
-        ident_destroy (inst_selector);
-        return (status);
-      }
-    }
-
-    ident_destroy (inst_selector);
-  } /* for (cfg->instances_num) */
-
-  ident_destroy (search_selector);
-  return (0);
-} /* }}} int graph_search_inst */
-
-int graph_search_inst_string (graph_config_t *cfg, const char *term, /* {{{ */
-    graph_inst_callback_t cb,
-    void *user_data)
-{
-  char buffer[1024];
-  int status;
-  size_t i;
-
-  status = graph_get_title (cfg, buffer, sizeof (buffer));
-  if (status != 0)
-  {
-    fprintf (stderr, "graph_search_inst_string: graph_get_title failed\n");
-    return (status);
-  }
-
-  strtolower (buffer);
-
-  if (strstr (buffer, term) != NULL)
-  {
-    for (i = 0; i < cfg->instances_num; i++)
-    {
-      status = (*cb) (cfg, cfg->instances[i], user_data);
-      if (status != 0)
-        return (status);
-    }
-  }
-  else
-  {
-    for (i = 0; i < cfg->instances_num; i++)
-    {
-      if (inst_matches_string (cfg, cfg->instances[i], term))
-      {
-        status = (*cb) (cfg, cfg->instances[i], user_data);
-        if (status != 0)
-          return (status);
-      }
-    }
-  }
-
-  return (0);
-} /* }}} int graph_search_inst_string */
-
 int graph_inst_search_field (graph_config_t *cfg, /* {{{ */
     graph_ident_field_t field, const char *field_value,
     graph_inst_callback_t callback, void *user_data)
@@ -683,7 +555,6 @@ int graph_def_to_json (graph_config_t *cfg, /* {{{ */
 
     defs = inst_get_default_defs (cfg, inst);
     def_to_json (defs, handler);
-    def_destroy (defs);
   }
   else
   {
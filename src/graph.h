@@ -50,6 +50,10 @@ int graph_add_file (graph_config_t *cfg, const graph_ident_t *file);
 
 int graph_get_title (graph_config_t *cfg,
     char *buffer, size_t buffer_size);
+/* Returns the "VerticalLabel" option or NULL. */
+const char *graph_get_vertical_label (const graph_config_t *cfg);
+/* Returns true if the y-axis should include zero ("ShowZero" option). */
+_Bool graph_show_zero (const graph_config_t *cfg);
 
 int graph_get_params (graph_config_t *cfg, char *buffer, size_t buffer_size);
 
@@ -94,15 +98,6 @@ int graph_inst_find_all_matching (graph_config_t *cfg,
     const graph_ident_t *ident,
     graph_inst_callback_t callback, void *user_data);
 
-/* Search for instances using a search_info_t. The code assumes that the
- * graph's selector has already been checked against the search_info_t, using
- * "search_to_ident" and "graph_matches_ident". */
-int graph_search_inst (graph_config_t *cfg, search_info_t *si,
-    graph_inst_callback_t callback, void *user_data);
-
-int graph_search_inst_string (graph_config_t *cfg, const char *term,
-    graph_inst_callback_t callback, void *user_data);
-
 /* Iterates over all instances and calls "inst_matches_field". If that method
  * returns true, calls the callback with the graph and instance pointers. */
 int graph_inst_search_field (graph_config_t *cfg,
@@ -22,6 +22,7 @@
  **/
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <unistd.h>
 #include <string.h>
 #include <strings.h>
@@ -35,6 +36,9 @@
 #include "oconfig.h"
 #include "common.h"
 #include "data_provider.h"
+#include "utils_prerender.h"
+#include "utils_renderpool.h"
+#include "utils_response.h"
 
 #ifndef CONFIGFILE
 # define CONFIGFILE "/etc/collection.conf"
@@ -44,10 +48,51 @@
 # define CACHEFILE "/tmp/collection4.json"
 #endif
 
+#ifndef DATACACHEFILE
+# define DATACACHEFILE "/tmp/collection4-data.cache"
+#endif
+
+#define DATACACHE_ENTRIES_DEFAULT 256
+
+#ifndef RENDERCACHEDIR
+# define RENDERCACHEDIR "/tmp/collection4-render"
+#endif
+
+/* In megabytes. */
+#define RENDERCACHE_SIZE_DEFAULT 64
+
+#define PRERENDER_ENTRIES_DEFAULT 32
+/* In seconds. */
+#define PRERENDER_INTERVAL_DEFAULT 10
+/* In milliseconds of CPU time. */
+#define PRERENDER_BUDGET_DEFAULT 200
+
+#define RENDER_WORKERS_DEFAULT 4
+#define RENDER_QUEUE_DEFAULT 8
+/* In seconds. */
+#define RENDER_TIMEOUT_DEFAULT 30
+
 static time_t last_read_mtime = 0;
 
 static char *cache_file = NULL;
 
+static char *data_cache_file = NULL;
+static int data_cache_entries = DATACACHE_ENTRIES_DEFAULT;
+
+static char *render_cache_dir = NULL;
+static int render_cache_size = RENDERCACHE_SIZE_DEFAULT;
+
+static int prerender_entries = PRERENDER_ENTRIES_DEFAULT;
+static int prerender_interval = PRERENDER_INTERVAL_DEFAULT;
+static int prerender_budget = PRERENDER_BUDGET_DEFAULT;
+
+static int render_workers = RENDER_WORKERS_DEFAULT;
+static int render_queue = RENDER_QUEUE_DEFAULT;
+static int render_timeout = RENDER_TIMEOUT_DEFAULT;
+
+static int compression_level = RESP_COMPRESSION_LEVEL_DEFAULT;
+static int compression_threshold = RESP_COMPRESSION_THRESHOLD_DEFAULT;
+
 static int dispatch_config (const oconfig_item_t *ci) /* {{{ */
 {
   int i;
@@ -63,6 +108,30 @@ static int dispatch_config (const oconfig_item_t *ci) /* {{{ */
       data_provider_config (child);
     else if (strcasecmp ("CacheFile", child->key) == 0)
       graph_config_get_string (child, &cache_file);
+    else if (strcasecmp ("DataCacheFile", child->key) == 0)
+      graph_config_get_string (child, &data_cache_file);
+    else if (strcasecmp ("DataCacheEntries", child->key) == 0)
+      graph_config_get_int (child, &data_cache_entries);
+    else if (strcasecmp ("RenderCacheDirectory", child->key) == 0)
+      graph_config_get_string (child, &render_cache_dir);
+    else if (strcasecmp ("RenderCacheSize", child->key) == 0)
+      graph_config_get_int (child, &render_cache_size);
+    else if (strcasecmp ("PrerenderEntries", child->key) == 0)
+      graph_config_get_int (child, &prerender_entries);
+    else if (strcasecmp ("PrerenderInterval", child->key) == 0)
+      graph_config_get_int (child, &prerender_interval);
+    else if (strcasecmp ("PrerenderBudget", child->key) == 0)
+      graph_config_get_int (child, &prerender_budget);
+    else if (strcasecmp ("RenderWorkers", child->key) == 0)
+      graph_config_get_int (child, &render_workers);
+    else if (strcasecmp ("RenderQueue", child->key) == 0)
+      graph_config_get_int (child, &render_queue);
+    else if (strcasecmp ("RenderTimeout", child->key) == 0)
+      graph_config_get_int (child, &render_timeout);
+    else if (strcasecmp ("CompressionLevel", child->key) == 0)
+      graph_config_get_int (child, &compression_level);
+    else if (strcasecmp ("CompressionThreshold", child->key) == 0)
+      graph_config_get_int (child, &compression_threshold);
     else
     {
       DEBUG ("Unknown config option: %s", child->key);
@@ -80,10 +149,36 @@ static int internal_read_config (void) /* {{{ */
   if (ci == NULL)
     return (-1);
 
+  compression_level = RESP_COMPRESSION_LEVEL_DEFAULT;
+  compression_threshold = RESP_COMPRESSION_THRESHOLD_DEFAULT;
+  data_cache_entries = DATACACHE_ENTRIES_DEFAULT;
+  render_cache_size = RENDERCACHE_SIZE_DEFAULT;
+  prerender_entries = PRERENDER_ENTRIES_DEFAULT;
+  prerender_interval = PRERENDER_INTERVAL_DEFAULT;
+  prerender_budget = PRERENDER_BUDGET_DEFAULT;
+  render_workers = RENDER_WORKERS_DEFAULT;
+  render_queue = RENDER_QUEUE_DEFAULT;
+  render_timeout = RENDER_TIMEOUT_DEFAULT;
+
   dispatch_config (ci);
 
   oconfig_free (ci);
 
+  if (compression_threshold < 0)
+    compression_threshold = 0;
+  if (resp_set_compression (compression_level,
+        (size_t) compression_threshold) != 0)
+    fprintf (stderr, "internal_read_config: Invalid CompressionLevel %i\n",
+        compression_level);
+
+  if (prerender_entries < 0)
+    prerender_entries = 0;
+  prerender_configure ((size_t) prerender_entries, prerender_interval,
+      prerender_budget);
+
+  renderpool_configure (graph_config_get_render_cache_dir (),
+      render_workers, render_queue, render_timeout);
+
   gl_config_submit ();
 
   return (0);
@@ -150,6 +245,17 @@ int graph_config_get_bool (const oconfig_item_t *ci, /* {{{ */
   return (0);
 } /* }}} int graph_config_get_bool */
 
+int graph_config_get_int (const oconfig_item_t *ci, /* {{{ */
+    int *ret_int)
+{
+  if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_NUMBER))
+    return (EINVAL);
+
+  *ret_int = (int) ci->values[0].value.number;
+
+  return (0);
+} /* }}} int graph_config_get_int */
+
 const char *graph_config_get_cache_file (void) /* {{{ */
 {
   if (cache_file == NULL)
@@ -157,4 +263,37 @@ const char *graph_config_get_cache_file (void) /* {{{ */
   return (cache_file);
 } /* }}} char graph_config_get_cache_file */
 
+time_t graph_config_get_mtime (void) /* {{{ */
+{
+  return (last_read_mtime);
+} /* }}} time_t graph_config_get_mtime */
+
+const char *graph_config_get_data_cache_file (void) /* {{{ */
+{
+  if (data_cache_file == NULL)
+    return (DATACACHEFILE);
+  return (data_cache_file);
+} /* }}} char graph_config_get_data_cache_file */
+
+size_t graph_config_get_data_cache_entries (void) /* {{{ */
+{
+  if (data_cache_entries < 0)
+    return (0);
+  return ((size_t) data_cache_entries);
+} /* }}} size_t graph_config_get_data_cache_entries */
+
+const char *graph_config_get_render_cache_dir (void) /* {{{ */
+{
+  if (render_cache_dir == NULL)
+    return (RENDERCACHEDIR);
+  return (render_cache_dir);
+} /* }}} char graph_config_get_render_cache_dir */
+
+size_t graph_config_get_render_cache_size (void) /* {{{ */
+{
+  if (render_cache_size <= 0)
+    return (0);
+  return (((size_t) render_cache_size) * 1024 * 1024);
+} /* }}} size_t graph_config_get_render_cache_size */
+
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -24,14 +24,30 @@
 #ifndef GRAPH_CONFIG_H
 #define GRAPH_CONFIG_H 1
 
+#include <stddef.h>
+#include <time.h>
+
 #include "oconfig.h"
 
 int graph_read_config (void);
 
 int graph_config_get_string (const oconfig_item_t *ci, char **ret_str);
 int graph_config_get_bool (const oconfig_item_t *ci, _Bool *ret_bool);
+int graph_config_get_int (const oconfig_item_t *ci, int *ret_int);
 
 const char *graph_config_get_cache_file (void);
 
+/* Modification time of the configuration file when it was last read. */
+time_t graph_config_get_mtime (void);
+
+/* Shared memory cache of data responses. Zero entries disable the cache. */
+const char *graph_config_get_data_cache_file (void);
+size_t graph_config_get_data_cache_entries (void);
+
+/* On-disk cache of rendered graphs. The size is in bytes; zero disables the
+ * cache. */
+const char *graph_config_get_render_cache_dir (void);
+size_t graph_config_get_render_cache_size (void);
+
 /* vim: set sw=2 sts=2 et fdm=marker : */
 #endif /* GRAPH_CONFIG_H */
@@ -47,6 +47,9 @@ struct graph_def_s
   uint32_t color;
   _Bool stack;
   _Bool area;
+  /* Fetch the MIN and MAX consolidations and draw the range between them.
+   * Otherwise only AVERAGE is fetched. */
+  _Bool envelope;
   char *format;
 
   graph_def_t *next;
@@ -185,6 +188,8 @@ static int def_to_json_recursive (const graph_def_t *def, /* {{{ */
   yajl_gen_bool   (handler, def->stack);
   yajl_gen_string_cast (handler, "area", strlen ("area"));
   yajl_gen_bool   (handler, def->area);
+  yajl_gen_string_cast (handler, "envelope", strlen ("envelope"));
+  yajl_gen_bool   (handler, def->envelope);
   if (def->format != NULL)
   {
     yajl_gen_string_cast (handler, "format", strlen ("format"));
@@ -299,6 +304,8 @@ int def_config (graph_config_t *cfg, const oconfig_item_t *ci) /* {{{ */
       graph_config_get_bool (child, &def->stack);
     else if (strcasecmp ("Area", child->key) == 0)
       graph_config_get_bool (child, &def->area);
+    else if (strcasecmp ("Envelope", child->key) == 0)
+      graph_config_get_bool (child, &def->envelope);
     else if (strcasecmp ("Format", child->key) == 0)
       graph_config_get_string (child, &def->format);
   }
@@ -367,6 +374,72 @@ int def_foreach (graph_def_t *def, def_callback_t callback, /* {{{ */
   return (0);
 } /* }}} int def_foreach */
 
+const char *def_get_ds_name (const graph_def_t *def) /* {{{ */
+{
+  if (def == NULL)
+    return (NULL);
+  return (def->ds_name);
+} /* }}} const char *def_get_ds_name */
+
+int def_get_legend (const graph_def_t *def, /* {{{ */
+    const graph_ident_t *ident, char *buffer, size_t buffer_size)
+{
+  if ((def == NULL) || (ident == NULL)
+      || (buffer == NULL) || (buffer_size < 1))
+    return (EINVAL);
+
+  if (def->legend != NULL)
+  {
+    strncpy (buffer, def->legend, buffer_size);
+    buffer[buffer_size - 1] = 0;
+  }
+  else
+  {
+    ident_describe (ident, def->select, buffer, buffer_size);
+
+    if ((buffer[0] == 0) || (strcmp ("default", buffer) == 0))
+    {
+      strncpy (buffer, def->ds_name, buffer_size);
+      buffer[buffer_size - 1] = 0;
+    }
+  }
+
+  return (0);
+} /* }}} int def_get_legend */
+
+uint32_t def_get_color (const graph_def_t *def, /* {{{ */
+    const graph_ident_t *ident)
+{
+  char name[1024];
+  char *ident_str;
+
+  if (def->color <= 0x00ffffff)
+    return (def->color);
+
+  ident_str = ident_to_string (ident);
+  snprintf (name, sizeof (name), "%s/%s",
+      (ident_str != NULL) ? ident_str : "", def->ds_name);
+  name[sizeof (name) - 1] = 0;
+  free (ident_str);
+
+  return (get_color_by_name (name));
+} /* }}} uint32_t def_get_color */
+
+_Bool def_is_stack (const graph_def_t *def) /* {{{ */
+{
+  return (def->stack);
+} /* }}} _Bool def_is_stack */
+
+_Bool def_is_area (const graph_def_t *def) /* {{{ */
+{
+  return (def->area);
+} /* }}} _Bool def_is_area */
+
+_Bool def_is_envelope (const graph_def_t *def) /* {{{ */
+{
+  return (def->envelope);
+} /* }}} _Bool def_is_envelope */
+
 int def_get_rrdargs (graph_def_t *def, graph_ident_t *ident, /* {{{ */
     rrd_args_t *args)
 {
@@ -388,44 +461,31 @@ int def_get_rrdargs (graph_def_t *def, graph_ident_t *ident, /* {{{ */
 
   DEBUG ("gl_ident_get_rrdargs: file = %s;\n", file);
 
-  if (def->legend != NULL)
-  {
-    strncpy (legend, def->legend, sizeof (legend));
-    legend[sizeof (legend) - 1] = 0;
-  }
-  else
-  {
-    ident_describe (ident, def->select,
-        legend, sizeof (legend));
-
-    if ((legend[0] == 0) || (strcmp ("default", legend) == 0))
-    {
-      strncpy (legend, def->ds_name, sizeof (legend));
-      legend[sizeof (legend) - 1] = 0;
-    }
-  }
-
-  color = def->color;
-  if (color > 0x00ffffff)
-    color = get_random_color ();
+  def_get_legend (def, ident, legend, sizeof (legend));
+  color = def_get_color (def, ident);
 
   index = args->index;
   args->index++;
 
-  /* CDEFs */
-  array_append_format (args->data, "DEF:def_%04i_min=%s:%s:MIN",
-      index, file, def->ds_name);
+  /* DEFs: librrd reads the file once per DEF, so MIN and MAX are only
+   * fetched when the envelope is drawn. Otherwise the legend's minimum and
+   * maximum are those of the averages. */
   array_append_format (args->data, "DEF:def_%04i_avg=%s:%s:AVERAGE",
       index, file, def->ds_name);
-  array_append_format (args->data, "DEF:def_%04i_max=%s:%s:MAX",
-      index, file, def->ds_name);
+  if (def->envelope)
+  {
+    array_append_format (args->data, "DEF:def_%04i_min=%s:%s:MIN",
+        index, file, def->ds_name);
+    array_append_format (args->data, "DEF:def_%04i_max=%s:%s:MAX",
+        index, file, def->ds_name);
+  }
   /* VDEFs */
-  array_append_format (args->data, "VDEF:vdef_%04i_min=def_%04i_min,MINIMUM",
-      index, index);
+  array_append_format (args->data, "VDEF:vdef_%04i_min=def_%04i_%s,MINIMUM",
+      index, index, def->envelope ? "min" : "avg");
   array_append_format (args->data, "VDEF:vdef_%04i_avg=def_%04i_avg,AVERAGE",
       index, index);
-  array_append_format (args->data, "VDEF:vdef_%04i_max=def_%04i_max,MAXIMUM",
-      index, index);
+  array_append_format (args->data, "VDEF:vdef_%04i_max=def_%04i_%s,MAXIMUM",
+      index, index, def->envelope ? "max" : "avg");
   array_append_format (args->data, "VDEF:vdef_%04i_lst=def_%04i_avg,LAST",
       index, index);
 
@@ -451,6 +511,18 @@ int def_get_rrdargs (graph_def_t *def, graph_ident_t *ident, /* {{{ */
     array_prepend_format (args->areas, "AREA:%s#%06"PRIx32,
         draw_def, fade_color (color));
 
+  /* The envelope is an invisible area up to the minimum with the range
+   * stacked on top. It is meaningless for stacked graphs. */
+  if (def->envelope && !def->stack)
+  {
+    array_append_format (args->calc,
+        "CDEF:cdef_%04i_range=def_%04i_max,def_%04i_min,-",
+        index, index, index);
+    array_prepend_format (args->areas, "AREA:cdef_%04i_range#%06"PRIx32"::STACK",
+        index, fade_color (color));
+    array_prepend_format (args->areas, "AREA:def_%04i_min", index);
+  }
+
   /* Graph part */
   array_prepend_format (args->lines, "GPRINT:vdef_%04i_lst:%s last\\l",
       index, (def->format != NULL) ? def->format : "%6.2lf");
@@ -24,6 +24,9 @@
 #ifndef GRAPH_DEF_H
 #define GRAPH_DEF_H 1
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <yajl/yajl_gen.h>
 
 #include "graph_types.h"
@@ -47,6 +50,17 @@ _Bool def_matches (graph_def_t *def, graph_ident_t *ident);
 
 int def_foreach (graph_def_t *def, def_callback_t callback, void *user_data);
 
+const char *def_get_ds_name (const graph_def_t *def);
+/* Copies the legend of the line drawn for "ident" to "buffer". */
+int def_get_legend (const graph_def_t *def, const graph_ident_t *ident,
+    char *buffer, size_t buffer_size);
+/* Returns the configured color or, if none is configured, one derived from
+ * the file's identifier and the data source name. */
+uint32_t def_get_color (const graph_def_t *def, const graph_ident_t *ident);
+_Bool def_is_stack (const graph_def_t *def);
+_Bool def_is_area (const graph_def_t *def);
+_Bool def_is_envelope (const graph_def_t *def);
+
 int def_get_rrdargs (graph_def_t *def, graph_ident_t *ident,
     rrd_args_t *args);
 
@@ -34,12 +34,14 @@
 #include <sys/stat.h>
 #include <math.h>
 #include <assert.h>
+#include <stdint.h>
 
 #include "graph_ident.h"
 #include "common.h"
 #include "data_provider.h"
 #include "filesystem.h"
 #include "utils_cgi.h"
+#include "utils_consolidate.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
@@ -544,12 +546,133 @@ int ident_to_json (const graph_ident_t *ident, /* {{{ */
   return (0);
 } /* }}} char *ident_to_json */
 
+/* {{{ ident_data_consolidate */
+/* Consolidates the data points returned by the data provider to (roughly)
+ * the requested interval using the consolidation function "cf". Leading data
+ * points which don't fill an entire consolidation window are skipped. */
+static int ident_data_consolidate (dp_time_t first_value_time, /* {{{ */
+    dp_time_t interval, size_t data_points_num, const double *data_points,
+    dp_time_t interval_requested, consolidation_t cf,
+    ident_data_series_t *ret)
+{
+  double interval_double;
+  double interval_requested_double;
+  size_t points_consolidate;
+  size_t values_per_window;
+  size_t windows_num;
+  size_t offset;
+  int status;
+
+  ret->first_value_time = ((double) first_value_time.tv_sec)
+    + (((double) first_value_time.tv_nsec) / 1000000000.0);
+  interval_double = ((double) interval.tv_sec)
+    + (((double) interval.tv_nsec) / 1000000000.0);
+  interval_requested_double = ((double) interval_requested.tv_sec)
+    + (((double) interval_requested.tv_nsec) / 1000000000.0);
+
+  if (interval_requested_double < (2.0 * interval_double))
+    points_consolidate = 1;
+  else
+    points_consolidate = (size_t) (interval_requested_double / interval_double);
+  assert (points_consolidate >= 1);
+
+  /* Without consolidation, all functions return the data as is. */
+  if (points_consolidate == 1)
+    cf = CONSOLIDATE_AVERAGE;
+  values_per_window = consolidation_values_per_window (cf);
+
+  offset = data_points_num % points_consolidate;
+  windows_num = data_points_num / points_consolidate;
+  ret->first_value_time += ((double) offset) * interval_double;
+  ret->interval = interval_double * ((double) points_consolidate)
+    / ((double) values_per_window);
+  ret->values_num = windows_num * values_per_window;
+
+  ret->values = malloc (sizeof (*ret->values)
+      * ((ret->values_num > 0) ? ret->values_num : 1));
+  if (ret->values == NULL)
+    return (ENOMEM);
+
+  status = consolidate (cf, data_points + offset, windows_num,
+      points_consolidate, ret->values);
+  if (status != 0)
+  {
+    free (ret->values);
+    ret->values = NULL;
+    return (status);
+  }
+
+  return (0);
+} /* }}} int ident_data_consolidate */
+/* }}} ident_data_consolidate */
+
+/* {{{ ident_data_get_series */
+struct ident_data_get_series__data_s
+{
+  dp_time_t interval;
+  consolidation_t cf;
+  ident_data_series_t *series;
+};
+typedef struct ident_data_get_series__data_s ident_data_get_series__data_t;
+
+static int ident_data_get_series__get_ident_data (
+    __attribute__((unused)) graph_ident_t *ident, /* {{{ */
+    __attribute__((unused)) const char *ds_name,
+    dp_time_t first_value_time, dp_time_t interval,
+    size_t data_points_num, double *data_points,
+    void *user_data)
+{
+  ident_data_get_series__data_t *data = user_data;
+
+  /* Only the first call counts. */
+  if (data->series->values != NULL)
+    return (0);
+
+  return (ident_data_consolidate (first_value_time, interval,
+        data_points_num, data_points, data->interval, data->cf,
+        data->series));
+} /* }}} int ident_data_get_series__get_ident_data */
+
+int ident_data_get_series (graph_ident_t *ident, /* {{{ */
+    const char *ds_name,
+    dp_time_t begin, dp_time_t end, dp_time_t interval, consolidation_t cf,
+    ident_data_series_t *ret)
+{
+  ident_data_get_series__data_t data;
+  int status;
+
+  if ((ident == NULL) || (ds_name == NULL) || (ret == NULL))
+    return (EINVAL);
+
+  memset (ret, 0, sizeof (*ret));
+
+  data.interval = interval;
+  data.cf = cf;
+  data.series = ret;
+
+  status = data_provider_get_ident_data (ident, ds_name, begin, end,
+      ident_data_get_series__get_ident_data, &data);
+  if (status != 0)
+  {
+    free (ret->values);
+    memset (ret, 0, sizeof (*ret));
+    return (status);
+  }
+  else if (ret->values == NULL)
+    return (ENOENT);
+
+  return (0);
+} /* }}} int ident_data_get_series */
+/* }}} ident_data_get_series */
+
 /* {{{ ident_data_to_json */
 struct ident_data_to_json__data_s
 {
   dp_time_t begin;
   dp_time_t end;
   dp_time_t interval;
+  consolidation_t cf;
+  int precision;
   yajl_gen handler;
 };
 typedef struct ident_data_to_json__data_s ident_data_to_json__data_t;
@@ -557,6 +680,21 @@ typedef struct ident_data_to_json__data_s ident_data_to_json__data_t;
 #define yajl_gen_string_cast(h,s,l) \
   yajl_gen_string (h, (unsigned char *) s, (unsigned int) l)
 
+/* Replacement for "yajl_gen_double", which formats every number using
+ * sprintf and only prints six significant digits. */
+static void ident_data_to_json__gen_double (yajl_gen handler, /* {{{ */
+    double value, int precision)
+{
+  char buffer[64];
+  int status;
+
+  status = format_double (buffer, sizeof (buffer), value, precision);
+  if ((status <= 0) || (((size_t) status) >= sizeof (buffer)))
+    yajl_gen_null (handler);
+  else
+    yajl_gen_number (handler, buffer, (unsigned int) status);
+} /* }}} void ident_data_to_json__gen_double */
+
 static int ident_data_to_json__get_ident_data (
     __attribute__((unused)) graph_ident_t *ident, /* {{{ */
     __attribute__((unused)) const char *ds_name,
@@ -565,71 +703,42 @@ static int ident_data_to_json__get_ident_data (
     void *user_data)
 {
   ident_data_to_json__data_t *data = user_data;
+  ident_data_series_t series;
   size_t i;
+  int status;
 
-  double first_value_time_double;
-  double interval_double;
-  double interval_requested;
-  size_t points_consolidate;
-
-  first_value_time_double = ((double) first_value_time.tv_sec)
-    + (((double) first_value_time.tv_nsec) / 1000000000.0);
-  interval_double = ((double) interval.tv_sec)
-    + (((double) interval.tv_nsec) / 1000000000.0);
-  interval_requested = ((double) data->interval.tv_sec)
-    + (((double) data->interval.tv_nsec) / 1000000000.0);
-
-  if (interval_requested < (2.0 * interval_double))
-    points_consolidate = 1;
-  else
-    points_consolidate = (size_t) (interval_requested / interval_double);
-  assert (points_consolidate >= 1);
-
-  if (points_consolidate > 1)
-  {
-    size_t offset = data_points_num % points_consolidate;
-
-    first_value_time_double += ((double) offset) * interval_double;
-    interval_double *= ((double) points_consolidate);
-  }
+  status = ident_data_consolidate (first_value_time, interval,
+      data_points_num, data_points, data->interval, data->cf, &series);
+  if (status != 0)
+    return (status);
 
   yajl_gen_map_open (data->handler);
 
+  /* Times are always printed with full precision: six digits aren't enough
+   * for a Unix timestamp. */
   yajl_gen_string_cast (data->handler, "first_value_time", strlen ("first_value_time"));
-  yajl_gen_double (data->handler, first_value_time_double);
+  ident_data_to_json__gen_double (data->handler, series.first_value_time,
+      FORMAT_DOUBLE_DIGITS_MAX);
 
   yajl_gen_string_cast (data->handler, "interval", strlen ("interval"));
-  yajl_gen_double (data->handler, interval_double);
+  ident_data_to_json__gen_double (data->handler, series.interval,
+      FORMAT_DOUBLE_DIGITS_MAX);
 
   yajl_gen_string_cast (data->handler, "data", strlen ("data"));
   yajl_gen_array_open (data->handler);
 
-  for (i = (data_points_num % points_consolidate);
-      i < data_points_num;
-      i += points_consolidate)
+  for (i = 0; i < series.values_num; i++)
   {
-    size_t j;
-
-    double sum = 0.0;
-    long num = 0;
-
-    for (j = 0; j < points_consolidate; j++)
-    {
-      if (isnan (data_points[i+j]))
-        continue;
-
-      sum += data_points[i+j];
-      num++;
-    }
-
-    if (num == 0)
+    if (isnan (series.values[i]))
       yajl_gen_null (data->handler);
     else
-      yajl_gen_double (data->handler, sum / ((double) num));
+      ident_data_to_json__gen_double (data->handler, series.values[i],
+          data->precision);
   }
 
   yajl_gen_array_close (data->handler);
 
+  free (series.values);
   return (0);
 } /* }}} int ident_data_to_json__get_ident_data */
 
@@ -659,8 +768,8 @@ static int ident_data_to_json__get_ds_name (graph_ident_t *ident, /* {{{ */
 } /* }}} int ident_data_to_json__get_ds_name */
 
 int ident_data_to_json (graph_ident_t *ident, /* {{{ */
-    dp_time_t begin, dp_time_t end, dp_time_t res,
-    yajl_gen handler)
+    dp_time_t begin, dp_time_t end, dp_time_t res, consolidation_t cf,
+    int precision, yajl_gen handler)
 {
   ident_data_to_json__data_t data;
   int status;
@@ -668,6 +777,8 @@ int ident_data_to_json (graph_ident_t *ident, /* {{{ */
   data.begin = begin;
   data.end = end;
   data.interval = res;
+  data.cf = cf;
+  data.precision = precision;
   data.handler = handler;
 
   /* Iterate over all DS names */
@@ -681,6 +792,188 @@ int ident_data_to_json (graph_ident_t *ident, /* {{{ */
 } /* }}} int ident_data_to_json */
 /* }}} ident_data_to_json */
 
+/* {{{ ident_data_to_binary */
+struct ident_data_to_binary__data_s
+{
+  dp_time_t begin;
+  dp_time_t end;
+  dp_time_t interval;
+  consolidation_t cf;
+  size_t value_size;
+  ident_print_t print;
+  void *print_ctx;
+};
+typedef struct ident_data_to_binary__data_s ident_data_to_binary__data_t;
+
+/* Helpers writing integers and floating point numbers in little endian byte
+ * order, independent of the host's byte order. */
+static void ident_put_le (uint8_t *dest, uint64_t value, /* {{{ */
+    size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+  {
+    dest[i] = (uint8_t) (value & 0xff);
+    value >>= 8;
+  }
+} /* }}} void ident_put_le */
+
+static void ident_put_double_le (uint8_t *dest, double value) /* {{{ */
+{
+  uint64_t tmp;
+
+  memcpy (&tmp, &value, sizeof (tmp));
+  ident_put_le (dest, tmp, sizeof (tmp));
+} /* }}} void ident_put_double_le */
+
+static void ident_put_float_le (uint8_t *dest, float value) /* {{{ */
+{
+  uint32_t tmp;
+
+  memcpy (&tmp, &value, sizeof (tmp));
+  ident_put_le (dest, (uint64_t) tmp, sizeof (tmp));
+} /* }}} void ident_put_float_le */
+
+#define IDENT_BINARY_ALIGN(n) ((((n) + 7) / 8) * 8)
+
+/* Writes one record. See "ident_data_to_binary" in graph_ident.h for the
+ * layout. */
+static int ident_data_to_binary__get_ident_data ( /* {{{ */
+    graph_ident_t *ident, const char *ds_name,
+    dp_time_t first_value_time, dp_time_t interval,
+    size_t data_points_num, double *data_points,
+    void *user_data)
+{
+  ident_data_to_binary__data_t *data = user_data;
+  ident_data_series_t series;
+  const char *strings[6];
+  size_t strings_size;
+  size_t values_offset;
+  size_t record_size;
+  uint8_t *record;
+  size_t pos;
+  size_t i;
+  int status;
+
+  status = ident_data_consolidate (first_value_time, interval,
+      data_points_num, data_points, data->interval, data->cf, &series);
+  if (status != 0)
+    return (status);
+
+  strings[0] = ident->host;
+  strings[1] = ident->plugin;
+  strings[2] = ident->plugin_instance;
+  strings[3] = ident->type;
+  strings[4] = ident->type_instance;
+  strings[5] = ds_name;
+
+  strings_size = 0;
+  for (i = 0; i < (sizeof (strings) / sizeof (strings[0])); i++)
+    strings_size += 2 + strlen (strings[i]);
+
+  values_offset = IDENT_BINARY_ALIGN (24 + strings_size);
+  record_size = IDENT_BINARY_ALIGN (values_offset
+      + (series.values_num * data->value_size));
+
+  record = calloc (1, record_size);
+  if (record == NULL)
+  {
+    free (series.values);
+    return (ENOMEM);
+  }
+
+  ident_put_le (record + 0, (uint64_t) record_size, 4);
+  ident_put_le (record + 4, (uint64_t) series.values_num, 4);
+  ident_put_double_le (record + 8, series.first_value_time);
+  ident_put_double_le (record + 16, series.interval);
+
+  pos = 24;
+  for (i = 0; i < (sizeof (strings) / sizeof (strings[0])); i++)
+  {
+    size_t len = strlen (strings[i]);
+
+    ident_put_le (record + pos, (uint64_t) len, 2);
+    memcpy (record + pos + 2, strings[i], len);
+    pos += 2 + len;
+  }
+
+  pos = values_offset;
+  for (i = 0; i < series.values_num; i++)
+  {
+    if (data->value_size == 4)
+      ident_put_float_le (record + pos, (float) series.values[i]);
+    else
+      ident_put_double_le (record + pos, series.values[i]);
+    pos += data->value_size;
+  }
+
+  (*data->print) (data->print_ctx, (const char *) record,
+      (unsigned int) record_size);
+
+  free (record);
+  free (series.values);
+  return (0);
+} /* }}} int ident_data_to_binary__get_ident_data */
+
+static int ident_data_to_binary__get_ds_name (graph_ident_t *ident, /* {{{ */
+    const char *ds_name, void *user_data)
+{
+  ident_data_to_binary__data_t *data = user_data;
+
+  return (data_provider_get_ident_data (ident, ds_name,
+        data->begin, data->end,
+        ident_data_to_binary__get_ident_data,
+        data));
+} /* }}} int ident_data_to_binary__get_ds_name */
+
+int ident_data_binary_header (size_t value_size, /* {{{ */
+    ident_print_t print, void *print_ctx)
+{
+  uint8_t header[8];
+
+  if ((print == NULL) || ((value_size != 4) && (value_size != 8)))
+    return (EINVAL);
+
+  memcpy (header, IDENT_BINARY_MAGIC, 4);
+  header[4] = IDENT_BINARY_VERSION;
+  header[5] = (uint8_t) value_size;
+  header[6] = 0;
+  header[7] = 0;
+
+  (*print) (print_ctx, (const char *) header, (unsigned int) sizeof (header));
+  return (0);
+} /* }}} int ident_data_binary_header */
+
+int ident_data_to_binary (graph_ident_t *ident, /* {{{ */
+    dp_time_t begin, dp_time_t end, dp_time_t res, consolidation_t cf,
+    size_t value_size, ident_print_t print, void *print_ctx)
+{
+  ident_data_to_binary__data_t data;
+  int status;
+
+  if ((ident == NULL) || (print == NULL)
+      || ((value_size != 4) && (value_size != 8)))
+    return (EINVAL);
+
+  data.begin = begin;
+  data.end = end;
+  data.interval = res;
+  data.cf = cf;
+  data.value_size = value_size;
+  data.print = print;
+  data.print_ctx = print_ctx;
+
+  status = data_provider_get_ident_ds_names (ident,
+      ident_data_to_binary__get_ds_name, &data);
+  if (status != 0)
+    fprintf (stderr, "ident_data_to_binary: data_provider_get_ident_ds_names "
+        "failed with status %i\n", status);
+
+  return (status);
+} /* }}} int ident_data_to_binary */
+/* }}} ident_data_to_binary */
+
 int ident_describe (const graph_ident_t *ident, /* {{{ */
     const graph_ident_t *selector,
     char *buffer, size_t buffer_size)
@@ -30,6 +30,7 @@
 
 #include "graph_types.h"
 #include "data_provider.h"
+#include "utils_consolidate.h"
 
 #define ANY_TOKEN "/any/"
 #define ALL_TOKEN "/all/"
@@ -37,6 +38,25 @@
 #define IS_ANY(str) (((str) != NULL) && (strcasecmp (ANY_TOKEN, (str)) == 0))
 #define IS_ALL(str) (((str) != NULL) && (strcasecmp (ALL_TOKEN, (str)) == 0))
 
+#define IDENT_BINARY_MAGIC "C4DS"
+#define IDENT_BINARY_VERSION 1
+
+/* Output callback used by the binary data format. The signature is
+ * compatible with yajl's print callback. */
+typedef void (*ident_print_t) (void *ctx, const char *str, unsigned int len);
+
+/* Data of one data source, consolidated to (roughly) the requested
+ * interval. Value <n> belongs to "first_value_time + n * interval"; NaN
+ * means "no data". */
+struct ident_data_series_s
+{
+  double first_value_time;
+  double interval;
+  double *values;
+  size_t values_num;
+};
+typedef struct ident_data_series_s ident_data_series_t;
+
 enum graph_ident_field_e
 {
   GIF_HOST,
@@ -92,9 +112,41 @@ char *ident_to_string (const graph_ident_t *ident);
 char *ident_to_file (const graph_ident_t *ident);
 int ident_to_json (const graph_ident_t *ident,
     yajl_gen handler);
+/* Prints the data of all data sources of "ident", consolidated to "interval"
+ * using "cf". Values are printed with "precision" significant digits. */
 int ident_data_to_json (graph_ident_t *ident,
-    dp_time_t begin, dp_time_t end, dp_time_t interval,
-    yajl_gen handler);
+    dp_time_t begin, dp_time_t end, dp_time_t interval, consolidation_t cf,
+    int precision, yajl_gen handler);
+
+/* Fetches the data of one data source, consolidated to "interval" using
+ * "cf". The caller has to free "ret->values". */
+int ident_data_get_series (graph_ident_t *ident, const char *ds_name,
+    dp_time_t begin, dp_time_t end, dp_time_t interval, consolidation_t cf,
+    ident_data_series_t *ret);
+
+/* Compact binary alternative to "ident_data_to_json". All numbers are little
+ * endian. A stream starts with an eight byte header written by
+ * "ident_data_binary_header":
+ *
+ *   char[4] magic ("C4DS"), uint8 version, uint8 value size (4 or 8),
+ *   uint16 reserved
+ *
+ * followed by one record per data source:
+ *
+ *   uint32  record size in bytes, including this field (multiple of 8)
+ *   uint32  number of values
+ *   float64 time of the first value
+ *   float64 interval
+ *   6 x (uint16 length, bytes): host, plugin, plugin instance, type,
+ *                               type instance, data source name
+ *   padding to a multiple of 8
+ *   values as float32 or float64, NaN meaning "no data"
+ *   padding to a multiple of 8 */
+int ident_data_binary_header (size_t value_size,
+    ident_print_t print, void *print_ctx);
+int ident_data_to_binary (graph_ident_t *ident,
+    dp_time_t begin, dp_time_t end, dp_time_t interval, consolidation_t cf,
+    size_t value_size, ident_print_t print, void *print_ctx);
 
 int ident_describe (const graph_ident_t *ident, const graph_ident_t *selector,
     char *buffer, size_t buffer_size);
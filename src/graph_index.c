@@ -0,0 +1,731 @@
+/**
+ * collection4 - graph_index.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <assert.h>
+#include <regex.h>
+
+#include "graph_index.h"
+#include "common.h"
+#include "graph.h"
+#include "graph_ident.h"
+#include "graph_instance.h"
+#include "utils_idset.h"
+
+#include <fcgiapp.h>
+#include <fcgi_stdio.h>
+
+/*
+ * Data types
+ */
+struct idx_entry_s
+{
+  graph_config_t *cfg;
+  graph_instance_t *inst;
+  /* Lower case description of the instance, see "inst_describe". */
+  char *desc;
+  /* Index into "graph_index_s.titles" and "graph_index_s.graphs" */
+  size_t title;
+  /* Graph and instance selector, see "idx_get_key". */
+  char *key;
+};
+typedef struct idx_entry_s idx_entry_t;
+
+/* The instances of a graph occupy the IDs first .. (first + num - 1), sorted
+ * by their selector. */
+struct idx_graph_s
+{
+  char *key;
+  uint32_t first;
+  uint32_t num;
+};
+typedef struct idx_graph_s idx_graph_t;
+
+/* (value, ID) pairs are collected while instances are added and turned into
+ * posting lists by "idx_finalize". */
+struct idx_pair_s
+{
+  char *value;
+  uint32_t id;
+};
+typedef struct idx_pair_s idx_pair_t;
+
+struct idx_posting_s
+{
+  char *value;
+  idset_t *ids;
+};
+typedef struct idx_posting_s idx_posting_t;
+
+struct idx_field_s
+{
+  idx_pair_t *pairs;
+  size_t pairs_num;
+  size_t pairs_alloc;
+
+  idx_posting_t *postings;
+  size_t postings_num;
+};
+typedef struct idx_field_s idx_field_t;
+
+struct graph_index_s /* {{{ */
+{
+  idx_entry_t *entries;
+  size_t entries_num;
+  size_t entries_alloc;
+
+  char **titles;
+  idx_graph_t *graphs;
+  size_t titles_num;
+
+  idx_field_t fields[_GIF_LAST];
+
+  _Bool finalized;
+}; /* }}} struct graph_index_s */
+
+struct idx_add_data_s
+{
+  graph_index_t *idx;
+  graph_config_t *cfg;
+  size_t title;
+  graph_ident_field_t field;
+  uint32_t id;
+};
+typedef struct idx_add_data_s idx_add_data_t;
+
+/*
+ * Private functions
+ */
+/* Joins the fields of "ident" using tabs. Tabs sort before all characters
+ * used in identifiers, so comparing two keys with "strcmp" yields the same
+ * order as "ident_compare". */
+static int idx_ident_key (const graph_ident_t *ident, /* {{{ */
+    char *buffer, size_t buffer_size)
+{
+  graph_ident_field_t field;
+  size_t len;
+
+  if (ident == NULL)
+    return (ENOMEM);
+
+  len = 0;
+  buffer[0] = 0;
+  for (field = 0; field < _GIF_LAST; field++)
+  {
+    if (field > 0)
+      strlcat (buffer, "\t", buffer_size);
+    len = strlcat (buffer, ident_get_field (ident, field), buffer_size);
+  }
+
+  if (len >= buffer_size)
+    return (ENAMETOOLONG);
+  return (0);
+} /* }}} int idx_ident_key */
+
+static int idx_pair_compare (const void *v0, const void *v1) /* {{{ */
+{
+  const idx_pair_t *p0 = v0;
+  const idx_pair_t *p1 = v1;
+  int status;
+
+  status = strcmp (p0->value, p1->value);
+  if (status != 0)
+    return (status);
+
+  if (p0->id < p1->id)
+    return (-1);
+  else if (p0->id > p1->id)
+    return (1);
+  return (0);
+} /* }}} int idx_pair_compare */
+
+static int idx_posting_compare (const void *v0, const void *v1) /* {{{ */
+{
+  const idx_posting_t *p0 = v0;
+  const idx_posting_t *p1 = v1;
+
+  return (strcmp (p0->value, p1->value));
+} /* }}} int idx_posting_compare */
+
+static int idx_add_value_cb (const char *value, void *user_data) /* {{{ */
+{
+  idx_add_data_t *data = user_data;
+  idx_field_t *f = data->idx->fields + data->field;
+  idx_pair_t *last;
+  char *copy;
+
+  /* Files of one instance often share the same value, e.g. the host name.
+   * Skip the most obvious duplicates right away. */
+  last = (f->pairs_num > 0) ? (f->pairs + (f->pairs_num - 1)) : NULL;
+  if ((last != NULL) && (last->id == data->id)
+      && (strcasecmp (last->value, value) == 0))
+    return (0);
+
+  if (f->pairs_num >= f->pairs_alloc)
+  {
+    idx_pair_t *tmp;
+    size_t new_alloc = (f->pairs_alloc > 0) ? (2 * f->pairs_alloc) : 64;
+
+    tmp = realloc (f->pairs, sizeof (*f->pairs) * new_alloc);
+    if (tmp == NULL)
+      return (ENOMEM);
+    f->pairs = tmp;
+    f->pairs_alloc = new_alloc;
+  }
+
+  copy = strtolower_copy (value);
+  if (copy == NULL)
+    return (ENOMEM);
+
+  f->pairs[f->pairs_num].value = copy;
+  f->pairs[f->pairs_num].id = data->id;
+  f->pairs_num++;
+
+  return (0);
+} /* }}} int idx_add_value_cb */
+
+static int idx_add_inst_cb (graph_instance_t *inst, /* {{{ */
+    void *user_data)
+{
+  idx_add_data_t *data = user_data;
+  graph_index_t *idx = data->idx;
+  idx_entry_t *entry;
+  graph_ident_t *selector;
+  char desc[1024];
+  char key[2048];
+  size_t len;
+  int status;
+
+  if (idx->entries_num >= idx->entries_alloc)
+  {
+    idx_entry_t *tmp;
+    size_t new_alloc = (idx->entries_alloc > 0)
+      ? (2 * idx->entries_alloc) : 64;
+
+    tmp = realloc (idx->entries, sizeof (*idx->entries) * new_alloc);
+    if (tmp == NULL)
+      return (ENOMEM);
+    idx->entries = tmp;
+    idx->entries_alloc = new_alloc;
+  }
+
+  memset (desc, 0, sizeof (desc));
+  status = inst_describe (data->cfg, inst, desc, sizeof (desc));
+  if (status != 0)
+  {
+    fprintf (stderr, "idx_add_inst_cb: inst_describe failed\n");
+    return (status);
+  }
+
+  /* The key is "<graph key>\t<instance key>". */
+  key[0] = 0;
+  strlcat (key, idx->graphs[data->title].key, sizeof (key));
+  strlcat (key, "\t", sizeof (key));
+  len = strlen (key);
+
+  selector = inst_get_selector (inst);
+  status = idx_ident_key (selector, key + len, sizeof (key) - len);
+  ident_destroy (selector);
+  if (status != 0)
+  {
+    fprintf (stderr, "idx_add_inst_cb: idx_ident_key failed\n");
+    return (status);
+  }
+
+  entry = idx->entries + idx->entries_num;
+  memset (entry, 0, sizeof (*entry));
+  entry->cfg = data->cfg;
+  entry->inst = inst;
+  entry->title = data->title;
+  entry->desc = strtolower_copy (desc);
+  entry->key = strdup (key);
+  if ((entry->desc == NULL) || (entry->key == NULL))
+  {
+    free (entry->desc);
+    free (entry->key);
+    return (ENOMEM);
+  }
+
+  data->id = (uint32_t) idx->entries_num;
+  idx->entries_num++;
+  idx->graphs[data->title].num++;
+
+  for (data->field = 0; data->field < _GIF_LAST; data->field++)
+  {
+    status = inst_field_foreach (inst, data->field,
+        idx_add_value_cb, data);
+    if (status != 0)
+      return (status);
+  }
+
+  return (0);
+} /* }}} int idx_add_inst_cb */
+
+static int idx_finalize_field (idx_field_t *f) /* {{{ */
+{
+  size_t i;
+
+  if (f->pairs_num == 0)
+    return (0);
+
+  qsort (f->pairs, f->pairs_num, sizeof (*f->pairs), idx_pair_compare);
+
+  /* The number of distinct values is not known yet, so allocate the worst
+   * case and shrink afterwards. */
+  f->postings = calloc (f->pairs_num, sizeof (*f->postings));
+  if (f->postings == NULL)
+    return (ENOMEM);
+  f->postings_num = 0;
+
+  for (i = 0; i < f->pairs_num; i++)
+  {
+    idx_posting_t *p = NULL;
+
+    if (f->postings_num > 0)
+      p = f->postings + (f->postings_num - 1);
+
+    if ((p == NULL) || (strcmp (p->value, f->pairs[i].value) != 0))
+    {
+      p = f->postings + f->postings_num;
+      p->ids = idset_create ();
+      if (p->ids == NULL)
+        return (ENOMEM);
+      p->value = f->pairs[i].value;
+      f->postings_num++;
+    }
+    else
+    {
+      free (f->pairs[i].value);
+    }
+    f->pairs[i].value = NULL;
+
+    /* Duplicate (value, ID) pairs are rejected by "idset_append". */
+    idset_append (p->ids, f->pairs[i].id);
+  }
+
+  free (f->pairs);
+  f->pairs = NULL;
+  f->pairs_num = 0;
+  f->pairs_alloc = 0;
+
+  if (f->postings_num > 0)
+  {
+    idx_posting_t *tmp;
+
+    tmp = realloc (f->postings, sizeof (*f->postings) * f->postings_num);
+    if (tmp != NULL)
+      f->postings = tmp;
+  }
+
+  return (0);
+} /* }}} int idx_finalize_field */
+
+/*
+ * Public functions
+ */
+graph_index_t *idx_create (void) /* {{{ */
+{
+  graph_index_t *idx;
+
+  idx = malloc (sizeof (*idx));
+  if (idx == NULL)
+    return (NULL);
+  memset (idx, 0, sizeof (*idx));
+
+  idx->entries = NULL;
+  idx->titles = NULL;
+  idx->finalized = 0;
+
+  return (idx);
+} /* }}} graph_index_t *idx_create */
+
+void idx_destroy (graph_index_t *idx) /* {{{ */
+{
+  size_t i;
+  size_t j;
+
+  if (idx == NULL)
+    return;
+
+  for (i = 0; i < idx->entries_num; i++)
+  {
+    free (idx->entries[i].desc);
+    free (idx->entries[i].key);
+  }
+  free (idx->entries);
+
+  for (i = 0; i < idx->titles_num; i++)
+  {
+    free (idx->titles[i]);
+    free (idx->graphs[i].key);
+  }
+  free (idx->titles);
+  free (idx->graphs);
+
+  for (i = 0; i < _GIF_LAST; i++)
+  {
+    idx_field_t *f = idx->fields + i;
+
+    for (j = 0; j < f->pairs_num; j++)
+      free (f->pairs[j].value);
+    free (f->pairs);
+
+    for (j = 0; j < f->postings_num; j++)
+    {
+      free (f->postings[j].value);
+      idset_destroy (f->postings[j].ids);
+    }
+    free (f->postings);
+  }
+
+  free (idx);
+} /* }}} void idx_destroy */
+
+int idx_add_graph (graph_index_t *idx, graph_config_t *cfg) /* {{{ */
+{
+  idx_add_data_t data;
+  graph_ident_t *selector;
+  idx_graph_t *graph;
+  char title[1024];
+  char key[1024];
+  char **tmp;
+  idx_graph_t *tmp_graphs;
+  int status;
+
+  if ((idx == NULL) || (cfg == NULL) || idx->finalized)
+    return (EINVAL);
+
+  memset (title, 0, sizeof (title));
+  status = graph_get_title (cfg, title, sizeof (title));
+  if (status != 0)
+  {
+    fprintf (stderr, "idx_add_graph: graph_get_title failed\n");
+    return (status);
+  }
+
+  selector = graph_get_selector (cfg);
+  status = idx_ident_key (selector, key, sizeof (key));
+  ident_destroy (selector);
+  if (status != 0)
+  {
+    fprintf (stderr, "idx_add_graph: idx_ident_key failed\n");
+    return (status);
+  }
+
+  tmp = realloc (idx->titles, sizeof (*idx->titles) * (idx->titles_num + 1));
+  if (tmp == NULL)
+    return (ENOMEM);
+  idx->titles = tmp;
+
+  tmp_graphs = realloc (idx->graphs,
+      sizeof (*idx->graphs) * (idx->titles_num + 1));
+  if (tmp_graphs == NULL)
+    return (ENOMEM);
+  idx->graphs = tmp_graphs;
+
+  graph = idx->graphs + idx->titles_num;
+  memset (graph, 0, sizeof (*graph));
+  graph->first = (uint32_t) idx->entries_num;
+
+  idx->titles[idx->titles_num] = strtolower_copy (title);
+  graph->key = strdup (key);
+  if ((idx->titles[idx->titles_num] == NULL) || (graph->key == NULL))
+  {
+    free (idx->titles[idx->titles_num]);
+    free (graph->key);
+    return (ENOMEM);
+  }
+  idx->titles_num++;
+
+  memset (&data, 0, sizeof (data));
+  data.idx = idx;
+  data.cfg = cfg;
+  data.title = idx->titles_num - 1;
+
+  return (graph_inst_foreach (cfg, idx_add_inst_cb, &data));
+} /* }}} int idx_add_graph */
+
+int idx_finalize (graph_index_t *idx) /* {{{ */
+{
+  size_t i;
+
+  if (idx == NULL)
+    return (EINVAL);
+
+  if (idx->finalized)
+    return (0);
+
+  for (i = 0; i < _GIF_LAST; i++)
+  {
+    int status;
+
+    status = idx_finalize_field (idx->fields + i);
+    if (status != 0)
+      return (status);
+  }
+
+  idx->finalized = 1;
+  return (0);
+} /* }}} int idx_finalize */
+
+uint32_t idx_size (const graph_index_t *idx) /* {{{ */
+{
+  if (idx == NULL)
+    return (0);
+
+  return ((uint32_t) idx->entries_num);
+} /* }}} uint32_t idx_size */
+
+int idx_get (const graph_index_t *idx, uint32_t id, /* {{{ */
+    graph_config_t **ret_cfg, graph_instance_t **ret_inst)
+{
+  if ((idx == NULL) || (id >= idx->entries_num))
+    return (EINVAL);
+
+  if (ret_cfg != NULL)
+    *ret_cfg = idx->entries[id].cfg;
+  if (ret_inst != NULL)
+    *ret_inst = idx->entries[id].inst;
+
+  return (0);
+} /* }}} int idx_get */
+
+const char *idx_get_key (const graph_index_t *idx, uint32_t id) /* {{{ */
+{
+  if ((idx == NULL) || (id >= idx->entries_num))
+    return (NULL);
+
+  return (idx->entries[id].key);
+} /* }}} const char *idx_get_key */
+
+uint32_t idx_seek (const graph_index_t *idx, const char *key) /* {{{ */
+{
+  size_t i;
+
+  if ((idx == NULL) || (key == NULL))
+    return (0);
+
+  for (i = 0; i < idx->titles_num; i++)
+  {
+    const idx_graph_t *g = idx->graphs + i;
+    size_t g_len = strlen (g->key);
+    uint32_t lo;
+    uint32_t hi;
+
+    if ((strncmp (g->key, key, g_len) != 0) || (key[g_len] != '\t'))
+      continue;
+
+    /* Within a graph, the keys are sorted. Find the first instance whose key
+     * is not less than "key". If there is none, the first instance of the
+     * next graph follows. */
+    lo = g->first;
+    hi = g->first + g->num;
+    while (lo < hi)
+    {
+      uint32_t mid = lo + ((hi - lo) / 2);
+
+      if (strcmp (idx->entries[mid].key, key) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    return (lo);
+  }
+
+  /* The graph is gone. */
+  return (0);
+} /* }}} uint32_t idx_seek */
+
+const idset_t *idx_lookup_field (const graph_index_t *idx, /* {{{ */
+    graph_ident_field_t field, const char *value)
+{
+  const idx_field_t *f;
+  idx_posting_t key;
+  idx_posting_t *p;
+
+  if ((idx == NULL) || (field >= _GIF_LAST) || (value == NULL))
+    return (NULL);
+
+  assert (idx->finalized);
+
+  f = idx->fields + field;
+  if (f->postings_num == 0)
+    return (NULL);
+
+  key.value = strtolower_copy (value);
+  if (key.value == NULL)
+    return (NULL);
+  key.ids = NULL;
+
+  p = bsearch (&key, f->postings, f->postings_num, sizeof (*f->postings),
+      idx_posting_compare);
+
+  free (key.value);
+
+  if (p == NULL)
+    return (NULL);
+  return (p->ids);
+} /* }}} const idset_t *idx_lookup_field */
+
+static int idx_id_compare (const void *v0, const void *v1) /* {{{ */
+{
+  uint32_t id0 = *((const uint32_t *) v0);
+  uint32_t id1 = *((const uint32_t *) v1);
+
+  if (id0 < id1)
+    return (-1);
+  else if (id0 > id1)
+    return (1);
+  return (0);
+} /* }}} int idx_id_compare */
+
+idset_t *idx_lookup_field_regex (const graph_index_t *idx, /* {{{ */
+    graph_ident_field_t field, const regex_t *re, const char *literal)
+{
+  const idx_field_t *f;
+  uint32_t *ids;
+  size_t ids_num;
+  size_t ids_alloc;
+  idset_t *ret;
+  size_t i;
+
+  if ((idx == NULL) || (field >= _GIF_LAST) || (re == NULL))
+    return (NULL);
+
+  assert (idx->finalized);
+
+  f = idx->fields + field;
+
+  ids = NULL;
+  ids_num = 0;
+  ids_alloc = 0;
+
+  /* Collect the IDs of all matching values and sort them once, rather than
+   * building the union of the posting lists one by one. */
+  for (i = 0; i < f->postings_num; i++)
+  {
+    const idx_posting_t *p = f->postings + i;
+    size_t p_num;
+
+    if ((literal != NULL) && (strstr (p->value, literal) == NULL))
+      continue;
+
+    if (regexec (re, p->value, /* nmatch = */ 0, NULL, /* flags = */ 0) != 0)
+      continue;
+
+    p_num = idset_size (p->ids);
+    if ((ids_num + p_num) > ids_alloc)
+    {
+      size_t new_alloc = (ids_alloc == 0) ? 64 : ids_alloc;
+      uint32_t *tmp;
+
+      while (new_alloc < (ids_num + p_num))
+        new_alloc *= 2;
+
+      tmp = realloc (ids, sizeof (*ids) * new_alloc);
+      if (tmp == NULL)
+      {
+        free (ids);
+        return (NULL);
+      }
+      ids = tmp;
+      ids_alloc = new_alloc;
+    }
+
+    memcpy (ids + ids_num, idset_ids (p->ids), sizeof (*ids) * p_num);
+    ids_num += p_num;
+  }
+
+  ret = idset_create ();
+  if (ret == NULL)
+  {
+    free (ids);
+    return (NULL);
+  }
+
+  if (ids_num > 0)
+    qsort (ids, ids_num, sizeof (*ids), idx_id_compare);
+
+  for (i = 0; i < ids_num; i++)
+  {
+    if ((i > 0) && (ids[i] == ids[i - 1]))
+      continue;
+
+    if (idset_append (ret, ids[i]) != 0)
+    {
+      idset_destroy (ret);
+      ret = NULL;
+      break;
+    }
+  }
+
+  free (ids);
+  return (ret);
+} /* }}} idset_t *idx_lookup_field_regex */
+
+_Bool idx_matches_string (const graph_index_t *idx, uint32_t id, /* {{{ */
+    const char *term)
+{
+  const idx_entry_t *entry;
+
+  if ((idx == NULL) || (id >= idx->entries_num) || (term == NULL))
+    return (0);
+
+  entry = idx->entries + id;
+
+  if (strstr (entry->desc, term) != NULL)
+    return (1);
+
+  if (strstr (idx->titles[entry->title], term) != NULL)
+    return (1);
+
+  return (0);
+} /* }}} _Bool idx_matches_string */
+
+_Bool idx_matches_regex (const graph_index_t *idx, uint32_t id, /* {{{ */
+    const regex_t *re)
+{
+  const idx_entry_t *entry;
+
+  if ((idx == NULL) || (id >= idx->entries_num) || (re == NULL))
+    return (0);
+
+  entry = idx->entries + id;
+
+  if (regexec (re, entry->desc, /* nmatch = */ 0, NULL, /* flags = */ 0) == 0)
+    return (1);
+
+  if (regexec (re, idx->titles[entry->title],
+        /* nmatch = */ 0, NULL, /* flags = */ 0) == 0)
+    return (1);
+
+  return (0);
+} /* }}} _Bool idx_matches_regex */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,98 @@
+/**
+ * collection4 - graph_index.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef GRAPH_INDEX_H
+#define GRAPH_INDEX_H 1
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <regex.h>
+
+#include "graph_types.h"
+#include "graph_ident.h"
+#include "utils_idset.h"
+
+/*
+ * The graph index assigns a numeric ID to each graph instance and keeps, for
+ * each identifier field, a sorted list of all values together with the set of
+ * instances that contain this value ("posting list"). Searches are evaluated
+ * as set operations on these lists instead of calling a predicate for each
+ * instance.
+ *
+ * IDs are assigned in the order in which instances are added, so iterating
+ * over a result set returns the instances in the same order in which they
+ * were added, grouped by graph. The instances of each graph must be sorted,
+ * see "graph_sort_instances".
+ */
+struct graph_index_s;
+typedef struct graph_index_s graph_index_t;
+
+graph_index_t *idx_create (void);
+void idx_destroy (graph_index_t *idx);
+
+/* Adds all instances of the graph to the index. */
+int idx_add_graph (graph_index_t *idx, graph_config_t *cfg);
+
+/* Must be called after all graphs have been added and before the index is
+ * queried. */
+int idx_finalize (graph_index_t *idx);
+
+uint32_t idx_size (const graph_index_t *idx);
+
+int idx_get (const graph_index_t *idx, uint32_t id,
+    graph_config_t **ret_cfg, graph_instance_t **ret_inst);
+
+/* Returns a string identifying the instance by the selectors of the graph and
+ * the instance. Unlike the ID, the key doesn't change when the index is
+ * rebuilt. The string is owned by the index. */
+const char *idx_get_key (const graph_index_t *idx, uint32_t id);
+
+/* Returns the ID of the instance with the given key. If there is no such
+ * instance, the ID of the instance which would follow it is returned, which
+ * may be "idx_size (idx)". Returns zero if the graph is unknown. */
+uint32_t idx_seek (const graph_index_t *idx, const char *key);
+
+/* Returns the set of instances in which "field" has the value "value".
+ * Comparison is done case-insensitive. The returned set is owned by the index
+ * and must not be freed. Returns NULL if no instance has this value. */
+const idset_t *idx_lookup_field (const graph_index_t *idx,
+    graph_ident_field_t field, const char *value);
+
+/* Returns the set of instances in which "field" has a value matching the
+ * regular expression "re". Values not containing "literal" are skipped
+ * without running the regular expression; pass NULL to check all values.
+ * The returned set must be freed with "idset_destroy". */
+idset_t *idx_lookup_field_regex (const graph_index_t *idx,
+    graph_ident_field_t field, const regex_t *re, const char *literal);
+
+/* Returns true if "term" is a sub-string of the (lower case) description of
+ * the instance or the (lower case) title of its graph. */
+_Bool idx_matches_string (const graph_index_t *idx, uint32_t id,
+    const char *term);
+
+/* Like "idx_matches_string", but matches a regular expression. */
+_Bool idx_matches_regex (const graph_index_t *idx, uint32_t id,
+    const regex_t *re);
+
+#endif /* GRAPH_INDEX_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
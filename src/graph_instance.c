@@ -26,6 +26,8 @@
 #include <errno.h>
 #include <time.h>
 #include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "graph_instance.h"
 #include "graph.h"
@@ -44,86 +46,200 @@ struct graph_instance_s /* {{{ */
 
   graph_ident_t **files;
   size_t files_num;
+
+  /* Title, DEFs, CDEFs, areas and lines, built on first use. Instances are
+   * recreated when the graph list is rebuilt or the config is reloaded,
+   * which takes care of invalidating this. */
+  rrd_args_t *rrdargs;
+  /* DEFs used if the graph doesn't configure any, built on first use. */
+  graph_def_t *default_defs;
 }; /* }}} struct graph_instance_s */
 
 struct def_callback_data_s
 {
   graph_instance_t *inst;
   rrd_args_t *args;
+  /* Set for default DEFs, see "inst_find_default_file". */
+  _Bool is_default;
+  size_t file_index;
 };
 typedef struct def_callback_data_s def_callback_data_t;
 
-/*
- * Private functions
- */
-struct ident_get_default_defs__data_s
+struct def_file_callback_data_s
+{
+  graph_instance_t *inst;
+  inst_def_file_callback_t callback;
+  void *user_data;
+  _Bool is_default;
+  size_t file_index;
+};
+typedef struct def_file_callback_data_s def_file_callback_data_t;
+
+/* The data sources of each file are remembered, so they are read only once
+ * rather than every time the graph list is rebuilt. Files of the same type
+ * may have different data sources, so the list is kept per file. The data
+ * sources can only change by recreating the file, which is detected by its
+ * inode number. */
+#define DS_SET_HASH_SIZE 1024
+
+struct ds_set_s;
+typedef struct ds_set_s ds_set_t;
+struct ds_set_s
 {
+  char *file;
+  dev_t dev;
+  ino_t ino;
+  /* Value of "ds_set_generation" when the entry was last used. */
+  unsigned int generation;
+
   char **dses;
   size_t dses_num;
+
+  ds_set_t *next;
 };
-typedef struct ident_get_default_defs__data_s ident_get_default_defs__data_t;
 
-static int ident_get_default_defs__callback (__attribute__((unused))
+static ds_set_t *ds_sets[DS_SET_HASH_SIZE];
+static unsigned int ds_set_generation = 0;
+
+/*
+ * Private functions
+ */
+static int ds_set_add_ds (__attribute__((unused)) /* {{{ */
     graph_ident_t *ident,
     const char *ds_name, void *user_data)
 {
-  ident_get_default_defs__data_t *data = user_data;
+  ds_set_t *set = user_data;
   char **tmp;
 
-  tmp = realloc (data->dses, (data->dses_num + 1) * sizeof (data->dses));
+  tmp = realloc (set->dses, (set->dses_num + 1) * sizeof (*set->dses));
   if (tmp == NULL)
     return (ENOMEM);
-  data->dses = tmp;
+  set->dses = tmp;
 
-  data->dses[data->dses_num] = strdup (ds_name);
-  if (data->dses[data->dses_num] == NULL)
+  set->dses[set->dses_num] = strdup (ds_name);
+  if (set->dses[set->dses_num] == NULL)
     return (ENOMEM);
 
-  data->dses_num++;
+  set->dses_num++;
   return (0);
-} /* }}} int ident_get_default_defs__callback */
+} /* }}} int ds_set_add_ds */
 
-/* Create one DEF for each data source in the file. Called by
- * "inst_get_default_defs" for each file. */
-static graph_def_t *ident_get_default_defs (graph_config_t *cfg, /* {{{ */
-    graph_ident_t *ident, graph_def_t *def_head)
+static void ds_set_destroy (ds_set_t *set) /* {{{ */
 {
-  graph_def_t *defs = NULL;
-  char *file;
-  ident_get_default_defs__data_t ds_data;
-  int status;
   size_t i;
 
-  ds_data.dses = NULL;
-  ds_data.dses_num = 0;
+  if (set == NULL)
+    return;
 
-  if ((cfg == NULL) || (ident == NULL))
-    return (def_head);
+  for (i = 0; i < set->dses_num; i++)
+    free (set->dses[i]);
+  free (set->dses);
+  free (set->file);
+
+  free (set);
+} /* }}} void ds_set_destroy */
+
+static uint32_t ds_set_hash (const char *file) /* {{{ */
+{
+  uint32_t hash = 2166136261U;
+  const char *ptr;
+
+  /* FNV-1a */
+  for (ptr = file; *ptr != 0; ptr++)
+    hash = (hash ^ ((uint32_t) (unsigned char) *ptr)) * 16777619U;
+
+  return (hash);
+} /* }}} uint32_t ds_set_hash */
+
+/* Returns the data sources of "ident". They are read from the data provider
+ * only if the file hasn't been seen before or has been recreated since. */
+static const ds_set_t *ds_set_get (graph_ident_t *ident) /* {{{ */
+{
+  struct stat statbuf;
+  ds_set_t **prev;
+  ds_set_t *set;
+  uint32_t bucket;
+  char *file;
+  int status;
 
   file = ident_to_file (ident);
   if (file == NULL)
+    return (NULL);
+
+  memset (&statbuf, 0, sizeof (statbuf));
+  if (stat (file, &statbuf) != 0)
   {
-    fprintf (stderr, "ident_get_default_defs: ident_to_file failed\n");
-    return (def_head);
+    free (file);
+    return (NULL);
   }
 
-  status = data_provider_get_ident_ds_names (ident,
-      ident_get_default_defs__callback, &ds_data);
-  if (status != 0)
+  bucket = ds_set_hash (file) % DS_SET_HASH_SIZE;
+  for (prev = &ds_sets[bucket]; *prev != NULL; prev = &(*prev)->next)
+  {
+    set = *prev;
+    if (strcmp (file, set->file) != 0)
+      continue;
+
+    if ((set->dev == statbuf.st_dev) && (set->ino == statbuf.st_ino))
+    {
+      set->generation = ds_set_generation;
+      free (file);
+      return (set);
+    }
+
+    /* The file has been recreated. */
+    *prev = set->next;
+    ds_set_destroy (set);
+    break;
+  }
+
+  set = malloc (sizeof (*set));
+  if (set == NULL)
   {
     free (file);
-    return (def_head);
+    return (NULL);
   }
+  memset (set, 0, sizeof (*set));
 
-  for (i = 0; i < ds_data.dses_num; i++)
+  set->file = file;
+  set->dev = statbuf.st_dev;
+  set->ino = statbuf.st_ino;
+  set->generation = ds_set_generation;
+
+  status = data_provider_get_ident_ds_names (ident, ds_set_add_ds, set);
+  if ((status != 0) || (set->dses_num == 0))
   {
-    graph_def_t *def;
+    ds_set_destroy (set);
+    return (NULL);
+  }
 
-    def = def_search (def_head, ident, ds_data.dses[i]);
-    if (def != NULL)
-      continue;
+  set->next = ds_sets[bucket];
+  ds_sets[bucket] = set;
+
+  return (set);
+} /* }}} ds_set_t *ds_set_get */
 
-    def = def_create (cfg, ident, ds_data.dses[i]);
+/* Create one DEF for each data source in the file. Called by
+ * "inst_get_default_defs" for each file. */
+static graph_def_t *ident_get_default_defs (graph_config_t *cfg, /* {{{ */
+    graph_ident_t *ident)
+{
+  graph_def_t *defs = NULL;
+  const ds_set_t *ds_set;
+  size_t i;
+
+  if ((cfg == NULL) || (ident == NULL))
+    return (NULL);
+
+  ds_set = ds_set_get (ident);
+  if (ds_set == NULL)
+    return (NULL);
+
+  for (i = 0; i < ds_set->dses_num; i++)
+  {
+    graph_def_t *def;
+
+    def = def_create (cfg, ident, ds_set->dses[i]);
     if (def == NULL)
       continue;
 
@@ -131,16 +247,52 @@ static graph_def_t *ident_get_default_defs (graph_config_t *cfg, /* {{{ */
       defs = def;
     else
       def_append (defs, def);
-
-    free (ds_data.dses[i]);
   }
 
-  free (ds_data.dses);
-  free (file);
-
   return (defs);
 } /* }}} int ident_get_default_defs */
 
+/* Default DEFs apply to exactly one file each and are in the same order as
+ * the files. The search for a DEF's file therefore starts at the file of the
+ * previous DEF, which usually matches right away. Returns "files_num" if no
+ * file matches. */
+static size_t inst_find_default_file (graph_instance_t *inst, /* {{{ */
+    graph_def_t *def, size_t *file_index)
+{
+  size_t n;
+
+  for (n = 0; n < inst->files_num; n++)
+  {
+    size_t i = (*file_index + n) % inst->files_num;
+
+    if (def_matches (def, inst->files[i]))
+    {
+      *file_index = i;
+      return (i);
+    }
+  }
+
+  return (inst->files_num);
+} /* }}} size_t inst_find_default_file */
+
+static int compare_file_ptr (const void *v0, const void *v1) /* {{{ */
+{
+  graph_ident_t * const *f0 = *((graph_ident_t * const * const *) v0);
+  graph_ident_t * const *f1 = *((graph_ident_t * const * const *) v1);
+  int status;
+
+  status = ident_compare (*f0, *f1);
+  if (status != 0)
+    return (status);
+
+  /* Keep the first of several equal files. */
+  if (f0 < f1)
+    return (-1);
+  else if (f0 > f1)
+    return (1);
+  return (0);
+} /* }}} int compare_file_ptr */
+
 /* Called with each DEF in turn. Calls "def_get_rrdargs" with every appropriate
  * file / DEF pair. */
 static int gl_instance_get_rrdargs_cb (graph_def_t *def, void *user_data) /* {{{ */
@@ -152,6 +304,14 @@ static int gl_instance_get_rrdargs_cb (graph_def_t *def, void *user_data) /* {{{
   size_t i;
   int status;
 
+  if (data->is_default)
+  {
+    i = inst_find_default_file (inst, def, &data->file_index);
+    if (i < inst->files_num)
+      def_get_rrdargs (def, inst->files[i], args);
+    return (0);
+  }
+
   for (i = 0; i < inst->files_num; i++)
   {
     if (!def_matches (def, inst->files[i]))
@@ -169,26 +329,56 @@ static int gl_instance_get_rrdargs_cb (graph_def_t *def, void *user_data) /* {{{
   return (0);
 } /* }}} int gl_instance_get_rrdargs_cb */
 
-static const char *get_part_from_param (const char *prim_key, /* {{{ */
-    const char *sec_key)
+static int inst_def_file_foreach_cb (graph_def_t *def, /* {{{ */
+    void *user_data)
+{
+  def_file_callback_data_t *data = user_data;
+  graph_instance_t *inst = data->inst;
+  size_t i;
+  int status;
+
+  if (data->is_default)
+  {
+    i = inst_find_default_file (inst, def, &data->file_index);
+    if (i >= inst->files_num)
+      return (0);
+    return ((*data->callback) (def, inst->files[i], data->user_data));
+  }
+
+  for (i = 0; i < inst->files_num; i++)
+  {
+    if (!def_matches (def, inst->files[i]))
+      continue;
+
+    status = (*data->callback) (def, inst->files[i], data->user_data);
+    if (status != 0)
+      return (status);
+  }
+
+  return (0);
+} /* }}} int inst_def_file_foreach_cb */
+
+static const char *get_part_from_param (const char *prefix, /* {{{ */
+    const char *prim_key, const char *sec_key)
 {
   const char *val;
 
-  val = param (prim_key);
+  val = param_prefixed (prefix, prim_key);
   if (val != NULL)
     return (val);
   
-  return (param (sec_key));
+  return (param_prefixed (prefix, sec_key));
 } /* }}} const char *get_part_from_param */
 
-static graph_ident_t *inst_get_selector_from_params (void) /* {{{ */
+static graph_ident_t *inst_get_selector_from_params ( /* {{{ */
+    const char *prefix)
 {
-  const char *host = get_part_from_param ("inst_host", "host");
-  const char *plugin = get_part_from_param ("inst_plugin", "plugin");
-  const char *plugin_instance = get_part_from_param ("inst_plugin_instance",
+  const char *host = get_part_from_param (prefix, "inst_host", "host");
+  const char *plugin = get_part_from_param (prefix, "inst_plugin", "plugin");
+  const char *plugin_instance = get_part_from_param (prefix, "inst_plugin_instance",
       "plugin_instance");
-  const char *type = get_part_from_param ("inst_type", "type");
-  const char *type_instance = get_part_from_param ("inst_type_instance",
+  const char *type = get_part_from_param (prefix, "inst_type", "type");
+  const char *type_instance = get_part_from_param (prefix, "inst_type_instance",
       "type_instance");
 
   graph_ident_t *ident;
@@ -250,6 +440,8 @@ graph_instance_t *inst_create (graph_config_t *cfg, /* {{{ */
 
   i->files = NULL;
   i->files_num = 0;
+  i->rrdargs = NULL;
+  i->default_defs = NULL;
 
   return (i);
 } /* }}} graph_instance_t *inst_create */
@@ -267,6 +459,9 @@ void inst_destroy (graph_instance_t *inst) /* {{{ */
     ident_destroy (inst->files[i]);
   free (inst->files);
 
+  ra_destroy (inst->rrdargs);
+  def_destroy (inst->default_defs);
+
   free (inst);
 } /* }}} void inst_destroy */
 
@@ -286,16 +481,22 @@ int inst_add_file (graph_instance_t *inst, /* {{{ */
 
   inst->files_num++;
 
+  ra_destroy (inst->rrdargs);
+  inst->rrdargs = NULL;
+  def_destroy (inst->default_defs);
+  inst->default_defs = NULL;
+
   return (0);
 } /* }}} int inst_add_file */
 
-graph_instance_t *inst_get_selected (graph_config_t *cfg) /* {{{ */
+graph_instance_t *inst_get_selected_prefix (graph_config_t *cfg, /* {{{ */
+    const char *prefix)
 {
   graph_ident_t *ident;
   graph_instance_t *inst;
 
   if (cfg == NULL)
-    cfg = gl_graph_get_selected ();
+    cfg = gl_graph_get_selected_prefix (prefix);
 
   if (cfg == NULL)
   {
@@ -303,7 +504,7 @@ graph_instance_t *inst_get_selected (graph_config_t *cfg) /* {{{ */
     return (NULL);
   }
 
-  ident = inst_get_selector_from_params ();
+  ident = inst_get_selector_from_params (prefix);
   if (ident == NULL)
   {
     fprintf (stderr, "inst_get_selected: ident_create failed\n");
@@ -314,6 +515,11 @@ graph_instance_t *inst_get_selected (graph_config_t *cfg) /* {{{ */
 
   ident_destroy (ident);
   return (inst);
+} /* }}} graph_instance_t *inst_get_selected_prefix */
+
+graph_instance_t *inst_get_selected (graph_config_t *cfg) /* {{{ */
+{
+  return (inst_get_selected_prefix (cfg, /* prefix = */ NULL));
 } /* }}} graph_instance_t *inst_get_selected */
 
 int inst_get_all_selected (graph_config_t *cfg, /* {{{ */
@@ -325,7 +531,7 @@ int inst_get_all_selected (graph_config_t *cfg, /* {{{ */
   if ((cfg == NULL) || (callback == NULL))
     return (EINVAL);
 
-  ident = inst_get_selector_from_params ();
+  ident = inst_get_selector_from_params (/* prefix = */ NULL);
   if (ident == NULL)
   {
     fprintf (stderr, "inst_get_all_selected: "
@@ -339,17 +545,14 @@ int inst_get_all_selected (graph_config_t *cfg, /* {{{ */
   return (status);
 } /* }}} int inst_get_all_selected */
 
-int inst_get_rrdargs (graph_config_t *cfg, /* {{{ */
+static int inst_compile_rrdargs (graph_config_t *cfg, /* {{{ */
     graph_instance_t *inst,
     rrd_args_t *args)
 {
-  def_callback_data_t data = { inst, args };
+  def_callback_data_t data = { inst, args, 0, 0 };
   graph_def_t *defs;
   int status;
 
-  if ((cfg == NULL) || (inst == NULL) || (args == NULL))
-    return (EINVAL);
-
   status = graph_get_rrdargs (cfg, inst, args);
   if (status != 0)
     return (status);
@@ -362,9 +565,8 @@ int inst_get_rrdargs (graph_config_t *cfg, /* {{{ */
     if (defs == NULL)
       return (-1);
 
+    data.is_default = 1;
     status = def_foreach (defs, gl_instance_get_rrdargs_cb, &data);
-
-    def_destroy (defs);
   }
   else
   {
@@ -372,8 +574,67 @@ int inst_get_rrdargs (graph_config_t *cfg, /* {{{ */
   }
 
   return (status);
+} /* }}} int inst_compile_rrdargs */
+
+int inst_get_rrdargs (graph_config_t *cfg, /* {{{ */
+    graph_instance_t *inst,
+    rrd_args_t *args)
+{
+  if ((cfg == NULL) || (inst == NULL) || (args == NULL))
+    return (EINVAL);
+
+  if (inst->rrdargs == NULL)
+  {
+    rrd_args_t *compiled;
+    int status;
+
+    compiled = ra_create ();
+    if (compiled == NULL)
+      return (ENOMEM);
+
+    status = inst_compile_rrdargs (cfg, inst, compiled);
+    if (status != 0)
+    {
+      ra_destroy (compiled);
+      return (status);
+    }
+
+    inst->rrdargs = compiled;
+  }
+
+  args->compiled = inst->rrdargs;
+  return (0);
 } /* }}} int inst_get_rrdargs */
 
+int inst_def_file_foreach (graph_config_t *cfg, /* {{{ */
+    graph_instance_t *inst,
+    inst_def_file_callback_t callback, void *user_data)
+{
+  def_file_callback_data_t data = { inst, callback, user_data, 0, 0 };
+  graph_def_t *defs;
+  int status;
+
+  if ((cfg == NULL) || (inst == NULL) || (callback == NULL))
+    return (EINVAL);
+
+  defs = graph_get_defs (cfg);
+  if (defs == NULL)
+  {
+    defs = inst_get_default_defs (cfg, inst);
+    if (defs == NULL)
+      return (-1);
+
+    data.is_default = 1;
+    status = def_foreach (defs, inst_def_file_foreach_cb, &data);
+  }
+  else
+  {
+    status = def_foreach (defs, inst_def_file_foreach_cb, &data);
+  }
+
+  return (status);
+} /* }}} int inst_def_file_foreach */
+
 /* Create one or more DEFs for each file in the graph instance. The number
  * depends on the number of data sources in each of the files. Called from
  * "inst_get_rrdargs" if no DEFs are available from the configuration.
@@ -382,16 +643,43 @@ graph_def_t *inst_get_default_defs (graph_config_t *cfg, /* {{{ */
     graph_instance_t *inst)
 {
   graph_def_t *defs = NULL;
+  graph_ident_t ***sorted;
+  _Bool *skip;
   size_t i;
 
   if ((cfg == NULL) || (inst == NULL))
     return (NULL);
 
+  if ((inst->default_defs != NULL) || (inst->files_num == 0))
+    return (inst->default_defs);
+
+  /* A file listed twice gets its DEFs only once. Sorting finds duplicates
+   * without comparing every file with every other one. */
+  sorted = malloc (inst->files_num * sizeof (*sorted));
+  skip = calloc (inst->files_num, sizeof (*skip));
+  if ((sorted == NULL) || (skip == NULL))
+  {
+    free (sorted);
+    free (skip);
+    return (NULL);
+  }
+
+  for (i = 0; i < inst->files_num; i++)
+    sorted[i] = inst->files + i;
+  qsort (sorted, inst->files_num, sizeof (*sorted), compare_file_ptr);
+  for (i = 1; i < inst->files_num; i++)
+    if (ident_compare (*sorted[i - 1], *sorted[i]) == 0)
+      skip[sorted[i] - inst->files] = 1;
+  free (sorted);
+
   for (i = 0; i < inst->files_num; i++)
   {
     graph_def_t *def;
 
-    def = ident_get_default_defs (cfg, inst->files[i], defs);
+    if (skip[i])
+      continue;
+
+    def = ident_get_default_defs (cfg, inst->files[i]);
     if (def == NULL)
       continue;
 
@@ -400,10 +688,41 @@ graph_def_t *inst_get_default_defs (graph_config_t *cfg, /* {{{ */
     else
       def_append (defs, def);
   }
+  free (skip);
 
+  inst->default_defs = defs;
   return (defs);
 } /* }}} graph_def_t *inst_get_default_defs */
 
+void inst_clear_ds_cache (void) /* {{{ */
+{
+  size_t i;
+
+  /* Forget the files which haven't been used since the previous rebuild,
+   * i.e. which have been removed or are no longer part of any graph. */
+  for (i = 0; i < DS_SET_HASH_SIZE; i++)
+  {
+    ds_set_t **prev = &ds_sets[i];
+
+    while (*prev != NULL)
+    {
+      ds_set_t *set = *prev;
+
+      if (set->generation != ds_set_generation)
+      {
+        *prev = set->next;
+        ds_set_destroy (set);
+      }
+      else
+      {
+        prev = &set->next;
+      }
+    }
+  }
+
+  ds_set_generation++;
+} /* }}} void inst_clear_ds_cache */
+
 graph_ident_t *inst_get_selector (graph_instance_t *inst) /* {{{ */
 {
   if (inst == NULL)
@@ -578,6 +897,41 @@ _Bool inst_matches_field (graph_instance_t *inst, /* {{{ */
   return (0);
 } /* }}} _Bool inst_matches_field */
 
+int inst_field_foreach (graph_instance_t *inst, /* {{{ */
+    graph_ident_field_t field,
+    int (*callback) (const char *value, void *user_data), void *user_data)
+{
+  const char *selector_field;
+  int status;
+  size_t i;
+
+  if ((inst == NULL) || (callback == NULL))
+    return (EINVAL);
+
+  selector_field = ident_get_field (inst->select, field);
+  if (selector_field == NULL)
+    return (EINVAL);
+
+  assert (!IS_ANY (selector_field));
+  if (!IS_ALL (selector_field))
+    return ((*callback) (selector_field, user_data));
+
+  for (i = 0; i < inst->files_num; i++)
+  {
+    const char *file_field;
+
+    file_field = ident_get_field (inst->files[i], field);
+    if (file_field == NULL)
+      continue;
+
+    status = (*callback) (file_field, user_data);
+    if (status != 0)
+      return (status);
+  }
+
+  return (0);
+} /* }}} int inst_field_foreach */
+
 int inst_to_json (const graph_instance_t *inst, /* {{{ */
     yajl_gen handler)
 {
@@ -605,19 +959,38 @@ int inst_to_json (const graph_instance_t *inst, /* {{{ */
 } /* }}} int inst_to_json */
 
 int inst_data_to_json (const graph_instance_t *inst, /* {{{ */
-    dp_time_t begin, dp_time_t end, dp_time_t res,
-    yajl_gen handler)
+    dp_time_t begin, dp_time_t end, dp_time_t res, consolidation_t cf,
+    int precision, yajl_gen handler)
 {
   size_t i;
 
   yajl_gen_array_open (handler);
   for (i = 0; i < inst->files_num; i++)
-    ident_data_to_json (inst->files[i], begin, end, res, handler);
+    ident_data_to_json (inst->files[i], begin, end, res, cf, precision,
+        handler);
   yajl_gen_array_close (handler);
 
   return (0);
 } /* }}} int inst_data_to_json */
 
+int inst_data_to_binary (const graph_instance_t *inst, /* {{{ */
+    dp_time_t begin, dp_time_t end, dp_time_t res, consolidation_t cf,
+    size_t value_size, ident_print_t print, void *print_ctx)
+{
+  size_t i;
+  int status;
+
+  status = ident_data_binary_header (value_size, print, print_ctx);
+  if (status != 0)
+    return (status);
+
+  for (i = 0; i < inst->files_num; i++)
+    ident_data_to_binary (inst->files[i], begin, end, res, cf, value_size,
+        print, print_ctx);
+
+  return (0);
+} /* }}} int inst_data_to_binary */
+
 int inst_describe (graph_config_t *cfg, graph_instance_t *inst, /* {{{ */
     char *buffer, size_t buffer_size)
 {
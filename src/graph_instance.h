@@ -34,6 +34,9 @@
 #include "rrd_args.h"
 #include "utils_array.h"
 
+typedef int (*inst_def_file_callback_t) (graph_def_t *def,
+    graph_ident_t *file, void *user_data);
+
 /*
  * Methods
  */
@@ -45,6 +48,10 @@ void inst_destroy (graph_instance_t *inst);
 int inst_add_file (graph_instance_t *inst, const graph_ident_t *file);
 
 graph_instance_t *inst_get_selected (graph_config_t *cfg);
+/* Like "inst_get_selected", but reads the parameters prefixed with "prefix",
+ * see "param_prefixed". */
+graph_instance_t *inst_get_selected_prefix (graph_config_t *cfg,
+    const char *prefix);
 
 int inst_get_all_selected (graph_config_t *cfg,
     graph_inst_callback_t callback, void *user_data);
@@ -52,12 +59,26 @@ int inst_get_all_selected (graph_config_t *cfg,
 int inst_get_params (graph_config_t *cfg, graph_instance_t *inst,
     char *buffer, size_t buffer_size);
 
+/* Makes "args" refer to the title, DEFs and lines of the instance, which are
+ * built once and kept with the instance. The caller only adds the options
+ * that differ per request, such as the time range and size. */
 int inst_get_rrdargs (graph_config_t *cfg, graph_instance_t *inst,
     rrd_args_t *args);
 
+/* Calls "callback" with each DEF of the graph and each file of the instance
+ * the DEF applies to, in the same order as "inst_get_rrdargs". */
+int inst_def_file_foreach (graph_config_t *cfg, graph_instance_t *inst,
+    inst_def_file_callback_t callback, void *user_data);
+
+/* Returns the DEFs used if the graph doesn't configure any. They belong to
+ * the instance and must not be freed by the caller. */
 graph_def_t *inst_get_default_defs (graph_config_t *cfg,
     graph_instance_t *inst);
 
+/* Forgets the data sources remembered for files which haven't been used
+ * since the last call. Called once whenever the data provider is rescanned. */
+void inst_clear_ds_cache (void);
+
 /* Returns a copy of the selector which must be freed by the caller. */
 graph_ident_t *inst_get_selector (graph_instance_t *inst);
 
@@ -84,10 +105,21 @@ _Bool inst_matches_string (graph_config_t *cfg, graph_instance_t *inst,
 _Bool inst_matches_field (graph_instance_t *inst,
     graph_ident_field_t field, const char *field_value);
 
+/* Calls "callback" with each value the field "field" may have for this
+ * instance. That's the value of the selector or, if the selector field is
+ * "/all/", the value of the field of each file. Values may be passed to the
+ * callback more than once. */
+int inst_field_foreach (graph_instance_t *inst, graph_ident_field_t field,
+    int (*callback) (const char *value, void *user_data), void *user_data);
+
 int inst_to_json (const graph_instance_t *inst, yajl_gen handler);
 int inst_data_to_json (const graph_instance_t *inst,
-    dp_time_t begin, dp_time_t end, dp_time_t res,
-    yajl_gen handler);
+    dp_time_t begin, dp_time_t end, dp_time_t res, consolidation_t cf,
+    int precision, yajl_gen handler);
+/* Writes the data in the binary format described in graph_ident.h. */
+int inst_data_to_binary (const graph_instance_t *inst,
+    dp_time_t begin, dp_time_t end, dp_time_t res, consolidation_t cf,
+    size_t value_size, ident_print_t print, void *print_ctx);
 
 int inst_describe (graph_config_t *cfg, graph_instance_t *inst,
     char *buffer, size_t buffer_size);
@@ -44,8 +44,10 @@
 #include "graph_config.h"
 #include "graph_def.h"
 #include "graph_ident.h"
+#include "graph_index.h"
 #include "graph_instance.h"
 #include "utils_cgi.h"
+#include "utils_idset.h"
 #include "utils_search.h"
 
 #include <fcgiapp.h>
@@ -55,6 +57,18 @@
  * Defines
  */
 #define UPDATE_INTERVAL 900
+#define SEARCH_CACHE_SIZE 32
+
+/*
+ * Data types
+ */
+struct gl_search_cache_entry_s
+{
+  /* see "search_to_string" */
+  char *key;
+  idset_t *matches;
+};
+typedef struct gl_search_cache_entry_s gl_search_cache_entry_t;
 
 /*
  * Global variables
@@ -75,6 +89,16 @@ static size_t host_list_len = 0;
 
 static time_t gl_last_update = 0;
 
+/* Search index over all instances of "gl_active" and "gl_dynamic". Built
+ * lazily by "gl_index_get" and dropped whenever the lists change. */
+static graph_index_t *gl_index = NULL;
+
+/* Results of recent searches on "gl_index", most recently used first. The
+ * search box sends a request for every key stroke, so the same queries are
+ * evaluated over and over again. */
+static gl_search_cache_entry_t gl_search_cache[SEARCH_CACHE_SIZE];
+static size_t gl_search_cache_num = 0;
+
 /*
  * Private functions
  */
@@ -217,22 +241,170 @@ static int gl_register_ident (graph_ident_t *ident, /* {{{ */
   return (gl_register_file (ident, user_data));
 } /* }}} int gl_register_ident */
 
-static const char *get_part_from_param (const char *prim_key, /* {{{ */
-    const char *sec_key)
+static const char *get_part_from_param (const char *prefix, /* {{{ */
+    const char *prim_key, const char *sec_key)
 {
   const char *val;
 
-  val = param (prim_key);
+  val = param_prefixed (prefix, prim_key);
   if (val != NULL)
     return (val);
   
-  return (param (sec_key));
+  return (param_prefixed (prefix, sec_key));
 } /* }}} const char *get_part_from_param */
 
+static void gl_search_cache_flush (void) /* {{{ */
+{
+  size_t i;
+
+  for (i = 0; i < gl_search_cache_num; i++)
+  {
+    free (gl_search_cache[i].key);
+    idset_destroy (gl_search_cache[i].matches);
+  }
+  gl_search_cache_num = 0;
+} /* }}} void gl_search_cache_flush */
+
+static void gl_index_invalidate (void) /* {{{ */
+{
+  /* Cached results refer to IDs of the old index. */
+  gl_search_cache_flush ();
+
+  idx_destroy (gl_index);
+  gl_index = NULL;
+} /* }}} void gl_index_invalidate */
+
+static graph_index_t *gl_index_get (void) /* {{{ */
+{
+  graph_index_t *idx;
+  size_t i;
+  int status;
+
+  if (gl_index != NULL)
+    return (gl_index);
+
+  idx = idx_create ();
+  if (idx == NULL)
+    return (NULL);
+
+  status = 0;
+  for (i = 0; (i < gl_active_num) && (status == 0); i++)
+    status = idx_add_graph (idx, gl_active[i]);
+
+  for (i = 0; (i < gl_dynamic_num) && (status == 0); i++)
+    status = idx_add_graph (idx, gl_dynamic[i]);
+
+  if (status == 0)
+    status = idx_finalize (idx);
+
+  if (status != 0)
+  {
+    fprintf (stderr, "gl_index_get: Building the search index failed "
+        "with status %i.\n", status);
+    idx_destroy (idx);
+    return (NULL);
+  }
+
+  gl_index = idx;
+  return (gl_index);
+} /* }}} graph_index_t *gl_index_get */
+
+/* Returns the set of instances matching "si". Results are cached, keyed by
+ * the normalized search string. The returned set must be freed by the
+ * caller. */
+static idset_t *gl_search_eval (search_info_t *si, /* {{{ */
+    graph_index_t *idx)
+{
+  gl_search_cache_entry_t entry;
+  char *key;
+  size_t i;
+
+  key = search_to_string (si);
+  if (key == NULL)
+    return (search_eval (si, idx));
+
+  for (i = 0; i < gl_search_cache_num; i++)
+    if (strcmp (key, gl_search_cache[i].key) == 0)
+      break;
+
+  if (i < gl_search_cache_num)
+  {
+    /* Cache hit: move the entry to the front. */
+    entry = gl_search_cache[i];
+    memmove (gl_search_cache + 1, gl_search_cache,
+        i * sizeof (*gl_search_cache));
+    gl_search_cache[0] = entry;
+
+    free (key);
+    return (idset_clone (entry.matches));
+  }
+
+  entry.key = key;
+  entry.matches = search_eval (si, idx);
+  if (entry.matches == NULL)
+  {
+    free (key);
+    return (NULL);
+  }
+
+  /* Evict the least recently used entry if the cache is full. */
+  if (gl_search_cache_num >= SEARCH_CACHE_SIZE)
+  {
+    gl_search_cache_num--;
+    free (gl_search_cache[gl_search_cache_num].key);
+    idset_destroy (gl_search_cache[gl_search_cache_num].matches);
+  }
+
+  memmove (gl_search_cache + 1, gl_search_cache,
+      gl_search_cache_num * sizeof (*gl_search_cache));
+  gl_search_cache[0] = entry;
+  gl_search_cache_num++;
+
+  return (idset_clone (entry.matches));
+} /* }}} idset_t *gl_search_eval */
+
+/* Calls "callback" for "num" instances of "ids", starting at position
+ * "offset". IDs are assigned in graph order, so instances of the same graph
+ * are reported consecutively. */
+static int gl_index_foreach (graph_index_t *idx, /* {{{ */
+    const idset_t *ids, size_t offset, size_t num,
+    graph_inst_callback_t callback, void *user_data)
+{
+  const uint32_t *id_array;
+  size_t id_array_num;
+  size_t i;
+  int status;
+
+  id_array = idset_ids (ids);
+  id_array_num = idset_size (ids);
+
+  if (offset >= id_array_num)
+    return (0);
+  if (num > (id_array_num - offset))
+    num = id_array_num - offset;
+
+  status = 0;
+  for (i = offset; (i < (offset + num)) && (status == 0); i++)
+  {
+    graph_config_t *cfg;
+    graph_instance_t *inst;
+
+    status = idx_get (idx, id_array[i], &cfg, &inst);
+    if (status != 0)
+      break;
+
+    status = (*callback) (cfg, inst, user_data);
+  }
+
+  return (status);
+} /* }}} int gl_index_foreach */
+
 static int gl_clear_instances (void) /* {{{ */
 {
   size_t i;
 
+  gl_index_invalidate ();
+
   for (i = 0; i < gl_active_num; i++)
     graph_clear_instances (gl_active[i]);
 
@@ -776,6 +948,7 @@ int gl_config_submit (void) /* {{{ */
   gl_staging = NULL;
   gl_staging_num = 0;
 
+  gl_index_invalidate ();
   gl_destroy (&old, &old_num);
 
   return (0);
@@ -815,13 +988,13 @@ int gl_graph_get_all (_Bool include_dynamic, /* {{{ */
   return (0);
 } /* }}} int gl_graph_get_all */
 
-graph_config_t *gl_graph_get_selected (void) /* {{{ */
+graph_config_t *gl_graph_get_selected_prefix (const char *prefix) /* {{{ */
 {
-  const char *host = get_part_from_param ("graph_host", "host");
-  const char *plugin = get_part_from_param ("graph_plugin", "plugin");
-  const char *plugin_instance = get_part_from_param ("graph_plugin_instance", "plugin_instance");
-  const char *type = get_part_from_param ("graph_type", "type");
-  const char *type_instance = get_part_from_param ("graph_type_instance", "type_instance");
+  const char *host = get_part_from_param (prefix, "graph_host", "host");
+  const char *plugin = get_part_from_param (prefix, "graph_plugin", "plugin");
+  const char *plugin_instance = get_part_from_param (prefix, "graph_plugin_instance", "plugin_instance");
+  const char *type = get_part_from_param (prefix, "graph_type", "type");
+  const char *type_instance = get_part_from_param (prefix, "graph_type_instance", "type_instance");
   graph_ident_t *ident;
   size_t i;
 
@@ -854,6 +1027,11 @@ graph_config_t *gl_graph_get_selected (void) /* {{{ */
 
   ident_destroy (ident);
   return (NULL);
+} /* }}} graph_config_t *gl_graph_get_selected_prefix */
+
+graph_config_t *gl_graph_get_selected (void) /* {{{ */
+{
+  return (gl_graph_get_selected_prefix (/* prefix = */ NULL));
 } /* }}} graph_config_t *gl_graph_get_selected */
 
 /* gl_instance_get_all, gl_graph_instance_get_all {{{ */
@@ -920,121 +1098,170 @@ int gl_instance_get_all (graph_inst_callback_t callback, /* {{{ */
 int gl_search (search_info_t *si, /* {{{ */
     graph_inst_callback_t callback, void *user_data)
 {
-  size_t i;
-  graph_ident_t *ident;
+  graph_index_t *idx;
+  idset_t *matches;
+  int status;
 
   if ((si == NULL) || (callback == NULL))
     return (EINVAL);
 
-  if (search_has_selector (si))
+  idx = gl_index_get ();
+  if (idx == NULL)
+    return (ENOMEM);
+
+  matches = gl_search_eval (si, idx);
+  if (matches == NULL)
   {
-    ident = search_to_ident (si);
-    if (ident == NULL)
-    {
-      fprintf (stderr, "gl_search: search_to_ident failed\n");
-      return (-1);
-    }
+    fprintf (stderr, "gl_search: gl_search_eval failed\n");
+    return (-1);
   }
+
+  status = gl_index_foreach (idx, matches,
+      /* offset = */ 0, /* num = */ idset_size (matches),
+      callback, user_data);
+
+  idset_destroy (matches);
+  return (status);
+} /* }}} int gl_search */
+
+int gl_search_string (const char *term, graph_inst_callback_t callback, /* {{{ */
+    void *user_data)
+{
+  search_info_t *si;
+  int status;
+
+  if ((term == NULL) || (callback == NULL))
+    return (EINVAL);
+
+  si = search_parse (term);
+  if (si == NULL)
+    return (ENOMEM);
+
+  status = gl_search (si, callback, user_data);
+
+  search_destroy (si);
+  return (status);
+} /* }}} int gl_search_string */
+
+int gl_search_page (search_info_t *si, const char *cursor, /* {{{ */
+    size_t limit, gl_page_t *ret_page)
+{
+  graph_index_t *idx;
+  const uint32_t *ids;
+  uint32_t cursor_id;
+
+  if ((limit < 1) || (ret_page == NULL))
+    return (EINVAL);
+
+  memset (ret_page, 0, sizeof (*ret_page));
+
+  idx = gl_index_get ();
+  if (idx == NULL)
+    return (ENOMEM);
+
+  cursor_id = 0;
+  if ((cursor != NULL) && (cursor[0] != 0))
+    cursor_id = idx_seek (idx, cursor);
+
+  if (si == NULL)
+    ret_page->matches = idset_create_range (idx_size (idx));
   else
+    ret_page->matches = gl_search_eval (si, idx);
+  if (ret_page->matches == NULL)
   {
-    ident = NULL;
+    fprintf (stderr, "gl_search_page: gl_search_eval failed\n");
+    return (-1);
   }
 
-  for (i = 0; i < gl_active_num; i++)
-  {
-    int status;
+  ids = idset_ids (ret_page->matches);
+  ret_page->total = idset_size (ret_page->matches);
+  ret_page->offset = idset_position (ret_page->matches, cursor_id);
 
-    if ((ident != NULL) && !graph_ident_intersect (gl_active[i], ident))
-      continue;
+  ret_page->num = ret_page->total - ret_page->offset;
+  if (ret_page->num > limit)
+    ret_page->num = limit;
 
-    status = graph_search_inst (gl_active[i], si,
-        /* callback  = */ callback,
-        /* user data = */ user_data);
-    if (status != 0)
-      return (status);
+  if (ret_page->offset > 0)
+  {
+    ret_page->have_prev = 1;
+    ret_page->prev_cursor = strdup (idx_get_key (idx,
+          (ret_page->offset > limit) ? ids[ret_page->offset - limit] : ids[0]));
   }
 
-  for (i = 0; i < gl_dynamic_num; i++)
+  if ((ret_page->offset + ret_page->num) < ret_page->total)
   {
-    int status;
-
-    if ((ident != NULL) && !graph_ident_intersect (gl_dynamic[i], ident))
-      continue;
+    ret_page->have_next = 1;
+    ret_page->next_cursor = strdup (idx_get_key (idx,
+          ids[ret_page->offset + ret_page->num]));
+  }
 
-    status = graph_search_inst (gl_dynamic[i], si,
-        /* callback  = */ callback,
-        /* user data = */ user_data);
-    if (status != 0)
-      return (status);
+  if ((ret_page->have_prev && (ret_page->prev_cursor == NULL))
+      || (ret_page->have_next && (ret_page->next_cursor == NULL)))
+  {
+    gl_page_free (ret_page);
+    return (ENOMEM);
   }
 
   return (0);
-} /* }}} int gl_search */
+} /* }}} int gl_search_page */
 
-int gl_search_string (const char *term, graph_inst_callback_t callback, /* {{{ */
-    void *user_data)
+int gl_page_foreach (const gl_page_t *page, /* {{{ */
+    graph_inst_callback_t callback, void *user_data)
 {
-  size_t i;
+  graph_index_t *idx;
 
-  for (i = 0; i < gl_active_num; i++)
-  {
-    int status;
+  if ((page == NULL) || (callback == NULL))
+    return (EINVAL);
 
-    status = graph_search_inst_string (gl_active[i], term,
-        /* callback  = */ callback,
-        /* user data = */ user_data);
-    if (status != 0)
-      return (status);
-  }
+  if (page->num == 0)
+    return (0);
 
-  for (i = 0; i < gl_dynamic_num; i++)
-  {
-    int status;
+  idx = gl_index_get ();
+  if (idx == NULL)
+    return (ENOMEM);
 
-    status = graph_search_inst_string (gl_dynamic[i], term,
-        /* callback  = */ callback,
-        /* user data = */ user_data);
-    if (status != 0)
-      return (status);
-  }
+  return (gl_index_foreach (idx, page->matches, page->offset, page->num,
+        callback, user_data));
+} /* }}} int gl_page_foreach */
 
-  return (0);
-} /* }}} int gl_search_string */
+void gl_page_free (gl_page_t *page) /* {{{ */
+{
+  if (page == NULL)
+    return;
+
+  idset_destroy (page->matches);
+  page->matches = NULL;
+
+  free (page->prev_cursor);
+  page->prev_cursor = NULL;
+  free (page->next_cursor);
+  page->next_cursor = NULL;
+} /* }}} void gl_page_free */
 
 int gl_search_field (graph_ident_field_t field, /* {{{ */
     const char *field_value,
     graph_inst_callback_t callback, void *user_data)
 {
-  size_t i;
+  graph_index_t *idx;
+  const idset_t *matches;
 
   if ((field_value == NULL) || (callback == NULL))
     return (EINVAL);
 
-  for (i = 0; i < gl_active_num; i++)
-  {
-    int status;
-
-    status = graph_inst_search_field (gl_active[i],
-        field, field_value,
-        /* callback  = */ callback,
-        /* user data = */ user_data);
-    if (status != 0)
-      return (status);
-  }
-
-  for (i = 0; i < gl_dynamic_num; i++)
-  {
-    int status;
+  idx = gl_index_get ();
+  if (idx == NULL)
+    return (ENOMEM);
 
-    status = graph_inst_search_field (gl_dynamic[i],
-        field, field_value,
-        /* callback  = */ callback,
-        /* user data = */ user_data);
-    if (status != 0)
-      return (status);
-  }
+  /* The index keeps one posting list per field value, so this is
+   * proportional to the number of results rather than the number of
+   * instances and files. */
+  matches = idx_lookup_field (idx, field, field_value);
+  if (matches == NULL)
+    return (0);
 
-  return (0);
+  return (gl_index_foreach (idx, matches,
+        /* offset = */ 0, /* num = */ idset_size (matches),
+        callback, user_data));
 } /* }}} int gl_search_field */
 
 int gl_foreach_host (int (*callback) (const char *host, void *user_data), /* {{{ */
@@ -1095,6 +1322,10 @@ int gl_update (_Bool request_served) /* {{{ */
 
     data_provider_get_idents (gl_register_ident, /* user data = */ NULL);
 
+    /* Once per rescan: "gl_clear_instances" runs twice on this path and
+     * nothing uses the cache in between. */
+    inst_clear_ds_cache ();
+
     gl_last_update = now;
   }
 
@@ -1104,6 +1335,14 @@ int gl_update (_Bool request_served) /* {{{ */
 
   for (i = 0; i < gl_active_num; i++)
     graph_sort_instances (gl_active[i]);
+  for (i = 0; i < gl_dynamic_num; i++)
+    graph_sort_instances (gl_dynamic[i]);
+
+  /* IDs in the search index follow the sort order. Rebuild the index right
+   * away so that the next request doesn't have to. */
+  gl_index_invalidate ();
+  if (request_served)
+    gl_index_get ();
 
   if (request_served)
     gl_update_cache ();
@@ -26,9 +26,34 @@
 
 #include "graph_types.h"
 #include "graph_ident.h"
+#include "utils_idset.h"
 #include "utils_search.h"
 #include "data_provider.h"
 
+/* One page of search results. Matches are reported in graph list order. The
+ * cursor of a page identifies its first instance by the graph's and the
+ * instance's selector, see "idx_get_key". It remains valid when the graph list
+ * is rebuilt: if the instance is gone, the page starts with the instance that
+ * follows it in sort order. If the graph is gone, the first page is shown. */
+struct gl_page_s
+{
+  /* all matches, not only those on this page */
+  idset_t *matches;
+
+  /* number of matches */
+  size_t total;
+  /* position of the first instance of the page and number of instances on
+   * the page */
+  size_t offset;
+  size_t num;
+
+  _Bool have_prev;
+  char *prev_cursor;
+  _Bool have_next;
+  char *next_cursor;
+};
+typedef struct gl_page_s gl_page_t;
+
 /*
  * Functions
  */
@@ -39,6 +64,9 @@ int gl_config_submit (void);
 int gl_register_data_provider (const char *name, data_provider_t *p);
 
 graph_config_t *gl_graph_get_selected (void);
+/* Like "gl_graph_get_selected", but reads the parameters prefixed with
+ * "prefix", see "param_prefixed". */
+graph_config_t *gl_graph_get_selected_prefix (const char *prefix);
 
 int gl_graph_get_all (_Bool include_dynamic,
     graph_callback_t callback, void *user_data);
@@ -54,6 +82,19 @@ int gl_search (search_info_t *si, graph_inst_callback_t callback,
 int gl_search_string (const char *search, graph_inst_callback_t callback,
     void *user_data);
 
+/* Evaluates "si" (or selects all instances if "si" is NULL) and fills
+ * "ret_page" with the page of at most "limit" instances starting at "cursor".
+ * "cursor" may be NULL to select the first page. The page must be freed with
+ * "gl_page_free". */
+int gl_search_page (search_info_t *si, const char *cursor, size_t limit,
+    gl_page_t *ret_page);
+/* Calls "callback" for each instance on the page. */
+int gl_page_foreach (const gl_page_t *page,
+    graph_inst_callback_t callback, void *user_data);
+void gl_page_free (gl_page_t *page);
+
+/* Calls "callback" for all instances whose "field" equals "field_value"
+ * (case-insensitive). Uses the per-field value lists of the search index. */
 int gl_search_field (graph_ident_field_t field, const char *field_value,
     graph_inst_callback_t callback, void *user_data);
 
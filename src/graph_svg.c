@@ -0,0 +1,711 @@
+/**
+ * collection4 - graph_svg.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include "graph_svg.h"
+#include "common.h"
+#include "graph.h"
+#include "graph_def.h"
+#include "graph_ident.h"
+#include "graph_instance.h"
+#include "utils_cgi.h"
+
+#include <fcgiapp.h>
+#include <fcgi_stdio.h>
+
+/* Space around the plot area, in pixels. */
+#define SVG_MARGIN_LEFT   70
+#define SVG_MARGIN_RIGHT  20
+#define SVG_MARGIN_TOP    30
+#define SVG_AXIS_HEIGHT   20
+#define SVG_LEGEND_LINE   16
+#define SVG_MARGIN_BOTTOM 10
+
+/* Minimum distance between labels of the x-axis, in pixels. */
+#define SVG_X_LABEL_DISTANCE 70
+/* Approximate number of lines in the y-axis grid. */
+#define SVG_Y_LINES 5
+
+struct svg_series_s
+{
+  char legend[256];
+  uint32_t color;
+  _Bool area;
+  /* One value per pixel column, NaN if there is no data. For stacked series
+   * this is the sum of this and all previous stacked series. */
+  double *values;
+  /* Top of the previous stacked series or NULL. Points into the "values" of
+   * another series. */
+  double *base;
+  /* Minimum and maximum per pixel column if the envelope is drawn, NULL
+   * otherwise. */
+  double *env_min;
+  double *env_max;
+  /* Statistics of the series' own values, for the legend. */
+  double min;
+  double avg;
+  double max;
+  double last;
+};
+typedef struct svg_series_s svg_series_t;
+
+struct svg_graph_s
+{
+  long begin;
+  long end;
+  int width;
+  int height;
+
+  svg_series_t *series;
+  size_t series_num;
+  double *last_stack;
+
+  double y_min;
+  double y_max;
+
+  ident_print_t print;
+  void *print_ctx;
+};
+typedef struct svg_graph_s svg_graph_t;
+
+/*
+ * Private functions
+ */
+static void svg_printf (svg_graph_t *g, const char *format, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+static void svg_printf (svg_graph_t *g, const char *format, ...) /* {{{ */
+{
+  char buffer[1024];
+  va_list ap;
+  int status;
+
+  va_start (ap, format);
+  status = vsnprintf (buffer, sizeof (buffer), format, ap);
+  va_end (ap);
+
+  if (status < 0)
+    return;
+  else if ((size_t) status >= sizeof (buffer))
+    status = (int) (sizeof (buffer) - 1);
+
+  (*g->print) (g->print_ctx, buffer, (unsigned int) status);
+} /* }}} void svg_printf */
+
+/* Formats "value" with an SI prefix, e.g. "12.34k". */
+static void svg_format_value (char *buffer, size_t buffer_size, /* {{{ */
+    double value)
+{
+  static const char *prefixes[] =
+  { "a", "f", "p", "n", "u", "m", "", "k", "M", "G", "T", "P", "E" };
+  int exponent = 0;
+
+  if (isnan (value))
+  {
+    snprintf (buffer, buffer_size, "nan");
+    return;
+  }
+
+  while ((fabs (value) >= 1000.0) && (exponent < 6))
+  {
+    value /= 1000.0;
+    exponent++;
+  }
+  while ((value != 0.0) && (fabs (value) < 1.0) && (exponent > -6))
+  {
+    value *= 1000.0;
+    exponent--;
+  }
+
+  snprintf (buffer, buffer_size, "%.2f%s", value, prefixes[exponent + 6]);
+} /* }}} void svg_format_value */
+
+static double svg_x (int x) /* {{{ */
+{
+  return (((double) SVG_MARGIN_LEFT) + ((double) x) + 0.5);
+} /* }}} double svg_x */
+
+static double svg_y (const svg_graph_t *g, double value) /* {{{ */
+{
+  double ratio;
+
+  ratio = (value - g->y_min) / (g->y_max - g->y_min);
+  if (ratio < 0.0)
+    ratio = 0.0;
+  else if (ratio > 1.0)
+    ratio = 1.0;
+
+  return (((double) SVG_MARGIN_TOP)
+      + ((double) g->height) * (1.0 - ratio));
+} /* }}} double svg_y */
+
+/* Fetches the data of "def" and "file", consolidated using "cf", and
+ * samples it at the center of each pixel column. If "ret_data" is not NULL,
+ * the fetched data is returned in it and must be freed by the caller. */
+static int svg_get_values (svg_graph_t *g, graph_def_t *def, /* {{{ */
+    graph_ident_t *file, consolidation_t cf, double **ret_values,
+    ident_data_series_t *ret_data)
+{
+  ident_data_series_t data;
+  dp_time_t begin;
+  dp_time_t end;
+  dp_time_t interval;
+  double *values;
+  int x;
+  int status;
+
+  begin.tv_sec = (time_t) g->begin;
+  begin.tv_nsec = 0;
+  end.tv_sec = (time_t) g->end;
+  end.tv_nsec = 0;
+  interval.tv_sec = (time_t) ((g->end - g->begin) / g->width);
+  interval.tv_nsec = 0;
+
+  status = ident_data_get_series (file, def_get_ds_name (def),
+      begin, end, interval, cf, &data);
+  if (status != 0)
+  {
+    fprintf (stderr, "svg_get_values: ident_data_get_series failed "
+        "with status %i\n", status);
+    return (status);
+  }
+
+  values = malloc (sizeof (*values) * ((size_t) g->width));
+  if (values == NULL)
+  {
+    free (data.values);
+    return (ENOMEM);
+  }
+
+  for (x = 0; x < g->width; x++)
+  {
+    double t;
+    double index;
+
+    t = ((double) g->begin) + (((double) x) + 0.5)
+      * ((double) (g->end - g->begin)) / ((double) g->width);
+    index = floor (((t - data.first_value_time) / data.interval) + 0.5);
+
+    if ((data.interval <= 0.0) || (index < 0.0)
+        || (index >= (double) data.values_num))
+      values[x] = NAN;
+    else
+      values[x] = data.values[(size_t) index];
+  }
+
+  if (ret_data != NULL)
+    *ret_data = data;
+  else
+    free (data.values);
+
+  *ret_values = values;
+  return (0);
+} /* }}} int svg_get_values */
+
+/* Called for each DEF / file pair: fetches the data and samples it at the
+ * center of each pixel column. */
+static int svg_add_series (graph_def_t *def, /* {{{ */
+    graph_ident_t *file, void *user_data)
+{
+  svg_graph_t *g = user_data;
+  ident_data_series_t data;
+  svg_series_t *s;
+  svg_series_t *tmp;
+  double *values;
+  double sum;
+  size_t sum_num;
+  size_t i;
+  int x;
+  int status;
+
+  status = svg_get_values (g, def, file, CONSOLIDATE_AVERAGE, &values, &data);
+  if (status == ENOMEM)
+    return (status);
+  else if (status != 0)
+    return (0);
+
+  tmp = realloc (g->series, sizeof (*g->series) * (g->series_num + 1));
+  if (tmp == NULL)
+  {
+    free (data.values);
+    free (values);
+    return (ENOMEM);
+  }
+  g->series = tmp;
+  s = g->series + g->series_num;
+  memset (s, 0, sizeof (*s));
+  s->values = values;
+  g->series_num++;
+
+  def_get_legend (def, file, s->legend, sizeof (s->legend));
+  s->color = def_get_color (def, file);
+  s->area = def_is_area (def);
+
+  /* Statistics over the data as returned by the provider. */
+  s->min = NAN;
+  s->max = NAN;
+  s->last = NAN;
+  sum = 0.0;
+  sum_num = 0;
+  for (i = 0; i < data.values_num; i++)
+  {
+    double v = data.values[i];
+
+    if (isnan (v))
+      continue;
+
+    if (isnan (s->min) || (s->min > v))
+      s->min = v;
+    if (isnan (s->max) || (s->max < v))
+      s->max = v;
+    s->last = v;
+    sum += v;
+    sum_num++;
+  }
+  s->avg = (sum_num > 0) ? (sum / ((double) sum_num)) : NAN;
+  free (data.values);
+
+  /* Like "def_get_rrdargs", the envelope is drawn for series which are not
+   * stacked, and the legend shows its minimum and maximum. If either can't
+   * be fetched, only the average is drawn. */
+  if (def_is_envelope (def) && !def_is_stack (def))
+  {
+    if ((svg_get_values (g, def, file, CONSOLIDATE_MIN,
+            &s->env_min, NULL) == 0)
+        && (svg_get_values (g, def, file, CONSOLIDATE_MAX,
+            &s->env_max, NULL) == 0))
+    {
+      for (x = 0; x < g->width; x++)
+      {
+        if (!isnan (s->env_min[x])
+            && (isnan (s->min) || (s->min > s->env_min[x])))
+          s->min = s->env_min[x];
+        if (!isnan (s->env_max[x])
+            && (isnan (s->max) || (s->max < s->env_max[x])))
+          s->max = s->env_max[x];
+      }
+    }
+    else
+    {
+      free (s->env_min);
+      s->env_min = NULL;
+      free (s->env_max);
+      s->env_max = NULL;
+    }
+  }
+
+  /* Like rrdtool, a stacked series is drawn on top of the previous stacked
+   * series. Gaps in either make a gap in the sum. */
+  if (def_is_stack (def))
+  {
+    if (g->last_stack != NULL)
+    {
+      for (x = 0; x < g->width; x++)
+        s->values[x] += g->last_stack[x];
+      s->base = g->last_stack;
+    }
+    g->last_stack = s->values;
+  }
+
+  return (0);
+} /* }}} int svg_add_series */
+
+/* Returns a "nice" step, i.e. 1, 2 or 5 times a power of ten, close to
+ * "range / lines". */
+static double svg_nice_step (double range, int lines) /* {{{ */
+{
+  double raw;
+  double magnitude;
+  double fraction;
+
+  raw = range / ((double) lines);
+  magnitude = pow (10.0, floor (log10 (raw)));
+  fraction = raw / magnitude;
+
+  if (fraction < 1.5)
+    return (magnitude);
+  else if (fraction < 3.5)
+    return (2.0 * magnitude);
+  else if (fraction < 7.5)
+    return (5.0 * magnitude);
+  return (10.0 * magnitude);
+} /* }}} double svg_nice_step */
+
+static void svg_scale_y (svg_graph_t *g, _Bool include_zero) /* {{{ */
+{
+  double step;
+  size_t i;
+  int x;
+
+  g->y_min = NAN;
+  g->y_max = NAN;
+  for (i = 0; i < g->series_num; i++)
+  {
+    const svg_series_t *s = g->series + i;
+
+    for (x = 0; x < g->width; x++)
+    {
+      double v_min = s->values[x];
+      double v_max = s->values[x];
+
+      if ((s->env_min != NULL) && !isnan (s->env_min[x]))
+        v_min = s->env_min[x];
+      if ((s->env_max != NULL) && !isnan (s->env_max[x]))
+        v_max = s->env_max[x];
+
+      if (!isnan (v_min) && (isnan (g->y_min) || (g->y_min > v_min)))
+        g->y_min = v_min;
+      if (!isnan (v_max) && (isnan (g->y_max) || (g->y_max < v_max)))
+        g->y_max = v_max;
+    }
+
+    /* Areas are filled down to zero. */
+    if (g->series[i].area)
+      include_zero = 1;
+  }
+
+  if (isnan (g->y_min))
+  {
+    g->y_min = 0.0;
+    g->y_max = 1.0;
+  }
+
+  if (include_zero)
+  {
+    if (g->y_min > 0.0)
+      g->y_min = 0.0;
+    if (g->y_max < 0.0)
+      g->y_max = 0.0;
+  }
+
+  if (g->y_max <= g->y_min)
+  {
+    double delta = (g->y_min != 0.0) ? fabs (g->y_min) * 0.1 : 1.0;
+
+    g->y_min -= delta;
+    g->y_max += delta;
+  }
+
+  step = svg_nice_step (g->y_max - g->y_min, SVG_Y_LINES);
+  g->y_min = floor (g->y_min / step) * step;
+  g->y_max = ceil (g->y_max / step) * step;
+} /* }}} void svg_scale_y */
+
+static void svg_print_grid (svg_graph_t *g) /* {{{ */
+{
+  static const long x_steps[] =
+  {
+    60, 300, 600, 1800, 3600, 3 * 3600, 6 * 3600, 12 * 3600,
+    86400, 2 * 86400, 7 * 86400, 14 * 86400, 30 * 86400, 91 * 86400,
+    365 * 86400
+  };
+  long x_step;
+  long t;
+  double step;
+  double v;
+  size_t i;
+
+  svg_printf (g, "<g stroke=\"#e0e0e0\" stroke-width=\"1\">\n");
+
+  step = svg_nice_step (g->y_max - g->y_min, SVG_Y_LINES);
+  for (v = g->y_min; v <= (g->y_max + (step / 2.0)); v += step)
+    svg_printf (g, "<line x1=\"%i\" y1=\"%.1f\" x2=\"%i\" y2=\"%.1f\"/>\n",
+        SVG_MARGIN_LEFT, svg_y (g, v),
+        SVG_MARGIN_LEFT + g->width, svg_y (g, v));
+
+  x_step = x_steps[0];
+  for (i = 0; i < sizeof (x_steps) / sizeof (x_steps[0]); i++)
+  {
+    x_step = x_steps[i];
+    if (((g->end - g->begin) / x_step)
+        <= (long) (g->width / SVG_X_LABEL_DISTANCE))
+      break;
+  }
+
+  for (t = ((g->begin / x_step) + 1) * x_step; t < g->end; t += x_step)
+  {
+    double px = ((double) SVG_MARGIN_LEFT) + ((double) g->width)
+      * ((double) (t - g->begin)) / ((double) (g->end - g->begin));
+
+    svg_printf (g, "<line x1=\"%.1f\" y1=\"%i\" x2=\"%.1f\" y2=\"%i\"/>\n",
+        px, SVG_MARGIN_TOP, px, SVG_MARGIN_TOP + g->height);
+  }
+
+  svg_printf (g, "</g>\n");
+
+  /* Labels */
+  for (v = g->y_min; v <= (g->y_max + (step / 2.0)); v += step)
+  {
+    char buffer[64];
+
+    svg_format_value (buffer, sizeof (buffer), (fabs (v) < (step / 2.0)) ? 0.0 : v);
+    svg_printf (g, "<text x=\"%i\" y=\"%.1f\" text-anchor=\"end\">%s</text>\n",
+        SVG_MARGIN_LEFT - 4, svg_y (g, v) + 4.0, buffer);
+  }
+
+  for (t = ((g->begin / x_step) + 1) * x_step; t < g->end; t += x_step)
+  {
+    double px = ((double) SVG_MARGIN_LEFT) + ((double) g->width)
+      * ((double) (t - g->begin)) / ((double) (g->end - g->begin));
+    time_t tt = (time_t) t;
+    struct tm tm;
+    char buffer[64];
+
+    memset (&tm, 0, sizeof (tm));
+    localtime_r (&tt, &tm);
+    if (x_step < 86400)
+      strftime (buffer, sizeof (buffer), "%H:%M", &tm);
+    else if (x_step < (91 * 86400))
+      strftime (buffer, sizeof (buffer), "%b %d", &tm);
+    else
+      strftime (buffer, sizeof (buffer), "%b %Y", &tm);
+
+    svg_printf (g, "<text x=\"%.1f\" y=\"%i\" text-anchor=\"middle\">%s</text>\n",
+        px, SVG_MARGIN_TOP + g->height + 14, buffer);
+  }
+} /* }}} void svg_print_grid */
+
+static void svg_print_area (svg_graph_t *g, const svg_series_t *s) /* {{{ */
+{
+  int x;
+  int first;
+
+  x = 0;
+  while (x < g->width)
+  {
+    int i;
+
+    /* Find the next run of values. */
+    while ((x < g->width) && isnan (s->values[x]))
+      x++;
+    if (x >= g->width)
+      break;
+    first = x;
+    while ((x < g->width) && !isnan (s->values[x]))
+      x++;
+
+    svg_printf (g, "<path fill=\"#%06"PRIx32"\" stroke=\"none\" d=\"",
+        fade_color (s->color));
+    for (i = first; i < x; i++)
+      svg_printf (g, "%s%.1f %.1f", (i == first) ? "M" : " L",
+          svg_x (i), svg_y (g, s->values[i]));
+    for (i = x - 1; i >= first; i--)
+      svg_printf (g, " L%.1f %.1f", svg_x (i),
+          svg_y (g, (s->base != NULL) ? s->base[i] : 0.0));
+    svg_printf (g, " Z\"/>\n");
+  }
+} /* }}} void svg_print_area */
+
+/* Fills the range between the minimum and the maximum of each pixel column,
+ * like the envelope areas built by "def_get_rrdargs". */
+static void svg_print_envelope (svg_graph_t *g, /* {{{ */
+    const svg_series_t *s)
+{
+  int x;
+  int first;
+
+  x = 0;
+  while (x < g->width)
+  {
+    int i;
+
+    while ((x < g->width)
+        && (isnan (s->env_min[x]) || isnan (s->env_max[x])))
+      x++;
+    if (x >= g->width)
+      break;
+    first = x;
+    while ((x < g->width)
+        && !isnan (s->env_min[x]) && !isnan (s->env_max[x]))
+      x++;
+
+    svg_printf (g, "<path fill=\"#%06"PRIx32"\" stroke=\"none\" d=\"",
+        fade_color (s->color));
+    for (i = first; i < x; i++)
+      svg_printf (g, "%s%.1f %.1f", (i == first) ? "M" : " L",
+          svg_x (i), svg_y (g, s->env_max[i]));
+    for (i = x - 1; i >= first; i--)
+      svg_printf (g, " L%.1f %.1f", svg_x (i), svg_y (g, s->env_min[i]));
+    svg_printf (g, " Z\"/>\n");
+  }
+} /* }}} void svg_print_envelope */
+
+static void svg_print_line (svg_graph_t *g, const svg_series_t *s) /* {{{ */
+{
+  _Bool in_path = 0;
+  int x;
+
+  svg_printf (g, "<path fill=\"none\" stroke=\"#%06"PRIx32"\" "
+      "stroke-width=\"1\" d=\"", s->color);
+  for (x = 0; x < g->width; x++)
+  {
+    if (isnan (s->values[x]))
+    {
+      in_path = 0;
+      continue;
+    }
+
+    svg_printf (g, "%s%.1f %.1f", in_path ? " L" : " M",
+        svg_x (x), svg_y (g, s->values[x]));
+    in_path = 1;
+  }
+  svg_printf (g, "\"/>\n");
+} /* }}} void svg_print_line */
+
+static void svg_print_legend (svg_graph_t *g, /* {{{ */
+    const svg_series_t *s, int y)
+{
+  char legend[sizeof (s->legend)];
+  char min[32];
+  char avg[32];
+  char max[32];
+  char last[32];
+
+  html_escape_copy (legend, s->legend, sizeof (legend));
+  svg_format_value (min, sizeof (min), s->min);
+  svg_format_value (avg, sizeof (avg), s->avg);
+  svg_format_value (max, sizeof (max), s->max);
+  svg_format_value (last, sizeof (last), s->last);
+
+  svg_printf (g, "<rect x=\"%i\" y=\"%i\" width=\"10\" height=\"10\" "
+      "fill=\"#%06"PRIx32"\" stroke=\"#000000\"/>\n",
+      SVG_MARGIN_LEFT, y - 9, s->color);
+  svg_printf (g, "<text x=\"%i\" y=\"%i\" xml:space=\"preserve\">"
+      "%s %s min, %s avg, %s max, %s last</text>\n",
+      SVG_MARGIN_LEFT + 14, y, legend, min, avg, max, last);
+} /* }}} void svg_print_legend */
+
+static void svg_print (svg_graph_t *g, graph_config_t *cfg) /* {{{ */
+{
+  char title[256];
+  const char *vertical_label;
+  int total_width;
+  int total_height;
+  size_t i;
+
+  total_width = SVG_MARGIN_LEFT + g->width + SVG_MARGIN_RIGHT;
+  total_height = SVG_MARGIN_TOP + g->height + SVG_AXIS_HEIGHT
+    + (((int) g->series_num) * SVG_LEGEND_LINE) + SVG_MARGIN_BOTTOM;
+
+  svg_printf (g, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%i\" height=\"%i\" "
+      "viewBox=\"0 0 %i %i\" font-family=\"DejaVu Sans Mono,monospace\" "
+      "font-size=\"10\">\n"
+      "<rect width=\"%i\" height=\"%i\" fill=\"#ffffff\"/>\n",
+      total_width, total_height, total_width, total_height,
+      total_width, total_height);
+
+  memset (title, 0, sizeof (title));
+  graph_get_title (cfg, title, sizeof (title));
+  html_escape_buffer (title, sizeof (title));
+  svg_printf (g, "<text x=\"%i\" y=\"18\" text-anchor=\"middle\" "
+      "font-size=\"12\">%s</text>\n", total_width / 2, title);
+
+  vertical_label = graph_get_vertical_label (cfg);
+  if (vertical_label != NULL)
+  {
+    char label[256];
+
+    html_escape_copy (label, vertical_label, sizeof (label));
+    svg_printf (g, "<text transform=\"translate(12,%i) rotate(-90)\" "
+        "text-anchor=\"middle\">%s</text>\n",
+        SVG_MARGIN_TOP + (g->height / 2), label);
+  }
+
+  svg_print_grid (g);
+
+  /* Like the argument list built for rrdtool, later series are drawn first:
+   * the top of a stack covers the series below it. */
+  for (i = g->series_num; i > 0; i--)
+  {
+    if (g->series[i - 1].env_min != NULL)
+      svg_print_envelope (g, g->series + (i - 1));
+    if (g->series[i - 1].area)
+      svg_print_area (g, g->series + (i - 1));
+  }
+  for (i = g->series_num; i > 0; i--)
+    svg_print_line (g, g->series + (i - 1));
+
+  svg_printf (g, "<rect x=\"%i\" y=\"%i\" width=\"%i\" height=\"%i\" "
+      "fill=\"none\" stroke=\"#000000\"/>\n",
+      SVG_MARGIN_LEFT, SVG_MARGIN_TOP, g->width, g->height);
+
+  for (i = g->series_num; i > 0; i--)
+    svg_print_legend (g, g->series + (i - 1),
+        SVG_MARGIN_TOP + g->height + SVG_AXIS_HEIGHT
+        + ((int) (g->series_num - i) + 1) * SVG_LEGEND_LINE - 4);
+
+  svg_printf (g, "</svg>\n");
+} /* }}} void svg_print */
+
+/*
+ * Public functions
+ */
+int graph_svg_render (graph_config_t *cfg, graph_instance_t *inst, /* {{{ */
+    long begin, long end, int width, int height,
+    ident_print_t print, void *print_ctx)
+{
+  svg_graph_t g;
+  size_t i;
+  int status;
+
+  if ((cfg == NULL) || (inst == NULL) || (print == NULL)
+      || (width <= 0) || (height <= 0) || (end <= begin))
+    return (EINVAL);
+
+  memset (&g, 0, sizeof (g));
+  g.begin = begin;
+  g.end = end;
+  g.width = width;
+  g.height = height;
+  g.print = print;
+  g.print_ctx = print_ctx;
+
+  status = inst_def_file_foreach (cfg, inst, svg_add_series, &g);
+  if (status == 0)
+  {
+    svg_scale_y (&g, graph_show_zero (cfg));
+    svg_print (&g, cfg);
+  }
+
+  for (i = 0; i < g.series_num; i++)
+  {
+    free (g.series[i].values);
+    free (g.series[i].env_min);
+    free (g.series[i].env_max);
+  }
+  free (g.series);
+
+  return (status);
+} /* }}} int graph_svg_render */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,44 @@
+/**
+ * collection4 - graph_svg.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef GRAPH_SVG_H
+#define GRAPH_SVG_H 1
+
+#include "graph_types.h"
+#include "graph_ident.h"
+
+/*
+ * In-process alternative to rendering graphs with librrd: draws the lines,
+ * areas and stacks of the graph's DEFs as SVG from the data returned by the
+ * data provider, i.e. "ident_data_get_series".
+ */
+
+/* Renders the graph of "inst" for the time span [begin, end]. "width" and
+ * "height" are the size of the plot area in pixels; the title, axes and
+ * legend are added around it. The document is passed to "print". */
+int graph_svg_render (graph_config_t *cfg, graph_instance_t *inst,
+    long begin, long end, int width, int height,
+    ident_print_t print, void *print_ctx);
+
+#endif /* GRAPH_SVG_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
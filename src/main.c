@@ -35,14 +35,18 @@
 #include "common.h"
 #include "graph_list.h"
 #include "utils_cgi.h"
+#include "utils_prerender.h"
+#include "utils_response.h"
 
 #include "action_graph.h"
 #include "action_instance_data_json.h"
 #include "action_graph_def_json.h"
+#include "action_graph_sprite.h"
 #include "action_list_graphs.h"
 #include "action_list_graphs_json.h"
 #include "action_list_hosts.h"
 #include "action_list_hosts_json.h"
+#include "action_multi_instance_data_json.h"
 #include "action_search.h"
 #include "action_search_json.h"
 #include "action_show_graph.h"
@@ -58,6 +62,9 @@ struct action_s
 {
   const char *name;
   int (*callback) (void);
+  /* The response depends on the query string only and may be rendered in
+   * advance. */
+  _Bool prerender;
 };
 typedef struct action_s action_t;
 
@@ -65,19 +72,21 @@ static int action_usage (void);
 
 static const action_t actions[] =
 {
-  { "graph",       action_graph },
-  { "instance_data_json", action_instance_data_json },
-  { "graph_def_json", action_graph_def_json },
-  { "list_graphs", action_list_graphs },
-  { "list_graphs_json", action_list_graphs_json },
-  { "list_hosts",  action_list_hosts },
-  { "list_hosts_json",  action_list_hosts_json },
-  { "search",      action_search },
-  { "search_json", action_search_json },
-  { "show_graph",  action_show_graph },
-  { "show_graph_json",  action_show_graph_json },
-  { "show_instance", action_show_instance },
-  { "usage",       action_usage }
+  { "graph",       action_graph, 1 },
+  { "instance_data_json", action_instance_data_json, 1 },
+  { "graph_def_json", action_graph_def_json, 0 },
+  { "graph_sprite", action_graph_sprite, 1 },
+  { "list_graphs", action_list_graphs, 0 },
+  { "list_graphs_json", action_list_graphs_json, 0 },
+  { "list_hosts",  action_list_hosts, 0 },
+  { "list_hosts_json",  action_list_hosts_json, 0 },
+  { "multi_instance_data_json", action_multi_instance_data_json, 0 },
+  { "search",      action_search, 0 },
+  { "search_json", action_search_json, 0 },
+  { "show_graph",  action_show_graph, 0 },
+  { "show_graph_json",  action_show_graph_json, 0 },
+  { "show_instance", action_show_instance, 0 },
+  { "usage",       action_usage, 0 }
 };
 static const size_t actions_num = sizeof (actions) / sizeof (actions[0]);
 
@@ -86,51 +95,89 @@ static int action_usage (void) /* {{{ */
 {
   size_t i;
 
-  printf ("Content-Type: text/plain\n\n");
+  resp_header ("Content-Type: text/plain");
 
-  printf ("Usage:\n"
+  resp_printf ("Usage:\n"
       "\n"
       "  Available actions:\n"
       "\n");
 
   for (i = 0; i < actions_num; i++)
-    printf ("  * %s\n", actions[i].name);
+    resp_printf ("  * %s\n", actions[i].name);
 
-  printf ("\n");
+  resp_printf ("\n");
 
   return (0);
 } /* }}} int action_usage */
 
+static const action_t *action_lookup (const char *name) /* {{{ */
+{
+  size_t i;
+
+  if (name == NULL)
+    return (NULL);
+
+  for (i = 0; i < actions_num; i++)
+    if (strcmp (name, actions[i].name) == 0)
+      return (&actions[i]);
+
+  return (NULL);
+} /* }}} action_t *action_lookup */
+
+/* Used by the pre-renderer to run a request again. */
+static int dispatch_action (void) /* {{{ */
+{
+  const action_t *a;
+
+  a = action_lookup (param ("action"));
+  if ((a == NULL) || !a->prerender)
+    return (EINVAL);
+
+  return ((*a->callback) ());
+} /* }}} int dispatch_action */
+
 static int handle_request (void) /* {{{ */
 {
   const char *action;
 
   param_init ();
+  resp_begin ();
+  prerender_request_begin ();
 
   action = param ("action");
   if (action == NULL)
   {
-    return (action_list_graphs ());
+    int status;
+
+    status = action_list_graphs ();
+    resp_end ();
+
+    /* Don't keep the client waiting for the pre-renderer. */
+    FCGI_Finish ();
+    return (status);
   }
   else
   {
-    size_t i;
-    int status = ENOENT;
+    const action_t *a;
+    const char *method;
+    int status;
 
     gl_update (/* request_served = */ 0);
 
-    for (i = 0; i < actions_num; i++)
-    {
-      if (strcmp (action, actions[i].name) == 0)
-      {
-        status = (*actions[i].callback) ();
-        break;
-      }
-    }
-
-    if (i >= actions_num)
+    a = action_lookup (action);
+    if (a != NULL)
+      status = (*a->callback) ();
+    else
       status = action_usage ();
 
+    resp_end ();
+
+    /* POST data is not part of the query string and can't be replayed. */
+    method = getenv ("REQUEST_METHOD");
+    if ((a != NULL) && a->prerender && (status == 0)
+        && ((method == NULL) || (strcmp ("POST", method) != 0)))
+      prerender_record (getenv ("QUERY_STRING"));
+
     /* Call finish before updating the graph list, so clients don't wait for
      * the update to finish. */
     FCGI_Finish ();
@@ -147,6 +194,9 @@ static int run (void) /* {{{ */
   {
     handle_request ();
     param_finish ();
+
+    /* Refresh the caches for popular requests while no client waits. */
+    prerender_run (dispatch_action);
   }
 
   return (0);
@@ -36,11 +36,13 @@ rrd_args_t *ra_create (void) /* {{{ */
     return (NULL);
   memset (ra, 0, sizeof (*ra));
 
+  /* All strings are allocated from one pool, which is freed in one go by
+   * "ra_destroy". */
   ra->options = array_create ();
-  ra->data    = array_create ();
-  ra->calc    = array_create ();
-  ra->areas   = array_create ();
-  ra->lines   = array_create ();
+  ra->data    = array_create_shared (ra->options);
+  ra->calc    = array_create_shared (ra->options);
+  ra->areas   = array_create_shared (ra->options);
+  ra->lines   = array_create_shared (ra->options);
 
   if ((ra->options == NULL)
       || (ra->data == NULL)
@@ -69,12 +71,22 @@ void ra_destroy (rrd_args_t *ra) /* {{{ */
   free (ra);
 } /* }}} void ra_destroy */
 
-int ra_argc (rrd_args_t *ra)
+int ra_argc (rrd_args_t *ra) /* {{{ */
 {
+  int compiled_argc = 0;
+
   if (ra == NULL)
     return (-EINVAL);
 
-  return (array_argc (ra->options)
+  if (ra->compiled != NULL)
+  {
+    compiled_argc = ra_argc (ra->compiled);
+    if (compiled_argc < 0)
+      return (compiled_argc);
+  }
+
+  return (compiled_argc
+      + array_argc (ra->options)
       + array_argc (ra->data)
       + array_argc (ra->calc)
       + array_argc (ra->areas)
@@ -109,8 +121,8 @@ char **ra_argv (rrd_args_t *ra) /* {{{ */
   size_t ary_argc;                                                           \
   char **ary_argv;                                                           \
                                                                              \
-  ary_argc = (size_t) array_argc (ra->field);                                \
-  ary_argv = array_argv (ra->field);                                         \
+  ary_argc = (size_t) array_argc (field);                                    \
+  ary_argv = array_argv (field);                                             \
   if ((ary_argc > 0) && (ary_argv != NULL))                                  \
   {                                                                          \
     memcpy (argv + pos, ary_argv, ary_argc * sizeof (*ary_argv));            \
@@ -119,11 +131,19 @@ char **ra_argv (rrd_args_t *ra) /* {{{ */
   }                                                                          \
 } while (0)
  
-  APPEND_FIELD (options);
-  APPEND_FIELD (data);
-  APPEND_FIELD (calc);
-  APPEND_FIELD (areas);
-  APPEND_FIELD (lines);
+  APPEND_FIELD (ra->options);
+  if (ra->compiled != NULL)
+  {
+    APPEND_FIELD (ra->compiled->options);
+    APPEND_FIELD (ra->compiled->data);
+    APPEND_FIELD (ra->compiled->calc);
+    APPEND_FIELD (ra->compiled->areas);
+    APPEND_FIELD (ra->compiled->lines);
+  }
+  APPEND_FIELD (ra->data);
+  APPEND_FIELD (ra->calc);
+  APPEND_FIELD (ra->areas);
+  APPEND_FIELD (ra->lines);
 
 #undef APPEND_FIELD
 
@@ -36,6 +36,10 @@ struct rrd_args_s
 
   int index;
   char last_stack_cdef[64];
+
+  /* Arguments built in advance, see "inst_get_rrdargs". They are placed
+   * after "options" and are not freed by "ra_destroy". */
+  struct rrd_args_s *compiled;
 };
 typedef struct rrd_args_s rrd_args_t;
 
@@ -29,12 +29,182 @@
 
 #include "utils_array.h"
 
+/* Size of the first string chunk. Following chunks double in size, up to
+ * POOL_CHUNK_SIZE_MAX. */
+#define POOL_CHUNK_SIZE_MIN 4096
+#define POOL_CHUNK_SIZE_MAX 65536
+
+/* Minimum number of pointers allocated for an array. */
+#define ARRAY_ALLOC_MIN 16
+
+struct str_pool_chunk_s;
+typedef struct str_pool_chunk_s str_pool_chunk_t;
+struct str_pool_chunk_s
+{
+  str_pool_chunk_t *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+/* The strings of one or more arrays are allocated from a pool of chunks and
+ * are freed together when the last array using the pool is destroyed. */
+struct str_pool_s
+{
+  str_pool_chunk_t *head;
+  size_t next_size;
+  int refcount;
+};
+typedef struct str_pool_s str_pool_t;
+
+/* The array is a deque: "ptr" holds "alloc" pointers, the entries start at
+ * "head". Free space is kept on both ends so both appending and prepending
+ * are amortized constant time. */
 struct str_array_s
 {
   char **ptr;
+  size_t alloc;
+  size_t head;
   size_t size;
+
+  str_pool_t *pool;
 };
 
+/*
+ * String pool
+ */
+static str_pool_t *pool_create (void) /* {{{ */
+{
+  str_pool_t *p;
+
+  p = malloc (sizeof (*p));
+  if (p == NULL)
+    return (NULL);
+  memset (p, 0, sizeof (*p));
+
+  p->head = NULL;
+  p->next_size = POOL_CHUNK_SIZE_MIN;
+  p->refcount = 1;
+
+  return (p);
+} /* }}} str_pool_t *pool_create */
+
+static void pool_release (str_pool_t *p) /* {{{ */
+{
+  str_pool_chunk_t *c;
+
+  if (p == NULL)
+    return;
+
+  p->refcount--;
+  if (p->refcount > 0)
+    return;
+
+  c = p->head;
+  while (c != NULL)
+  {
+    str_pool_chunk_t *next = c->next;
+    free (c);
+    c = next;
+  }
+
+  free (p);
+} /* }}} void pool_release */
+
+static char *pool_alloc (str_pool_t *p, size_t size) /* {{{ */
+{
+  str_pool_chunk_t *c;
+  char *ret;
+
+  c = p->head;
+  if ((c == NULL) || ((c->size - c->used) < size))
+  {
+    size_t chunk_size = p->next_size;
+
+    if (chunk_size < size)
+      chunk_size = size;
+
+    c = malloc (sizeof (*c) + chunk_size);
+    if (c == NULL)
+      return (NULL);
+    c->size = chunk_size;
+    c->used = 0;
+
+    c->next = p->head;
+    p->head = c;
+
+    if (p->next_size < POOL_CHUNK_SIZE_MAX)
+      p->next_size *= 2;
+  }
+
+  ret = c->data + c->used;
+  c->used += size;
+
+  return (ret);
+} /* }}} char *pool_alloc */
+
+static char *pool_strdup (str_pool_t *p, const char *s) /* {{{ */
+{
+  size_t size;
+  char *ret;
+
+  size = strlen (s) + 1;
+  ret = pool_alloc (p, size);
+  if (ret == NULL)
+    return (NULL);
+
+  memcpy (ret, s, size);
+  return (ret);
+} /* }}} char *pool_strdup */
+
+/* Formats the string directly into the current chunk. Only if it doesn't fit
+ * is it formatted a second time into a new chunk. */
+static char *pool_vformat (str_pool_t *p, /* {{{ */
+    const char *format, va_list ap)
+{
+  str_pool_chunk_t *c;
+  char *buffer;
+  size_t buffer_size;
+  va_list ap_copy;
+  int status;
+
+  c = p->head;
+  if (c != NULL)
+  {
+    buffer = c->data + c->used;
+    buffer_size = c->size - c->used;
+  }
+  else
+  {
+    buffer = NULL;
+    buffer_size = 0;
+  }
+
+  va_copy (ap_copy, ap);
+  status = vsnprintf (buffer, buffer_size, format, ap_copy);
+  va_end (ap_copy);
+
+  if (status < 0)
+    return (NULL);
+
+  if (((size_t) status) < buffer_size)
+  {
+    c->used += ((size_t) status) + 1;
+    return (buffer);
+  }
+
+  buffer_size = ((size_t) status) + 1;
+  buffer = pool_alloc (p, buffer_size);
+  if (buffer == NULL)
+    return (NULL);
+
+  vsnprintf (buffer, buffer_size, format, ap);
+  return (buffer);
+} /* }}} char *pool_vformat */
+
+/*
+ * Array
+ */
 static int sort_callback (const void *v0, const void *v1) /* {{{ */
 {
   const char *c0 = v0;
@@ -43,7 +213,73 @@ static int sort_callback (const void *v0, const void *v1) /* {{{ */
   return (strcmp (c0, c1));
 } /* }}} int sort_callback */
 
-str_array_t *array_create (void) /* {{{ */
+/* Makes room for at least one more entry at the front ("front" is true) or
+ * the back of the array. */
+static int array_reserve (str_array_t *a, _Bool front) /* {{{ */
+{
+  size_t alloc;
+  size_t head;
+  char **ptr;
+
+  if (front && (a->head > 0))
+    return (0);
+  else if (!front && ((a->head + a->size) < a->alloc))
+    return (0);
+
+  /* Center the entries again if at most half of the space is used. Otherwise
+   * double the size. Both keep the cost per entry constant. */
+  if ((a->alloc > 0) && ((a->size * 2) <= a->alloc))
+  {
+    head = (a->alloc - a->size) / 2;
+    memmove (a->ptr + head, a->ptr + a->head, sizeof (*a->ptr) * a->size);
+    a->head = head;
+    return (0);
+  }
+
+  alloc = 2 * a->alloc;
+  if (alloc < ARRAY_ALLOC_MIN)
+    alloc = ARRAY_ALLOC_MIN;
+
+  ptr = realloc (a->ptr, sizeof (*ptr) * alloc);
+  if (ptr == NULL)
+    return (ENOMEM);
+
+  head = (alloc - a->size) / 2;
+  memmove (ptr + head, ptr + a->head, sizeof (*ptr) * a->size);
+
+  a->ptr = ptr;
+  a->alloc = alloc;
+  a->head = head;
+
+  return (0);
+} /* }}} int array_reserve */
+
+static int array_push (str_array_t *a, char *entry, _Bool front) /* {{{ */
+{
+  int status;
+
+  if (entry == NULL)
+    return (ENOMEM);
+
+  status = array_reserve (a, front);
+  if (status != 0)
+    return (status);
+
+  if (front)
+  {
+    a->head--;
+    a->ptr[a->head] = entry;
+  }
+  else
+  {
+    a->ptr[a->head + a->size] = entry;
+  }
+  a->size++;
+
+  return (0);
+} /* }}} int array_push */
+
+static str_array_t *array_create_pool (str_pool_t *pool) /* {{{ */
 {
   str_array_t *a;
 
@@ -53,11 +289,44 @@ str_array_t *array_create (void) /* {{{ */
 
   memset (a, 0, sizeof (*a));
   a->ptr = NULL;
+  a->alloc = 0;
+  a->head = 0;
   a->size = 0;
+  a->pool = pool;
+
+  return (a);
+} /* }}} str_array_t *array_create_pool */
+
+str_array_t *array_create (void) /* {{{ */
+{
+  str_pool_t *pool;
+  str_array_t *a;
+
+  pool = pool_create ();
+  if (pool == NULL)
+    return (NULL);
+
+  a = array_create_pool (pool);
+  if (a == NULL)
+    pool_release (pool);
 
   return (a);
 } /* }}} str_array_t *array_create */
 
+str_array_t *array_create_shared (str_array_t *other) /* {{{ */
+{
+  str_array_t *a;
+
+  if (other == NULL)
+    return (NULL);
+
+  a = array_create_pool (other->pool);
+  if (a != NULL)
+    other->pool->refcount++;
+
+  return (a);
+} /* }}} str_array_t *array_create_shared */
+
 void array_destroy (str_array_t *a) /* {{{ */
 {
   if (a == NULL)
@@ -67,87 +336,56 @@ void array_destroy (str_array_t *a) /* {{{ */
   a->ptr = NULL;
   a->size = 0;
 
+  pool_release (a->pool);
+  a->pool = NULL;
+
   free (a);
 } /* }}} void array_destroy */
 
 int array_append (str_array_t *a, const char *entry) /* {{{ */
 {
-  char **ptr;
-
   if ((entry == NULL) || (a == NULL))
     return (EINVAL);
 
-  ptr = realloc (a->ptr, sizeof (*a->ptr) * (a->size + 1));
-  if (ptr == NULL)
-    return (ENOMEM);
-  a->ptr = ptr;
-  ptr = a->ptr + a->size;
-
-  *ptr = strdup (entry);
-  if (*ptr == NULL)
-    return (ENOMEM);
-
-  a->size++;
-  return (0);
+  return (array_push (a, pool_strdup (a->pool, entry), /* front = */ 0));
 } /* }}} int array_append */
 
 int array_append_format (str_array_t *a, const char *format, ...) /* {{{ */
 {
-  char buffer[1024];
   va_list ap;
-  int status;
+  char *entry;
 
-  va_start (ap, format);
-  status = vsnprintf (buffer, sizeof (buffer), format, ap);
-  va_end(ap);
+  if ((format == NULL) || (a == NULL))
+    return (EINVAL);
 
-  if ((status < 0) || (((size_t) status) >= sizeof (buffer)))
-    return (ENOMEM);
+  va_start (ap, format);
+  entry = pool_vformat (a->pool, format, ap);
+  va_end (ap);
 
-  return (array_append (a, buffer));
+  return (array_push (a, entry, /* front = */ 0));
 } /* }}} int array_append_format */
 
 int array_prepend (str_array_t *a, const char *entry) /* {{{ */
 {
-  char **ptr;
-  char *cpy;
-
   if ((entry == NULL) || (a == NULL))
     return (EINVAL);
 
-  cpy = strdup (entry);
-  if (cpy == NULL)
-    return (ENOMEM);
-
-  ptr = realloc (a->ptr, sizeof (*a->ptr) * (a->size + 1));
-  if (ptr == NULL)
-  {
-    free (cpy);
-    return (ENOMEM);
-  }
-  a->ptr = ptr;
-
-  memmove (a->ptr + 1, a->ptr, sizeof (*a->ptr) * a->size);
-  a->ptr[0] = cpy;
-  a->size++;
-
-  return (0);
+  return (array_push (a, pool_strdup (a->pool, entry), /* front = */ 1));
 } /* }}} int array_prepend */
 
 int array_prepend_format (str_array_t *a, const char *format, ...) /* {{{ */
 {
-  char buffer[1024];
   va_list ap;
-  int status;
+  char *entry;
 
-  va_start (ap, format);
-  status = vsnprintf (buffer, sizeof (buffer), format, ap);
-  va_end(ap);
+  if ((format == NULL) || (a == NULL))
+    return (EINVAL);
 
-  if ((status < 0) || (((size_t) status) >= sizeof (buffer)))
-    return (ENOMEM);
+  va_start (ap, format);
+  entry = pool_vformat (a->pool, format, ap);
+  va_end (ap);
 
-  return (array_prepend (a, buffer));
+  return (array_push (a, entry, /* front = */ 1));
 } /* }}} int array_prepend_format */
 
 int array_sort (str_array_t *a) /* {{{ */
@@ -155,7 +393,7 @@ int array_sort (str_array_t *a) /* {{{ */
   if (a == NULL)
     return (EINVAL);
 
-  qsort (a->ptr, a->size, sizeof (*a->ptr), sort_callback);
+  qsort (a->ptr + a->head, a->size, sizeof (*a->ptr), sort_callback);
 
   return (0);
 } /* }}} int array_sort */
@@ -173,7 +411,7 @@ char **array_argv (str_array_t *a) /* {{{ */
   if ((a == NULL) || (a->size == 0))
     return (NULL);
 
-  return (a->ptr);
+  return (a->ptr + a->head);
 } /* }}} char **array_argv */
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -27,17 +27,21 @@
 struct str_array_s;
 typedef struct str_array_s str_array_t;
 
+/* The strings of an array are allocated from a pool, which is freed together
+ * with the array. Arrays created with "array_create_shared" use the pool of
+ * "other"; the pool is freed when the last of these arrays is destroyed. */
 str_array_t *array_create (void);
+str_array_t *array_create_shared (str_array_t *other);
 void array_destroy (str_array_t *a);
 
-/* Appends a string to the array. The string is duplicated, so the original
- * string may / must be freed. */
+/* Appends a string to the array. The string is copied into the array's pool,
+ * so the original string may / must be freed. */
 int array_append (str_array_t *a, const char *entry);
 int array_append_format (str_array_t *a, const char *format, ...)
   __attribute__((format(printf,2,3)));
 
-/* Prepends a string to the array. The string is duplicated, so the original
- * string may / must be freed. */
+/* Prepends a string to the array. Like appending, this takes amortized
+ * constant time. */
 int array_prepend (str_array_t *a, const char *entry);
 int array_prepend_format (str_array_t *a, const char *format, ...)
   __attribute__((format(printf,2,3)));
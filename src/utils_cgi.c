@@ -26,13 +26,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <errno.h>
 #include <time.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <assert.h>
 
 #include "utils_cgi.h"
 #include "common.h"
+#include "utils_response.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
@@ -178,6 +182,65 @@ static int parse_query_string (param_list_t *pl, /* {{{ */
   return (0);
 } /* }}} int parse_query_string */
 
+/* Parameters may also be sent in the body of a POST request, e.g. when a
+ * request refers to many objects and the URL would get too long. */
+#define POST_DATA_MAX (1024 * 1024)
+
+static int parse_post_data (param_list_t *pl) /* {{{ */
+{
+  const char *method;
+  const char *content_type;
+  const char *content_length;
+  char *buffer;
+  size_t length;
+  size_t have;
+
+  method = getenv ("REQUEST_METHOD");
+  if ((method == NULL) || (strcmp ("POST", method) != 0))
+    return (0);
+
+  content_type = getenv ("CONTENT_TYPE");
+  if ((content_type == NULL)
+      || (strncasecmp ("application/x-www-form-urlencoded", content_type,
+          strlen ("application/x-www-form-urlencoded")) != 0))
+    return (0);
+
+  content_length = getenv ("CONTENT_LENGTH");
+  if (content_length == NULL)
+    return (0);
+
+  length = (size_t) strtoul (content_length, NULL, /* base = */ 10);
+  if (length == 0)
+    return (0);
+  else if (length > POST_DATA_MAX)
+  {
+    fprintf (stderr, "parse_post_data: Ignoring %zu bytes of POST data.\n",
+        length);
+    return (EINVAL);
+  }
+
+  buffer = malloc (length + 1);
+  if (buffer == NULL)
+    return (ENOMEM);
+
+  have = 0;
+  while (have < length)
+  {
+    size_t status;
+
+    status = fread (buffer + have, /* size = */ 1, length - have, stdin);
+    if (status == 0)
+      break;
+    have += status;
+  }
+  buffer[have] = 0;
+
+  parse_query_string (pl, buffer);
+
+  free (buffer);
+  return (0);
+} /* }}} int parse_post_data */
+
 int param_init (void) /* {{{ */
 {
   if (pl_global != NULL)
@@ -190,6 +253,20 @@ int param_init (void) /* {{{ */
   return (0);
 } /* }}} int param_init */
 
+int param_init_string (const char *query_string) /* {{{ */
+{
+  if (query_string == NULL)
+    return (EINVAL);
+
+  param_finish ();
+
+  pl_global = param_create (query_string);
+  if (pl_global == NULL)
+    return (ENOMEM);
+
+  return (0);
+} /* }}} int param_init_string */
+
 void param_finish (void) /* {{{ */
 {
   param_destroy (pl_global);
@@ -203,13 +280,32 @@ const char *param (const char *key) /* {{{ */
   return (param_get (pl_global, key));
 } /* }}} const char *param */
 
+const char *param_prefixed (const char *prefix, const char *key) /* {{{ */
+{
+  char buffer[256];
+  int status;
+
+  if ((prefix == NULL) || (prefix[0] == 0))
+    return (param (key));
+
+  status = snprintf (buffer, sizeof (buffer), "%s%s", prefix, key);
+  if ((status < 0) || (((size_t) status) >= sizeof (buffer)))
+    return (NULL);
+
+  return (param (buffer));
+} /* }}} const char *param_prefixed */
+
 param_list_t *param_create (const char *query_string) /* {{{ */
 {
   char *tmp;
   param_list_t *pl;
+  _Bool is_request = 0;
 
   if (query_string == NULL)
+  {
     query_string = getenv ("QUERY_STRING");
+    is_request = 1;
+  }
 
   if (query_string == NULL)
     return (NULL);
@@ -227,6 +323,8 @@ param_list_t *param_create (const char *query_string) /* {{{ */
   memset (pl, 0, sizeof (*pl));
 
   parse_query_string (pl, tmp);
+  if (is_request)
+    parse_post_data (pl);
 
   free (tmp);
   return (pl);
@@ -410,7 +508,7 @@ int param_print_hidden (param_list_t *pl) /* {{{ */
     html_escape_copy (key, pl->parameters[i].key, sizeof (key));
     html_escape_copy (value, pl->parameters[i].value, sizeof (value));
 
-    printf ("  <input type=\"hidden\" name=\"%s\" value=\"%s\" />\n",
+    resp_printf ("  <input type=\"hidden\" name=\"%s\" value=\"%s\" />\n",
         key, value);
   }
 
@@ -603,6 +701,141 @@ int time_to_rfc1123 (time_t t, char *buffer, size_t buffer_size) /* {{{ */
   return (0);
 } /* }}} int time_to_rfc1123 */
 
+int time_from_rfc1123 (const char *str, time_t *ret_time) /* {{{ */
+{
+  static const char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+  struct tm tm_tmp;
+  char month[4];
+  int status;
+  int i;
+
+  if ((str == NULL) || (ret_time == NULL))
+    return (EINVAL);
+
+  /* E.g. "Sun, 06 Nov 1994 08:49:37 GMT" */
+  memset (&tm_tmp, 0, sizeof (tm_tmp));
+  status = sscanf (str, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT",
+      &tm_tmp.tm_mday, month, &tm_tmp.tm_year,
+      &tm_tmp.tm_hour, &tm_tmp.tm_min, &tm_tmp.tm_sec);
+  if (status != 6)
+    return (EINVAL);
+
+  tm_tmp.tm_mon = -1;
+  for (i = 0; i < 12; i++)
+    if (strcmp (months[i], month) == 0)
+      tm_tmp.tm_mon = i;
+  if (tm_tmp.tm_mon < 0)
+    return (EINVAL);
+  tm_tmp.tm_year -= 1900;
+
+  *ret_time = timegm (&tm_tmp);
+  return (0);
+} /* }}} int time_from_rfc1123 */
+
+uint64_t http_etag_update (uint64_t hash, const char *str) /* {{{ */
+{
+  const unsigned char *ptr;
+
+  /* 64 bit FNV-1a */
+  for (ptr = (const unsigned char *) str; *ptr != 0; ptr++)
+  {
+    hash ^= (uint64_t) *ptr;
+    hash *= 0x100000001b3ULL;
+  }
+
+  return (hash);
+} /* }}} uint64_t http_etag_update */
+
+int http_etag_format (uint64_t hash, char *buffer, /* {{{ */
+    size_t buffer_size)
+{
+  int status;
+
+  status = snprintf (buffer, buffer_size, "\"%016"PRIx64"\"", hash);
+  if ((status < 0) || (((size_t) status) >= buffer_size))
+    return (ENOMEM);
+
+  return (0);
+} /* }}} int http_etag_format */
+
+/* Returns true if "etag" is in the comma separated list "list". Weak
+ * validators ("W/...") match, too, as suggested for GET requests. */
+static _Bool http_etag_in_list (const char *etag, /* {{{ */
+    const char *list)
+{
+  size_t etag_len = strlen (etag);
+
+  while (*list != 0)
+  {
+    size_t len;
+
+    while ((*list == ' ') || (*list == '\t') || (*list == ','))
+      list++;
+    if (*list == 0)
+      break;
+
+    if (*list == '*')
+      return (1);
+
+    if (strncmp ("W/", list, 2) == 0)
+      list += 2;
+
+    len = strcspn (list, " \t,");
+    if ((len == etag_len) && (strncmp (etag, list, len) == 0))
+      return (1);
+
+    list += len;
+  }
+
+  return (0);
+} /* }}} _Bool http_etag_in_list */
+
+void http_print_validators (const char *etag, /* {{{ */
+    time_t last_modified)
+{
+  char time_buffer[128];
+
+  if (etag != NULL)
+    resp_header ("ETag: %s", etag);
+  if ((last_modified > 0)
+      && (time_to_rfc1123 (last_modified, time_buffer,
+          sizeof (time_buffer)) == 0))
+    resp_header ("Last-Modified: %s", time_buffer);
+} /* }}} void http_print_validators */
+
+_Bool http_check_conditional (const char *etag, /* {{{ */
+    time_t last_modified)
+{
+  const char *if_none_match;
+  const char *if_modified_since;
+  _Bool not_modified = 0;
+
+  /* If-Modified-Since is ignored if If-None-Match is present, see RFC 2616,
+   * section 14.26. */
+  if_none_match = getenv ("HTTP_IF_NONE_MATCH");
+  if_modified_since = getenv ("HTTP_IF_MODIFIED_SINCE");
+  if (if_none_match != NULL)
+  {
+    if (etag != NULL)
+      not_modified = http_etag_in_list (etag, if_none_match);
+  }
+  else if ((if_modified_since != NULL) && (last_modified > 0))
+  {
+    time_t t;
+
+    if (time_from_rfc1123 (if_modified_since, &t) == 0)
+      not_modified = (last_modified <= t);
+  }
+
+  if (!not_modified)
+    return (0);
+
+  resp_header ("Status: 304 Not Modified");
+  http_print_validators (etag, last_modified);
+  return (1);
+} /* }}} _Bool http_check_conditional */
+
 #define COPY_ENTITY(e) do {    \
   size_t len = strlen (e);     \
   if (dest_size < (len + 1))   \
@@ -675,16 +908,15 @@ int html_print_page (const char *title, /* {{{ */
 {
   char *title_html;
 
-  printf ("Content-Type: text/html\n"
-      "X-Generator: "PACKAGE_STRING"\n"
-      "\n\n");
+  resp_header ("Content-Type: text/html");
+  resp_header ("X-Generator: "PACKAGE_STRING);
 
   if (title == NULL)
     title = "C&#x2084;: collection4 graph interface";
 
   title_html = html_escape (title);
 
-  printf ("<html>\n"
+  resp_printf ("<html>\n"
       "  <head>\n"
       "    <title>%s</title>\n"
       "    <link rel=\"stylesheet\" type=\"text/css\" href=\"../../share/"PACKAGE"/style.css\" />\n"
@@ -697,7 +929,7 @@ int html_print_page (const char *title, /* {{{ */
       "  </head>\n",
       title_html);
 
-  printf ("  <body>\n"
+  resp_printf ("  <body>\n"
       "    <table id=\"layout-table\">\n"
       "      <tr id=\"layout-top\">\n"
       "        <td id=\"layout-top-left\">");
@@ -705,45 +937,45 @@ int html_print_page (const char *title, /* {{{ */
     (*cb->top_left) (user_data);
   else
     html_print_logo (NULL);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "        <td id=\"layout-top-center\">");
   if (cb->top_center != NULL)
     (*cb->top_center) (user_data);
   else
-    printf ("<h1>%s</h1>", title_html);
-  printf ("</td>\n"
+    resp_printf ("<h1>%s</h1>", title_html);
+  resp_printf ("</td>\n"
       "        <td id=\"layout-top-right\">");
   if (cb->top_right != NULL)
     (*cb->top_right) (user_data);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "      </tr>\n"
       "      <tr id=\"layout-middle\">\n"
       "        <td id=\"layout-middle-left\">");
   if (cb->middle_left != NULL)
     (*cb->middle_left) (user_data);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "        <td id=\"layout-middle-center\">");
   if (cb->middle_center != NULL)
     (*cb->middle_center) (user_data);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "        <td id=\"layout-middle-right\">");
   if (cb->middle_right != NULL)
     (*cb->middle_right) (user_data);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "      </tr>\n"
       "      <tr id=\"layout-bottom\">\n"
       "        <td id=\"layout-bottom-left\">");
   if (cb->bottom_left != NULL)
     (*cb->bottom_left) (user_data);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "        <td id=\"layout-bottom-center\">");
   if (cb->bottom_center != NULL)
     (*cb->bottom_center) (user_data);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "        <td id=\"layout-bottom-right\">");
   if (cb->bottom_right != NULL)
     (*cb->bottom_right) (user_data);
-  printf ("</td>\n"
+  resp_printf ("</td>\n"
       "      </tr>\n"
       "    </table>\n"
       "    <div class=\"footer\"><a href=\"http://octo.it/c4/\">"PACKAGE_STRING"</a></div>\n"
@@ -756,7 +988,7 @@ int html_print_page (const char *title, /* {{{ */
 
 int html_print_logo (__attribute__((unused)) void *user_data) /* {{{ */
 {
-  printf ("<a href=\"%s?action=list_graphs\" id=\"logo-canvas\">\n"
+  resp_printf ("<a href=\"%s?action=list_graphs\" id=\"logo-canvas\">\n"
       "  <h1>C<sub>4</sub></h1>\n"
       "  <div id=\"logo-subscript\">collection&nbsp;4</div>\n"
       "</a>\n", script_name ());
@@ -770,7 +1002,7 @@ int html_print_search_box (__attribute__((unused)) void *user_data) /* {{{ */
 
   term_html = html_escape (param ("q"));
 
-  printf ("<form action=\"%s\" method=\"get\" id=\"search-form\">\n"
+  resp_printf ("<form action=\"%s\" method=\"get\" id=\"search-form\">\n"
       "  <input type=\"hidden\" name=\"action\" value=\"search\" />\n"
       "  <input type=\"text\" name=\"q\" value=\"%s\" id=\"search-input\" />\n"
       "  <input type=\"submit\" name=\"button\" value=\"Search\" />\n"
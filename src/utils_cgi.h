@@ -24,6 +24,7 @@
 #ifndef UTILS_CGI_H
 #define UTILS_CGI_H 1
 
+#include <stdint.h>
 #include <time.h>
 
 typedef int (*page_callback_t) (void *user_data);
@@ -51,9 +52,15 @@ typedef struct param_list_s param_list_t;
   NULL, NULL, NULL }
 
 int param_init (void);
+/* Replaces the parameters of the current request with those in
+ * "query_string". */
+int param_init_string (const char *query_string);
 void param_finish (void);
 
 const char *param (const char *key);
+/* Returns the value of the parameter "<prefix><key>". Used when a request
+ * refers to several objects, e.g. "0.host", "1.host", ... */
+const char *param_prefixed (const char *prefix, const char *key);
 
 /* Create a new parameter list from "query_string". If "query_string" is NULL,
  * the "QUERY_STRING" will be used. */
@@ -77,6 +84,23 @@ char *json_escape_copy (char *dest, const char *src, size_t n);
 const char *script_name (void);
 
 int time_to_rfc1123 (time_t t, char *buffer, size_t buffer_size);
+int time_from_rfc1123 (const char *str, time_t *ret_time);
+
+/* Entity tags are hashes over a string describing the state of the resource,
+ * e.g. the selector, the time range and the modification time of the files.
+ * Start with HTTP_ETAG_INIT and call "http_etag_update" for each part. */
+#define HTTP_ETAG_INIT 0xcbf29ce484222325ULL
+uint64_t http_etag_update (uint64_t hash, const char *str);
+int http_etag_format (uint64_t hash, char *buffer, size_t buffer_size);
+
+/* Checks the client's "If-None-Match" and "If-Modified-Since" headers. If
+ * the client's copy is current, the status is set to 304, the validators are
+ * added and true is returned; the caller must not send a body in that case.
+ * Otherwise, no headers are added. */
+_Bool http_check_conditional (const char *etag, time_t last_modified);
+/* Adds the "ETag" and "Last-Modified" headers. Call this only for successful
+ * responses, so that error messages aren't cached. */
+void http_print_validators (const char *etag, time_t last_modified);
 
 char *html_escape (const char *string);
 char *html_escape_buffer (char *buffer, size_t buffer_size);
@@ -0,0 +1,437 @@
+/**
+ * collection4 - utils_consolidate.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+
+#include "utils_consolidate.h"
+
+/* The vectorized kernels use GCC's "target" attribute, so they can be
+ * compiled without raising the baseline instruction set of the whole
+ * program, and are picked at runtime based on the CPU's features. */
+#if defined(HAVE_IMMINTRIN_H) && defined(__GNUC__) \
+  && (defined(__x86_64__) || defined(__i386__))
+# define CONSOLIDATE_HAVE_X86_KERNELS 1
+# include <immintrin.h>
+#endif
+
+struct window_stats_s
+{
+  double sum;
+  size_t count;
+  double min;
+  double max;
+};
+typedef struct window_stats_s window_stats_t;
+
+/*
+ * Private functions
+ */
+typedef void (*window_stats_func_t) (const double *values, size_t values_num,
+    window_stats_t *ret);
+
+/* Computes sum, count, minimum and maximum of the valid (non-NaN) values in
+ * one pass. A plain loop which skips NaNs: NaNs are rare and the branch is
+ * predicted well, so this is faster than masking the invalid values. */
+static void window_stats_scalar (const double *values, /* {{{ */
+    size_t values_num, window_stats_t *ret)
+{
+  double sum = 0.0;
+  size_t count = 0;
+  double min = INFINITY;
+  double max = -INFINITY;
+  size_t i;
+
+  for (i = 0; i < values_num; i++)
+  {
+    double v = values[i];
+
+    if (isnan (v))
+      continue;
+
+    sum += v;
+    count++;
+    if (v < min)
+      min = v;
+    if (v > max)
+      max = v;
+  }
+
+  ret->sum = sum;
+  ret->count = count;
+  ret->min = min;
+  ret->max = max;
+} /* }}} void window_stats_scalar */
+
+#if CONSOLIDATE_HAVE_X86_KERNELS
+/* Adds the values not handled by a vector loop. Inlined so it's compiled with
+ * the same instruction set as the calling kernel: calling legacy SSE code
+ * from AVX code is very expensive on some CPUs. */
+__attribute__ ((always_inline))
+static inline void window_stats_tail (const double *values, /* {{{ */
+    size_t values_num, window_stats_t *ret)
+{
+  size_t i;
+
+  for (i = 0; i < values_num; i++)
+  {
+    double v = values[i];
+
+    if (isnan (v))
+      continue;
+
+    ret->sum += v;
+    ret->count++;
+    if (v < ret->min)
+      ret->min = v;
+    if (v > ret->max)
+      ret->max = v;
+  }
+} /* }}} void window_stats_tail */
+
+/* Two values per iteration. The comparison mask is all ones for valid values
+ * and all zeros for NaNs; invalid lanes are replaced by the neutral element
+ * of each reduction. Counts are accumulated as doubles, which is exact for
+ * any realistic window size. */
+__attribute__ ((target ("sse2")))
+static void window_stats_sse2 (const double *values, /* {{{ */
+    size_t values_num, window_stats_t *ret)
+{
+  __m128d sum = _mm_setzero_pd ();
+  __m128d count = _mm_setzero_pd ();
+  __m128d min = _mm_set1_pd (INFINITY);
+  __m128d max = _mm_set1_pd (-INFINITY);
+  const __m128d one = _mm_set1_pd (1.0);
+  const __m128d pos_inf = _mm_set1_pd (INFINITY);
+  const __m128d neg_inf = _mm_set1_pd (-INFINITY);
+  double tmp[2];
+  size_t i;
+
+  for (i = 0; (i + 2) <= values_num; i += 2)
+  {
+    __m128d v = _mm_loadu_pd (values + i);
+    __m128d valid = _mm_cmpord_pd (v, v);
+
+    sum = _mm_add_pd (sum, _mm_and_pd (valid, v));
+    count = _mm_add_pd (count, _mm_and_pd (valid, one));
+    min = _mm_min_pd (min, _mm_or_pd (_mm_and_pd (valid, v),
+          _mm_andnot_pd (valid, pos_inf)));
+    max = _mm_max_pd (max, _mm_or_pd (_mm_and_pd (valid, v),
+          _mm_andnot_pd (valid, neg_inf)));
+  }
+
+  _mm_storeu_pd (tmp, sum);
+  ret->sum = tmp[0] + tmp[1];
+  _mm_storeu_pd (tmp, count);
+  ret->count = (size_t) (tmp[0] + tmp[1]);
+  _mm_storeu_pd (tmp, min);
+  ret->min = (tmp[0] < tmp[1]) ? tmp[0] : tmp[1];
+  _mm_storeu_pd (tmp, max);
+  ret->max = (tmp[0] > tmp[1]) ? tmp[0] : tmp[1];
+
+  window_stats_tail (values + i, values_num - i, ret);
+} /* }}} void window_stats_sse2 */
+
+/* Like "window_stats_sse2", but four values per iteration. */
+__attribute__ ((target ("avx2")))
+static void window_stats_avx2 (const double *values, /* {{{ */
+    size_t values_num, window_stats_t *ret)
+{
+  __m256d sum = _mm256_setzero_pd ();
+  __m256d count = _mm256_setzero_pd ();
+  __m256d min = _mm256_set1_pd (INFINITY);
+  __m256d max = _mm256_set1_pd (-INFINITY);
+  const __m256d one = _mm256_set1_pd (1.0);
+  const __m256d pos_inf = _mm256_set1_pd (INFINITY);
+  const __m256d neg_inf = _mm256_set1_pd (-INFINITY);
+  double tmp[4];
+  size_t i;
+
+  for (i = 0; (i + 4) <= values_num; i += 4)
+  {
+    __m256d v = _mm256_loadu_pd (values + i);
+    __m256d valid = _mm256_cmp_pd (v, v, _CMP_ORD_Q);
+
+    sum = _mm256_add_pd (sum, _mm256_and_pd (valid, v));
+    count = _mm256_add_pd (count, _mm256_and_pd (valid, one));
+    min = _mm256_min_pd (min, _mm256_blendv_pd (pos_inf, v, valid));
+    max = _mm256_max_pd (max, _mm256_blendv_pd (neg_inf, v, valid));
+  }
+
+  _mm256_storeu_pd (tmp, sum);
+  ret->sum = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+  _mm256_storeu_pd (tmp, count);
+  ret->count = (size_t) ((tmp[0] + tmp[1]) + (tmp[2] + tmp[3]));
+  _mm256_storeu_pd (tmp, min);
+  ret->min = (tmp[0] < tmp[1]) ? tmp[0] : tmp[1];
+  ret->min = (tmp[2] < ret->min) ? tmp[2] : ret->min;
+  ret->min = (tmp[3] < ret->min) ? tmp[3] : ret->min;
+  _mm256_storeu_pd (tmp, max);
+  ret->max = (tmp[0] > tmp[1]) ? tmp[0] : tmp[1];
+  ret->max = (tmp[2] > ret->max) ? tmp[2] : ret->max;
+  ret->max = (tmp[3] > ret->max) ? tmp[3] : ret->max;
+
+  window_stats_tail (values + i, values_num - i, ret);
+} /* }}} void window_stats_avx2 */
+#endif /* CONSOLIDATE_HAVE_X86_KERNELS */
+
+static window_stats_func_t window_stats_select (void) /* {{{ */
+{
+#if CONSOLIDATE_HAVE_X86_KERNELS
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    return (window_stats_avx2);
+  if (__builtin_cpu_supports ("sse2"))
+    return (window_stats_sse2);
+#endif
+
+  return (window_stats_scalar);
+} /* }}} window_stats_func_t window_stats_select */
+
+static void window_stats (const double *values, size_t values_num, /* {{{ */
+    window_stats_t *ret)
+{
+  /* Selecting the kernel is idempotent, so concurrent first calls are
+   * harmless. */
+  static window_stats_func_t func = NULL;
+
+  if (func == NULL)
+    func = window_stats_select ();
+
+  (*func) (values, values_num, ret);
+} /* }}} void window_stats */
+
+static void consolidate_simple (consolidation_t cf, /* {{{ */
+    const double *data, size_t windows_num, size_t window_size,
+    double *ret)
+{
+  size_t i;
+
+  for (i = 0; i < windows_num; i++)
+  {
+    window_stats_t ws;
+
+    window_stats (data + (i * window_size), window_size, &ws);
+
+    if (ws.count == 0)
+      ret[i] = NAN;
+    else if (cf == CONSOLIDATE_MIN)
+      ret[i] = ws.min;
+    else if (cf == CONSOLIDATE_MAX)
+      ret[i] = ws.max;
+    else
+      ret[i] = ws.sum / ((double) ws.count);
+  }
+} /* }}} void consolidate_simple */
+
+static void consolidate_minmax (const double *data, /* {{{ */
+    size_t windows_num, size_t window_size, double *ret)
+{
+  size_t i;
+
+  for (i = 0; i < windows_num; i++)
+  {
+    const double *window = data + (i * window_size);
+    window_stats_t ws;
+    size_t j;
+
+    window_stats (window, window_size, &ws);
+    if (ws.count == 0)
+    {
+      ret[2 * i] = NAN;
+      ret[2 * i + 1] = NAN;
+      continue;
+    }
+
+    /* Find out which of the two extremes comes first. */
+    for (j = 0; j < window_size; j++)
+      if ((window[j] == ws.min) || (window[j] == ws.max))
+        break;
+
+    if (window[j] == ws.min)
+    {
+      ret[2 * i] = ws.min;
+      ret[2 * i + 1] = ws.max;
+    }
+    else
+    {
+      ret[2 * i] = ws.max;
+      ret[2 * i + 1] = ws.min;
+    }
+  }
+} /* }}} void consolidate_minmax */
+
+static void consolidate_lttb (const double *data, /* {{{ */
+    size_t windows_num, size_t window_size, double *ret)
+{
+  /* Point "A", i.e. the point picked for the previous window. Positions are
+   * indexes into "data". */
+  double a_x = 0.0;
+  double a_y = NAN;
+  size_t i;
+
+  for (i = 0; i < windows_num; i++)
+  {
+    const double *window = data + (i * window_size);
+    double c_x = 0.0;
+    double c_y = NAN;
+    double best_x = 0.0;
+    double best_y = NAN;
+    double best_area = -1.0;
+    size_t j;
+
+    /* Point "C" is the average of the next window. */
+    if ((i + 1) < windows_num)
+    {
+      window_stats_t ws;
+
+      window_stats (window + window_size, window_size, &ws);
+      if (ws.count > 0)
+      {
+        c_x = ((double) ((i + 1) * window_size))
+          + (((double) (window_size - 1)) / 2.0);
+        c_y = ws.sum / ((double) ws.count);
+      }
+    }
+
+    for (j = 0; j < window_size; j++)
+    {
+      double x = (double) ((i * window_size) + j);
+      double y = window[j];
+      double area;
+
+      if (isnan (y))
+        continue;
+
+      if (isnan (a_y))
+      {
+        /* Like the first point of the data, the first valid point after a
+         * gap is always kept. */
+        best_x = x;
+        best_y = y;
+        break;
+      }
+      else if (isnan (c_y))
+      {
+        /* Last window or followed by a gap: keep the point deviating the
+         * most from "A". */
+        area = fabs (y - a_y);
+      }
+      else
+      {
+        area = fabs (((a_x - c_x) * (y - a_y)) - ((a_x - x) * (c_y - a_y)));
+      }
+
+      if (area > best_area)
+      {
+        best_area = area;
+        best_x = x;
+        best_y = y;
+      }
+    }
+
+    ret[i] = best_y;
+    a_x = best_x;
+    a_y = best_y;
+  }
+} /* }}} void consolidate_lttb */
+
+/*
+ * Public functions
+ */
+int consolidation_parse (const char *str, consolidation_t *ret) /* {{{ */
+{
+  if ((str == NULL) || (ret == NULL))
+    return (EINVAL);
+
+  if ((strcasecmp ("average", str) == 0) || (strcasecmp ("avg", str) == 0))
+    *ret = CONSOLIDATE_AVERAGE;
+  else if (strcasecmp ("min", str) == 0)
+    *ret = CONSOLIDATE_MIN;
+  else if (strcasecmp ("max", str) == 0)
+    *ret = CONSOLIDATE_MAX;
+  else if (strcasecmp ("minmax", str) == 0)
+    *ret = CONSOLIDATE_MINMAX;
+  else if (strcasecmp ("lttb", str) == 0)
+    *ret = CONSOLIDATE_LTTB;
+  else
+    return (ENOENT);
+
+  return (0);
+} /* }}} int consolidation_parse */
+
+const char *consolidation_to_string (consolidation_t cf) /* {{{ */
+{
+  switch (cf)
+  {
+    case CONSOLIDATE_AVERAGE: return ("average");
+    case CONSOLIDATE_MIN:     return ("min");
+    case CONSOLIDATE_MAX:     return ("max");
+    case CONSOLIDATE_MINMAX:  return ("minmax");
+    case CONSOLIDATE_LTTB:    return ("lttb");
+  }
+
+  return ("unknown");
+} /* }}} const char *consolidation_to_string */
+
+size_t consolidation_values_per_window (consolidation_t cf) /* {{{ */
+{
+  return ((cf == CONSOLIDATE_MINMAX) ? 2 : 1);
+} /* }}} size_t consolidation_values_per_window */
+
+int consolidate (consolidation_t cf, /* {{{ */
+    const double *data, size_t windows_num, size_t window_size,
+    double *ret)
+{
+  if ((data == NULL) || (ret == NULL) || (window_size < 1))
+    return (EINVAL);
+
+  switch (cf)
+  {
+    case CONSOLIDATE_AVERAGE:
+    case CONSOLIDATE_MIN:
+    case CONSOLIDATE_MAX:
+      consolidate_simple (cf, data, windows_num, window_size, ret);
+      break;
+
+    case CONSOLIDATE_MINMAX:
+      consolidate_minmax (data, windows_num, window_size, ret);
+      break;
+
+    case CONSOLIDATE_LTTB:
+      consolidate_lttb (data, windows_num, window_size, ret);
+      break;
+
+    default:
+      return (EINVAL);
+  }
+
+  return (0);
+} /* }}} int consolidate */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,66 @@
+/**
+ * collection4 - utils_consolidate.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_CONSOLIDATE_H
+#define UTILS_CONSOLIDATE_H 1
+
+#include <stddef.h>
+
+/* Consolidation functions used to reduce the number of data points to
+ * (roughly) the requested resolution. The input is divided into windows of
+ * "window_size" consecutive values. NaN values are ignored. */
+enum consolidation_e
+{
+  /* Arithmetic mean of each window. */
+  CONSOLIDATE_AVERAGE,
+  /* Smallest / largest value of each window. */
+  CONSOLIDATE_MIN,
+  CONSOLIDATE_MAX,
+  /* Two values per window, the minimum and the maximum, in the order in
+   * which they occur. Drawn as a line, this shows the envelope of the data,
+   * including all spikes. */
+  CONSOLIDATE_MINMAX,
+  /* Largest-triangle-three-buckets: picks the one value of each window that
+   * forms the largest triangle with the value picked for the previous window
+   * and the average of the next window. Keeps the visual shape of the data.
+   * The value is reported at the position of its window. */
+  CONSOLIDATE_LTTB
+};
+typedef enum consolidation_e consolidation_t;
+
+/* Parses "average", "min", "max", "minmax" and "lttb". */
+int consolidation_parse (const char *str, consolidation_t *ret);
+const char *consolidation_to_string (consolidation_t cf);
+
+/* Number of values "consolidate" produces per window. */
+size_t consolidation_values_per_window (consolidation_t cf);
+
+/* Consolidates "windows_num * window_size" values from "data". "ret" must
+ * have room for "windows_num * consolidation_values_per_window (cf)"
+ * values. Windows without any valid value yield NaN. */
+int consolidate (consolidation_t cf,
+    const double *data, size_t windows_num, size_t window_size,
+    double *ret);
+
+#endif /* UTILS_CONSOLIDATE_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,402 @@
+/**
+ * collection4 - utils_filecache.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/file.h>
+
+#include "utils_filecache.h"
+
+/* Entries are named after their key, printed as 16 hex digits. Other files in
+ * the directory are neither read nor removed. */
+#define FILECACHE_NAME_LEN 16
+
+/* Holds the total size of all entries, so the directory only needs to be
+ * read when entries have to be removed. Also used as the lock serializing
+ * updates of the total. */
+#define FILECACHE_SIZE_FILE "size"
+
+/* Size of the total which is stored if it is unknown, e.g. because the size
+ * file was just created. Forces a scan of the directory. */
+#define FILECACHE_SIZE_UNKNOWN UINT64_MAX
+
+struct filecache_entry_s
+{
+  char name[FILECACHE_NAME_LEN + 1];
+  off_t size;
+  time_t mtime;
+};
+typedef struct filecache_entry_s filecache_entry_t;
+
+/*
+ * Private functions
+ */
+static int fc_path (const char *dir, uint64_t key, /* {{{ */
+    char *buffer, size_t buffer_size)
+{
+  int status;
+
+  status = snprintf (buffer, buffer_size, "%s/%016"PRIx64, dir, key);
+  if ((status < 0) || ((size_t) status >= buffer_size))
+    return (ENAMETOOLONG);
+
+  return (0);
+} /* }}} int fc_path */
+
+static _Bool fc_is_entry_name (const char *name) /* {{{ */
+{
+  size_t i;
+
+  for (i = 0; i < FILECACHE_NAME_LEN; i++)
+  {
+    if (((name[i] < '0') || (name[i] > '9'))
+        && ((name[i] < 'a') || (name[i] > 'f')))
+      return (0);
+  }
+
+  return (name[FILECACHE_NAME_LEN] == 0);
+} /* }}} _Bool fc_is_entry_name */
+
+static int fc_compare_mtime (const void *a, const void *b) /* {{{ */
+{
+  const filecache_entry_t *e0 = a;
+  const filecache_entry_t *e1 = b;
+
+  if (e0->mtime < e1->mtime)
+    return (-1);
+  else if (e0->mtime > e1->mtime)
+    return (1);
+  return (strcmp (e0->name, e1->name));
+} /* }}} int fc_compare_mtime */
+
+/* Opens and locks the size file. Returns the file descriptor or -1. Closing
+ * the file descriptor releases the lock. */
+static int fc_size_lock (const char *dir) /* {{{ */
+{
+  char path[PATH_MAX];
+  int fd;
+  int status;
+
+  status = snprintf (path, sizeof (path), "%s/%s", dir, FILECACHE_SIZE_FILE);
+  if ((status < 0) || ((size_t) status >= sizeof (path)))
+    return (-1);
+
+  fd = open (path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    fprintf (stderr, "fc_size_lock: open (%s) failed: %s\n",
+        path, strerror (errno));
+    return (-1);
+  }
+
+  while (flock (fd, LOCK_EX) != 0)
+  {
+    if (errno == EINTR)
+      continue;
+
+    fprintf (stderr, "fc_size_lock: flock (%s) failed: %s\n",
+        path, strerror (errno));
+    close (fd);
+    return (-1);
+  }
+
+  return (fd);
+} /* }}} int fc_size_lock */
+
+static uint64_t fc_size_read (int fd) /* {{{ */
+{
+  uint64_t total;
+
+  if (pread (fd, &total, sizeof (total), 0) != (ssize_t) sizeof (total))
+    return (FILECACHE_SIZE_UNKNOWN);
+
+  return (total);
+} /* }}} uint64_t fc_size_read */
+
+static void fc_size_write (int fd, uint64_t total) /* {{{ */
+{
+  /* If this fails, the total is off until the next scan corrects it. */
+  if (pwrite (fd, &total, sizeof (total), 0) != (ssize_t) sizeof (total))
+    fprintf (stderr, "fc_size_write: pwrite failed: %s\n", strerror (errno));
+} /* }}} void fc_size_write */
+
+/* Reads the sizes of all entries in "dir" and, if they take more than
+ * "max_size" bytes, removes the least recently used entries until three
+ * quarters of "max_size" are left. Removing more than necessary means the
+ * directory isn't read again on the next put. The size of the remaining
+ * entries is returned in "ret_total". */
+static int fc_evict (const char *dir, size_t max_size, /* {{{ */
+    uint64_t *ret_total)
+{
+  DIR *dh;
+  struct dirent *de;
+  filecache_entry_t *entries = NULL;
+  size_t entries_num = 0;
+  size_t entries_alloc = 0;
+  uint64_t total_size = 0;
+  uint64_t low_water;
+  size_t i;
+
+  low_water = ((uint64_t) max_size) - (((uint64_t) max_size) / 4);
+
+  dh = opendir (dir);
+  if (dh == NULL)
+    return (errno);
+
+  while ((de = readdir (dh)) != NULL)
+  {
+    char path[PATH_MAX];
+    struct stat statbuf;
+    int status;
+
+    if (!fc_is_entry_name (de->d_name))
+      continue;
+
+    status = snprintf (path, sizeof (path), "%s/%s", dir, de->d_name);
+    if ((status < 0) || ((size_t) status >= sizeof (path)))
+      continue;
+
+    memset (&statbuf, 0, sizeof (statbuf));
+    if (stat (path, &statbuf) != 0)
+      continue;
+
+    if (entries_num >= entries_alloc)
+    {
+      size_t tmp_alloc = (entries_alloc == 0) ? 64 : 2 * entries_alloc;
+      filecache_entry_t *tmp;
+
+      tmp = realloc (entries, tmp_alloc * sizeof (*entries));
+      if (tmp == NULL)
+      {
+        free (entries);
+        closedir (dh);
+        return (ENOMEM);
+      }
+      entries = tmp;
+      entries_alloc = tmp_alloc;
+    }
+
+    memcpy (entries[entries_num].name, de->d_name,
+        sizeof (entries[entries_num].name));
+    entries[entries_num].size = statbuf.st_size;
+    entries[entries_num].mtime = statbuf.st_mtime;
+    entries_num++;
+
+    total_size += (uint64_t) statbuf.st_size;
+  }
+  closedir (dh);
+
+  if (total_size > (uint64_t) max_size)
+  {
+    qsort (entries, entries_num, sizeof (*entries), fc_compare_mtime);
+
+    for (i = 0; (i < entries_num) && (total_size > low_water); i++)
+    {
+      char path[PATH_MAX];
+
+      snprintf (path, sizeof (path), "%s/%s", dir, entries[i].name);
+      /* Another process may have removed the entry already. */
+      if ((unlink (path) != 0) && (errno != ENOENT))
+        continue;
+
+      total_size -= (uint64_t) entries[i].size;
+    }
+  }
+
+  free (entries);
+  *ret_total = total_size;
+  return (0);
+} /* }}} int fc_evict */
+
+/*
+ * Public functions
+ */
+int filecache_open (const char *dir, uint64_t key, /* {{{ */
+    int *ret_fd, size_t *ret_size)
+{
+  char path[PATH_MAX];
+  struct stat statbuf;
+  int fd;
+  int status;
+
+  if ((dir == NULL) || (ret_fd == NULL) || (ret_size == NULL))
+    return (EINVAL);
+
+  status = fc_path (dir, key, path, sizeof (path));
+  if (status != 0)
+    return (status);
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return (errno);
+
+  memset (&statbuf, 0, sizeof (statbuf));
+  if (fstat (fd, &statbuf) != 0)
+  {
+    status = errno;
+    close (fd);
+    return (status);
+  }
+
+  /* Mark the entry as recently used. */
+  utimes (path, NULL);
+
+  *ret_fd = fd;
+  *ret_size = (size_t) statbuf.st_size;
+  return (0);
+} /* }}} int filecache_open */
+
+int filecache_put (const char *dir, uint64_t key, /* {{{ */
+    const void *data, size_t data_size, size_t max_size)
+{
+  char path[PATH_MAX];
+  char tmp_path[PATH_MAX];
+  struct stat statbuf;
+  const char *ptr;
+  size_t left;
+  uint64_t total;
+  int size_fd;
+  int fd;
+  int status;
+
+  if ((dir == NULL) || (data == NULL))
+    return (EINVAL);
+
+  if (data_size > max_size)
+    return (EMSGSIZE);
+
+  status = fc_path (dir, key, path, sizeof (path));
+  if (status != 0)
+    return (status);
+
+  /* Write to a temporary file first and rename it, so that other processes
+   * never see partially written entries. */
+  status = snprintf (tmp_path, sizeof (tmp_path), "%s.%li.tmp",
+      path, (long) getpid ());
+  if ((status < 0) || ((size_t) status >= sizeof (tmp_path)))
+    return (ENAMETOOLONG);
+
+  fd = open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if ((fd < 0) && (errno == ENOENT))
+  {
+    if ((mkdir (dir, 0755) != 0) && (errno != EEXIST))
+    {
+      status = errno;
+      fprintf (stderr, "filecache_put: mkdir (%s) failed: %s\n",
+          dir, strerror (status));
+      return (status);
+    }
+    fd = open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd < 0)
+  {
+    status = errno;
+    fprintf (stderr, "filecache_put: open (%s) failed: %s\n",
+        tmp_path, strerror (status));
+    return (status);
+  }
+
+  ptr = data;
+  left = data_size;
+  while (left > 0)
+  {
+    ssize_t bytes_written;
+
+    bytes_written = write (fd, ptr, left);
+    if (bytes_written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      status = errno;
+      fprintf (stderr, "filecache_put: write (%s) failed: %s\n",
+          tmp_path, strerror (status));
+      close (fd);
+      unlink (tmp_path);
+      return (status);
+    }
+
+    ptr += bytes_written;
+    left -= (size_t) bytes_written;
+  }
+
+  if (close (fd) != 0)
+  {
+    status = errno;
+    unlink (tmp_path);
+    return (status);
+  }
+
+  /* Renaming and updating the total happen under the lock, so concurrent
+   * puts of the same key are accounted for correctly. */
+  size_fd = fc_size_lock (dir);
+  if (size_fd < 0)
+  {
+    unlink (tmp_path);
+    return (EIO);
+  }
+
+  total = fc_size_read (size_fd);
+
+  /* An existing entry is replaced. */
+  memset (&statbuf, 0, sizeof (statbuf));
+  if ((total != FILECACHE_SIZE_UNKNOWN) && (stat (path, &statbuf) == 0))
+    total = (total > (uint64_t) statbuf.st_size)
+      ? (total - (uint64_t) statbuf.st_size) : 0;
+
+  if (rename (tmp_path, path) != 0)
+  {
+    status = errno;
+    fprintf (stderr, "filecache_put: rename (%s) failed: %s\n",
+        tmp_path, strerror (status));
+    unlink (tmp_path);
+    close (size_fd);
+    return (status);
+  }
+
+  if (total != FILECACHE_SIZE_UNKNOWN)
+    total += (uint64_t) data_size;
+
+  status = 0;
+  if (total > (uint64_t) max_size)
+    status = fc_evict (dir, max_size, &total);
+
+  if (status == 0)
+    fc_size_write (size_fd, total);
+
+  close (size_fd);
+  return (status);
+} /* }}} int filecache_put */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
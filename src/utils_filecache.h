@@ -0,0 +1,52 @@
+/**
+ * collection4 - utils_filecache.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_FILECACHE_H
+#define UTILS_FILECACHE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Cache of rendered files, e.g. graph images, in a directory. Entries are
+ * addressed by a 64 bit hash of everything that determines their content and
+ * are never updated in place. The modification time of an entry is bumped
+ * whenever it is used. The total size of all entries is kept in the file
+ * "size" in the directory; when it exceeds the limit, the least recently used
+ * entries are removed until three quarters of the limit are left.
+ */
+
+/* Opens the entry "key" for reading. On success, "ret_fd" is an open file
+ * descriptor, which has to be closed by the caller, and "ret_size" is the size
+ * of the entry. Returns ENOENT if the entry does not exist. */
+int filecache_open (const char *dir, uint64_t key,
+    int *ret_fd, size_t *ret_size);
+
+/* Stores "data" as entry "key" and removes old entries if the total size of
+ * the entries exceeds "max_size" bytes. The directory is created if
+ * necessary. */
+int filecache_put (const char *dir, uint64_t key,
+    const void *data, size_t data_size, size_t max_size);
+
+#endif /* UTILS_FILECACHE_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
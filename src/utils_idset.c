@@ -0,0 +1,357 @@
+/**
+ * collection4 - utils_idset.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "utils_idset.h"
+
+struct idset_s
+{
+  uint32_t *ids;
+  size_t ids_num;
+  size_t ids_alloc;
+};
+
+/*
+ * Private functions
+ */
+static int idset_reserve (idset_t *s, size_t num) /* {{{ */
+{
+  uint32_t *tmp;
+  size_t new_alloc;
+
+  if (s->ids_alloc >= num)
+    return (0);
+
+  new_alloc = (s->ids_alloc > 0) ? s->ids_alloc : 16;
+  while (new_alloc < num)
+    new_alloc *= 2;
+
+  tmp = realloc (s->ids, sizeof (*s->ids) * new_alloc);
+  if (tmp == NULL)
+    return (ENOMEM);
+  s->ids = tmp;
+  s->ids_alloc = new_alloc;
+
+  return (0);
+} /* }}} int idset_reserve */
+
+/* Returns the index of the first element in "s" which is greater than or
+ * equal to "id", starting the search at "start". Uses an exponential search,
+ * so that skipping over long runs of IDs is cheap. */
+static size_t idset_seek (const idset_t *s, size_t start, uint32_t id) /* {{{ */
+{
+  size_t lo;
+  size_t hi;
+  size_t step;
+
+  if ((start >= s->ids_num) || (s->ids[start] >= id))
+    return (start);
+
+  lo = start;
+  step = 1;
+  while (42)
+  {
+    hi = lo + step;
+    if ((hi >= s->ids_num) || (s->ids[hi] >= id))
+      break;
+    lo = hi;
+    step *= 2;
+  }
+  if (hi > s->ids_num)
+    hi = s->ids_num;
+
+  /* Invariant: s->ids[lo] < id && (hi == ids_num || s->ids[hi] >= id) */
+  while ((hi - lo) > 1)
+  {
+    size_t mid = lo + ((hi - lo) / 2);
+
+    if (s->ids[mid] < id)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return (hi);
+} /* }}} size_t idset_seek */
+
+/*
+ * Public functions
+ */
+idset_t *idset_create (void) /* {{{ */
+{
+  idset_t *s;
+
+  s = malloc (sizeof (*s));
+  if (s == NULL)
+    return (NULL);
+  memset (s, 0, sizeof (*s));
+
+  s->ids = NULL;
+  s->ids_num = 0;
+  s->ids_alloc = 0;
+
+  return (s);
+} /* }}} idset_t *idset_create */
+
+idset_t *idset_create_range (uint32_t num) /* {{{ */
+{
+  idset_t *s;
+  uint32_t i;
+
+  s = idset_create ();
+  if (s == NULL)
+    return (NULL);
+
+  if (idset_reserve (s, (size_t) num) != 0)
+  {
+    idset_destroy (s);
+    return (NULL);
+  }
+
+  for (i = 0; i < num; i++)
+    s->ids[i] = i;
+  s->ids_num = (size_t) num;
+
+  return (s);
+} /* }}} idset_t *idset_create_range */
+
+idset_t *idset_clone (const idset_t *s) /* {{{ */
+{
+  idset_t *ret;
+
+  if (s == NULL)
+    return (NULL);
+
+  ret = idset_create ();
+  if (ret == NULL)
+    return (NULL);
+
+  if (idset_reserve (ret, s->ids_num) != 0)
+  {
+    idset_destroy (ret);
+    return (NULL);
+  }
+
+  if (s->ids_num > 0)
+    memcpy (ret->ids, s->ids, sizeof (*s->ids) * s->ids_num);
+  ret->ids_num = s->ids_num;
+
+  return (ret);
+} /* }}} idset_t *idset_clone */
+
+void idset_destroy (idset_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  free (s->ids);
+  free (s);
+} /* }}} void idset_destroy */
+
+int idset_append (idset_t *s, uint32_t id) /* {{{ */
+{
+  int status;
+
+  if (s == NULL)
+    return (EINVAL);
+
+  if ((s->ids_num > 0) && (s->ids[s->ids_num - 1] >= id))
+    return (EINVAL);
+
+  status = idset_reserve (s, s->ids_num + 1);
+  if (status != 0)
+    return (status);
+
+  s->ids[s->ids_num] = id;
+  s->ids_num++;
+
+  return (0);
+} /* }}} int idset_append */
+
+idset_t *idset_intersect (const idset_t *s0, const idset_t *s1) /* {{{ */
+{
+  idset_t *ret;
+  size_t i0;
+  size_t i1;
+
+  if ((s0 == NULL) || (s1 == NULL))
+    return (NULL);
+
+  /* Iterate over the smaller set and seek in the larger one. */
+  if (s0->ids_num > s1->ids_num)
+  {
+    const idset_t *tmp = s0;
+    s0 = s1;
+    s1 = tmp;
+  }
+
+  ret = idset_create ();
+  if (ret == NULL)
+    return (NULL);
+
+  if (idset_reserve (ret, s0->ids_num) != 0)
+  {
+    idset_destroy (ret);
+    return (NULL);
+  }
+
+  i1 = 0;
+  for (i0 = 0; i0 < s0->ids_num; i0++)
+  {
+    i1 = idset_seek (s1, i1, s0->ids[i0]);
+    if (i1 >= s1->ids_num)
+      break;
+
+    if (s1->ids[i1] == s0->ids[i0])
+    {
+      ret->ids[ret->ids_num] = s0->ids[i0];
+      ret->ids_num++;
+    }
+  }
+
+  return (ret);
+} /* }}} idset_t *idset_intersect */
+
+idset_t *idset_union (const idset_t *s0, const idset_t *s1) /* {{{ */
+{
+  idset_t *ret;
+  size_t i0;
+  size_t i1;
+
+  if ((s0 == NULL) || (s1 == NULL))
+    return (NULL);
+
+  ret = idset_create ();
+  if (ret == NULL)
+    return (NULL);
+
+  if (idset_reserve (ret, s0->ids_num + s1->ids_num) != 0)
+  {
+    idset_destroy (ret);
+    return (NULL);
+  }
+
+  i0 = 0;
+  i1 = 0;
+  while ((i0 < s0->ids_num) || (i1 < s1->ids_num))
+  {
+    uint32_t id;
+
+    if (i1 >= s1->ids_num)
+      id = s0->ids[i0++];
+    else if (i0 >= s0->ids_num)
+      id = s1->ids[i1++];
+    else if (s0->ids[i0] < s1->ids[i1])
+      id = s0->ids[i0++];
+    else if (s0->ids[i0] > s1->ids[i1])
+      id = s1->ids[i1++];
+    else /* if (s0->ids[i0] == s1->ids[i1]) */
+    {
+      id = s0->ids[i0];
+      i0++;
+      i1++;
+    }
+
+    ret->ids[ret->ids_num] = id;
+    ret->ids_num++;
+  }
+
+  return (ret);
+} /* }}} idset_t *idset_union */
+
+idset_t *idset_difference (const idset_t *s0, const idset_t *s1) /* {{{ */
+{
+  idset_t *ret;
+  size_t i0;
+  size_t i1;
+
+  if ((s0 == NULL) || (s1 == NULL))
+    return (NULL);
+
+  ret = idset_create ();
+  if (ret == NULL)
+    return (NULL);
+
+  if (idset_reserve (ret, s0->ids_num) != 0)
+  {
+    idset_destroy (ret);
+    return (NULL);
+  }
+
+  i1 = 0;
+  for (i0 = 0; i0 < s0->ids_num; i0++)
+  {
+    i1 = idset_seek (s1, i1, s0->ids[i0]);
+    if ((i1 < s1->ids_num) && (s1->ids[i1] == s0->ids[i0]))
+      continue;
+
+    ret->ids[ret->ids_num] = s0->ids[i0];
+    ret->ids_num++;
+  }
+
+  return (ret);
+} /* }}} idset_t *idset_difference */
+
+_Bool idset_contains (const idset_t *s, uint32_t id) /* {{{ */
+{
+  size_t pos;
+
+  if (s == NULL)
+    return (0);
+
+  pos = idset_seek (s, 0, id);
+  if ((pos < s->ids_num) && (s->ids[pos] == id))
+    return (1);
+
+  return (0);
+} /* }}} _Bool idset_contains */
+
+size_t idset_position (const idset_t *s, uint32_t id) /* {{{ */
+{
+  if (s == NULL)
+    return (0);
+
+  return (idset_seek (s, 0, id));
+} /* }}} size_t idset_position */
+
+size_t idset_size (const idset_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return (0);
+
+  return (s->ids_num);
+} /* }}} size_t idset_size */
+
+const uint32_t *idset_ids (const idset_t *s) /* {{{ */
+{
+  if ((s == NULL) || (s->ids_num == 0))
+    return (NULL);
+
+  return (s->ids);
+} /* }}} const uint32_t *idset_ids */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
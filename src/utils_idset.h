@@ -0,0 +1,60 @@
+/**
+ * collection4 - utils_idset.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_IDSET_H
+#define UTILS_IDSET_H 1
+
+#include <stdint.h>
+
+/* Sorted set of (instance) IDs. Used to evaluate search queries as set
+ * operations on the posting lists of the search index. */
+struct idset_s;
+typedef struct idset_s idset_t;
+
+idset_t *idset_create (void);
+/* Creates a set containing all IDs from zero to "num - 1". */
+idset_t *idset_create_range (uint32_t num);
+idset_t *idset_clone (const idset_t *s);
+void idset_destroy (idset_t *s);
+
+/* Appends an ID to the set. IDs must be appended in ascending order,
+ * otherwise EINVAL is returned. */
+int idset_append (idset_t *s, uint32_t id);
+
+/* The following functions return a newly allocated set which has to be freed
+ * by the caller using "idset_destroy". */
+idset_t *idset_intersect (const idset_t *s0, const idset_t *s1);
+idset_t *idset_union (const idset_t *s0, const idset_t *s1);
+idset_t *idset_difference (const idset_t *s0, const idset_t *s1);
+
+_Bool idset_contains (const idset_t *s, uint32_t id);
+
+/* Returns the position of the first element which is greater than or equal to
+ * "id", i.e. the size of the set if there is no such element. */
+size_t idset_position (const idset_t *s, uint32_t id);
+
+size_t idset_size (const idset_t *s);
+const uint32_t *idset_ids (const idset_t *s);
+
+#endif /* UTILS_IDSET_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
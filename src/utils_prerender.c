@@ -0,0 +1,262 @@
+/**
+ * collection4 - utils_prerender.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "utils_prerender.h"
+#include "utils_cgi.h"
+#include "utils_renderpool.h"
+#include "utils_response.h"
+
+/* The request counts are halved every hour. */
+#define PRERENDER_HALF_LIFE 3600.0
+
+/* Requests with a lower (decayed) count are not run again. */
+#define PRERENDER_MIN_SCORE 2.0
+
+struct prerender_entry_s
+{
+  char *query_string;
+  double score;
+  /* Largest CPU time, in milliseconds, the request took so far. Used to
+   * decide whether it fits into the remaining budget. */
+  long cost_ms;
+};
+typedef struct prerender_entry_s prerender_entry_t;
+
+/*
+ * Global variables
+ */
+static prerender_entry_t *pr_entries = NULL;
+static size_t pr_entries_num = 0;
+static size_t pr_entries_max = 32;
+
+static int pr_interval = 10;
+static int pr_budget_ms = 200;
+static time_t pr_last_run = 0;
+
+/* CPU time at the beginning of the current request. */
+static long pr_request_begin = -1;
+
+/* Set while the requests are run again, so they are not counted. */
+static _Bool pr_running = 0;
+
+/*
+ * Private functions
+ */
+static void pr_clear (void) /* {{{ */
+{
+  size_t i;
+
+  for (i = 0; i < pr_entries_num; i++)
+    free (pr_entries[i].query_string);
+  free (pr_entries);
+
+  pr_entries = NULL;
+  pr_entries_num = 0;
+} /* }}} void pr_clear */
+
+static int pr_compare_score (const void *a, const void *b) /* {{{ */
+{
+  const prerender_entry_t *e0 = a;
+  const prerender_entry_t *e1 = b;
+
+  if (e0->score > e1->score)
+    return (-1);
+  else if (e0->score < e1->score)
+    return (1);
+  return (0);
+} /* }}} int pr_compare_score */
+
+static long pr_timeval_ms (const struct timeval *tv) /* {{{ */
+{
+  return ((((long) tv->tv_sec) * 1000L) + (((long) tv->tv_usec) / 1000L));
+} /* }}} long pr_timeval_ms */
+
+/* CPU time used by this process, in user and system mode. */
+static long pr_cpu_ms (void) /* {{{ */
+{
+  struct rusage self;
+
+  memset (&self, 0, sizeof (self));
+  getrusage (RUSAGE_SELF, &self);
+
+  return (pr_timeval_ms (&self.ru_utime) + pr_timeval_ms (&self.ru_stime));
+} /* }}} long pr_cpu_ms */
+
+/*
+ * Public functions
+ */
+void prerender_configure (size_t entries_num, int interval, /* {{{ */
+    int budget_ms)
+{
+  if (entries_num != pr_entries_max)
+  {
+    pr_clear ();
+    pr_entries_max = entries_num;
+  }
+
+  pr_interval = (interval > 0) ? interval : 1;
+  pr_budget_ms = (budget_ms > 0) ? budget_ms : 0;
+} /* }}} void prerender_configure */
+
+void prerender_request_begin (void) /* {{{ */
+{
+  pr_request_begin = pr_cpu_ms ();
+} /* }}} void prerender_request_begin */
+
+void prerender_record (const char *query_string) /* {{{ */
+{
+  size_t lowest;
+  size_t i;
+  long cost_ms;
+  char *tmp;
+
+  if (pr_running || (pr_entries_max == 0)
+      || (query_string == NULL) || (query_string[0] == 0))
+    return;
+
+  cost_ms = (pr_request_begin >= 0) ? (pr_cpu_ms () - pr_request_begin) : 0;
+
+  for (i = 0; i < pr_entries_num; i++)
+  {
+    if (strcmp (pr_entries[i].query_string, query_string) == 0)
+    {
+      pr_entries[i].score += 1.0;
+      if (pr_entries[i].cost_ms < cost_ms)
+        pr_entries[i].cost_ms = cost_ms;
+      return;
+    }
+  }
+
+  tmp = strdup (query_string);
+  if (tmp == NULL)
+    return;
+
+  if (pr_entries == NULL)
+  {
+    pr_entries = calloc (pr_entries_max, sizeof (*pr_entries));
+    if (pr_entries == NULL)
+    {
+      free (tmp);
+      return;
+    }
+  }
+
+  if (pr_entries_num < pr_entries_max)
+  {
+    pr_entries[pr_entries_num].query_string = tmp;
+    pr_entries[pr_entries_num].score = 1.0;
+    pr_entries[pr_entries_num].cost_ms = cost_ms;
+    pr_entries_num++;
+    return;
+  }
+
+  /* Replace the least popular entry. */
+  lowest = 0;
+  for (i = 1; i < pr_entries_num; i++)
+    if (pr_entries[i].score < pr_entries[lowest].score)
+      lowest = i;
+
+  free (pr_entries[lowest].query_string);
+  pr_entries[lowest].query_string = tmp;
+  pr_entries[lowest].score = 1.0;
+  pr_entries[lowest].cost_ms = cost_ms;
+} /* }}} void prerender_record */
+
+int prerender_run (int (*dispatch) (void)) /* {{{ */
+{
+  time_t now;
+  double decay;
+  long cpu_begin;
+  long entry_begin;
+  long used_ms;
+  long cost_ms;
+  size_t i;
+
+  if ((dispatch == NULL) || (pr_entries_num == 0) || (pr_budget_ms == 0))
+    return (0);
+
+  now = time (NULL);
+  if ((now - pr_last_run) < pr_interval)
+    return (0);
+
+  decay = (pr_last_run == 0) ? 1.0
+    : pow (0.5, ((double) (now - pr_last_run)) / PRERENDER_HALF_LIFE);
+  pr_last_run = now;
+
+  qsort (pr_entries, pr_entries_num, sizeof (*pr_entries), pr_compare_score);
+
+  /* Unchanged data is found in the caches, so most of the budget goes to
+   * requests whose data has been updated since the last run. Renders only
+   * use free render slots; if none is free, the request is skipped rather
+   * than taking a place in the queue from a user. */
+  pr_running = 1;
+  renderpool_set_nowait (1);
+  cpu_begin = pr_cpu_ms ();
+  for (i = 0; i < pr_entries_num; i++)
+  {
+    if (pr_entries[i].score < PRERENDER_MIN_SCORE)
+      break;
+
+    used_ms = pr_cpu_ms () - cpu_begin;
+    if (used_ms >= pr_budget_ms)
+      break;
+
+    /* Skip requests which are expected to exceed the remaining budget;
+     * less popular but cheaper ones may still fit. */
+    if ((used_ms + pr_entries[i].cost_ms) > pr_budget_ms)
+      continue;
+
+    if (param_init_string (pr_entries[i].query_string) != 0)
+      continue;
+
+    entry_begin = pr_cpu_ms ();
+
+    resp_begin_discard ();
+    (*dispatch) ();
+    resp_end ();
+
+    param_finish ();
+
+    cost_ms = pr_cpu_ms () - entry_begin;
+    if (pr_entries[i].cost_ms < cost_ms)
+      pr_entries[i].cost_ms = cost_ms;
+  }
+  renderpool_set_nowait (0);
+  pr_running = 0;
+
+  for (i = 0; i < pr_entries_num; i++)
+    pr_entries[i].score *= decay;
+
+  return (0);
+} /* }}} int prerender_run */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
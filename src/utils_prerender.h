@@ -0,0 +1,54 @@
+/**
+ * collection4 - utils_prerender.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_PRERENDER_H
+#define UTILS_PRERENDER_H 1
+
+#include <stddef.h>
+
+/*
+ * Pre-rendering of popular requests. The query strings of cacheable requests
+ * are counted; between requests, the most popular ones are run again with the
+ * response discarded, which refreshes the render and data caches once new
+ * data has arrived. Each FastCGI process keeps its own statistics.
+ */
+
+/* Number of query strings to remember (zero disables pre-rendering), the
+ * minimum number of seconds between two runs and the CPU time, in
+ * milliseconds, one run may use. */
+void prerender_configure (size_t entries_num, int interval, int budget_ms);
+
+/* Marks the beginning of a request, so "prerender_record" knows how much
+ * CPU time it took. */
+void prerender_request_begin (void);
+
+/* Counts a request with the given query string. */
+void prerender_record (const char *query_string);
+
+/* Runs the most popular requests again if the last run is at least
+ * "interval" seconds ago. "dispatch" handles a request using the parameters
+ * set with "param_init_string". */
+int prerender_run (int (*dispatch) (void));
+
+#endif /* UTILS_PRERENDER_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
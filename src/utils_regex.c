@@ -0,0 +1,146 @@
+/**
+ * collection4 - utils_regex.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "utils_regex.h"
+
+char *regex_get_literal (const char *pattern) /* {{{ */
+{
+  char buffer[1024];
+  size_t buffer_len;
+  char best[1024];
+  size_t best_len;
+  int depth;
+  size_t i;
+
+  /* With alternations, no single literal is required. */
+  if (strchr (pattern, '|') != NULL)
+    return (NULL);
+
+  buffer_len = 0;
+  best_len = 0;
+  best[0] = 0;
+  depth = 0;
+
+#define END_RUN do {                                                       \
+  if (buffer_len > best_len) {                                             \
+    memcpy (best, buffer, buffer_len);                                     \
+    best_len = buffer_len;                                                 \
+  }                                                                        \
+  buffer_len = 0;                                                          \
+} while (0)
+
+  for (i = 0; pattern[i] != 0; i++)
+  {
+    char c = pattern[i];
+    char next;
+
+    if (c == '[')
+    {
+      /* Skip bracket expression. A ']' directly after '[' or '[^' is part of
+       * the expression. */
+      END_RUN;
+      i++;
+      if (pattern[i] == '^')
+        i++;
+      if (pattern[i] == ']')
+        i++;
+      while ((pattern[i] != ']') && (pattern[i] != 0))
+        i++;
+      if (pattern[i] == 0)
+        break;
+      continue;
+    }
+    else if ((c == '(') || (c == ')'))
+    {
+      /* Groups may be optional, don't take literals from them. */
+      END_RUN;
+      depth += (c == '(') ? 1 : -1;
+      continue;
+    }
+    else if (c == '{')
+    {
+      /* A bound "{m}", "{m,}" or "{m,n}" is one quantifier, its digits are
+       * not literals. The preceding character has been handled already. */
+      END_RUN;
+      while ((pattern[i] != '}') && (pattern[i] != 0))
+        i++;
+      if (pattern[i] == 0)
+        break;
+      continue;
+    }
+    else if ((c == '.') || (c == '^') || (c == '$')
+        || (c == '*') || (c == '+') || (c == '?') || (c == '}'))
+    {
+      END_RUN;
+      continue;
+    }
+    else if (c == '\\')
+    {
+      i++;
+      c = pattern[i];
+      if (c == 0)
+        break;
+      /* Only escaped special characters are literals. */
+      if (strchr (".[]()*+?{}^$|\\/", c) == NULL)
+      {
+        END_RUN;
+        continue;
+      }
+    }
+
+    if (depth > 0)
+      continue;
+
+    /* A character followed by a quantifier allowing zero repetitions is
+     * optional. "{,n}" is treated like "{0,n}". */
+    next = pattern[i + 1];
+    if ((next == '*') || (next == '?')
+        || ((next == '{') && (strtoul (pattern + i + 2, NULL, 10) == 0)))
+    {
+      END_RUN;
+      continue;
+    }
+
+    if (buffer_len < (sizeof (buffer) - 1))
+      buffer[buffer_len++] = (char) tolower ((int) c);
+
+    /* "c+", "c{m,n}": "c" is required, but may be followed by more "c"s. */
+    if ((next == '+') || (next == '{'))
+      END_RUN;
+  }
+  END_RUN;
+
+#undef END_RUN
+
+  if (best_len == 0)
+    return (NULL);
+
+  best[best_len] = 0;
+  return (strdup (best));
+} /* }}} char *regex_get_literal */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,35 @@
+/**
+ * collection4 - utils_regex.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_REGEX_H
+#define UTILS_REGEX_H 1
+
+/* Returns the longest sub-string which every string matching the extended
+ * regular expression "pattern" must contain, or NULL if no such string is
+ * found. This is used to quickly dismiss candidates with "strstr" before
+ * running the (comparatively expensive) regular expression. The returned
+ * string is lower case and must be freed by the caller. */
+char *regex_get_literal (const char *pattern);
+
+#endif /* UTILS_REGEX_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,110 @@
+/**
+ * collection4 - utils_regex_test.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+/* Checks the literals "regex_get_literal" extracts. Run with "make check". */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <regex.h>
+
+#include "utils_regex.h"
+
+struct regex_test_s
+{
+  const char *pattern;
+  /* Expected literal, NULL if none. */
+  const char *literal;
+  /* A string matching the pattern, which must contain the literal. */
+  const char *match;
+};
+typedef struct regex_test_s regex_test_t;
+
+static const regex_test_t tests[] =
+{
+  { "^web[0-9]+$",  "web",  "web01" },
+  { "cpu-?idle",    "idle", "cpuidle" },
+  { "ab*c",         "a",    "ac" },
+  { "if_(octets|packets)", NULL, "if_octets" },
+  { "^a{3}$",       "a",    "aaa" },
+  { "x{0,2}y",      "y",    "y" },
+  { "x{2,3}yz",     "yz",   "xxyz" },
+  { "x{,2}yz",      "yz",   "yz" },
+  { "load\\.{1}",   "load.", "load." }
+};
+
+static int check (const regex_test_t *t) /* {{{ */
+{
+  char *literal;
+  regex_t re;
+  int status = 0;
+
+  literal = regex_get_literal (t->pattern);
+
+  if ((t->literal == NULL) != (literal == NULL)
+      || ((literal != NULL) && (strcmp (t->literal, literal) != 0)))
+  {
+    printf ("FAIL: %s: expected literal \"%s\", got \"%s\"\n", t->pattern,
+        (t->literal != NULL) ? t->literal : "(null)",
+        (literal != NULL) ? literal : "(null)");
+    status = -1;
+  }
+
+  if (regcomp (&re, t->pattern, REG_EXTENDED | REG_ICASE | REG_NOSUB) != 0)
+  {
+    printf ("FAIL: %s: regcomp failed\n", t->pattern);
+    free (literal);
+    return (-1);
+  }
+
+  if (regexec (&re, t->match, 0, NULL, 0) != 0)
+  {
+    printf ("FAIL: %s: doesn't match \"%s\"\n", t->pattern, t->match);
+    status = -1;
+  }
+  else if ((literal != NULL) && (strstr (t->match, literal) == NULL))
+  {
+    printf ("FAIL: %s: \"%s\" matches but doesn't contain \"%s\"\n",
+        t->pattern, t->match, literal);
+    status = -1;
+  }
+
+  regfree (&re);
+  free (literal);
+  return (status);
+} /* }}} int check */
+
+int main (void) /* {{{ */
+{
+  size_t failed = 0;
+  size_t i;
+
+  for (i = 0; i < (sizeof (tests) / sizeof (tests[0])); i++)
+    if (check (tests + i) != 0)
+      failed++;
+
+  printf ("%zu of %zu tests failed.\n", failed,
+      sizeof (tests) / sizeof (tests[0]));
+  exit ((failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+} /* }}} int main */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,247 @@
+/**
+ * collection4 - utils_renderpool.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "utils_renderpool.h"
+#include "utils_response.h"
+
+/* Interval in which waiting requests check for a free slot. */
+#define RENDERPOOL_POLL_MS 10
+
+/* Upper bounds, to keep the number of lock files reasonable. */
+#define RENDERPOOL_SLOTS_MAX 64
+#define RENDERPOOL_QUEUE_MAX 256
+
+/*
+ * Global variables
+ */
+static char *rp_dir = NULL;
+static int rp_slots = 0;
+static int rp_queue_size = 0;
+static int rp_timeout = 30;
+static _Bool rp_nowait = 0;
+
+/* Lock files, opened on first use. Each render slot and each place in the
+ * queue is one file; holding an exclusive lock on it means occupying it. */
+static int rp_slot_fds[RENDERPOOL_SLOTS_MAX];
+static int rp_queue_fds[RENDERPOOL_QUEUE_MAX];
+static _Bool rp_fds_init = 0;
+
+/*
+ * Private functions
+ */
+static long rp_now_ms (void) /* {{{ */
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ((((long) ts.tv_sec) * 1000L) + (ts.tv_nsec / 1000000L));
+} /* }}} long rp_now_ms */
+
+static void rp_close_all (void) /* {{{ */
+{
+  int i;
+
+  if (!rp_fds_init)
+  {
+    for (i = 0; i < RENDERPOOL_SLOTS_MAX; i++)
+      rp_slot_fds[i] = -1;
+    for (i = 0; i < RENDERPOOL_QUEUE_MAX; i++)
+      rp_queue_fds[i] = -1;
+    rp_fds_init = 1;
+    return;
+  }
+
+  for (i = 0; i < RENDERPOOL_SLOTS_MAX; i++)
+  {
+    if (rp_slot_fds[i] >= 0)
+      close (rp_slot_fds[i]);
+    rp_slot_fds[i] = -1;
+  }
+  for (i = 0; i < RENDERPOOL_QUEUE_MAX; i++)
+  {
+    if (rp_queue_fds[i] >= 0)
+      close (rp_queue_fds[i]);
+    rp_queue_fds[i] = -1;
+  }
+} /* }}} void rp_close_all */
+
+static int rp_open_lock (const char *prefix, int index) /* {{{ */
+{
+  char path[PATH_MAX];
+  int fd;
+
+  snprintf (path, sizeof (path), "%s/%s-%i.lock", rp_dir, prefix, index);
+  path[sizeof (path) - 1] = 0;
+
+  fd = open (path, O_RDWR | O_CREAT, 0644);
+  if ((fd < 0) && (errno == ENOENT))
+  {
+    if ((mkdir (rp_dir, 0755) != 0) && (errno != EEXIST))
+    {
+      fprintf (stderr, "rp_open_lock: mkdir (%s) failed: %s\n",
+          rp_dir, strerror (errno));
+      return (-1);
+    }
+    fd = open (path, O_RDWR | O_CREAT, 0644);
+  }
+  if (fd < 0)
+  {
+    fprintf (stderr, "rp_open_lock: open (%s) failed: %s\n",
+        path, strerror (errno));
+    return (-1);
+  }
+
+  return (fd);
+} /* }}} int rp_open_lock */
+
+/* Locks one of the "fds_num" files without blocking. Returns the file
+ * descriptor or -1 if all are locked. */
+static int rp_try_lock (int *fds, int fds_num, const char *prefix) /* {{{ */
+{
+  int i;
+
+  for (i = 0; i < fds_num; i++)
+  {
+    if (fds[i] < 0)
+      fds[i] = rp_open_lock (prefix, i);
+    if (fds[i] < 0)
+      continue;
+
+    if (flock (fds[i], LOCK_EX | LOCK_NB) == 0)
+      return (fds[i]);
+  }
+
+  return (-1);
+} /* }}} int rp_try_lock */
+
+/*
+ * Public functions
+ */
+void renderpool_configure (const char *dir, int slots, /* {{{ */
+    int queue_size, int timeout)
+{
+  char *tmp;
+
+  rp_close_all ();
+
+  tmp = (dir != NULL) ? strdup (dir) : NULL;
+  free (rp_dir);
+  rp_dir = tmp;
+
+  if (slots > RENDERPOOL_SLOTS_MAX)
+    slots = RENDERPOOL_SLOTS_MAX;
+  if (queue_size > RENDERPOOL_QUEUE_MAX)
+    queue_size = RENDERPOOL_QUEUE_MAX;
+
+  rp_slots = (slots > 0) ? slots : 0;
+  rp_queue_size = (queue_size > 0) ? queue_size : 0;
+  rp_timeout = (timeout > 0) ? timeout : 1;
+} /* }}} void renderpool_configure */
+
+int renderpool_run (renderpool_callback_t callback, void *user_data, /* {{{ */
+    char **ret_data, size_t *ret_size)
+{
+  long deadline;
+  int queue_fd = -1;
+  int slot_fd;
+  int status;
+
+  if ((callback == NULL) || (ret_data == NULL) || (ret_size == NULL))
+    return (EINVAL);
+
+  *ret_data = NULL;
+  *ret_size = 0;
+
+  if ((rp_slots == 0) || (rp_dir == NULL))
+  {
+    status = (*callback) (user_data, ret_data, ret_size);
+    return ((status == 0) ? 0 : EIO);
+  }
+
+  if (!rp_fds_init)
+    rp_close_all ();
+
+  deadline = rp_now_ms () + (1000L * rp_timeout);
+
+  /* Admission: take a free slot right away or a place in the queue. */
+  slot_fd = rp_try_lock (rp_slot_fds, rp_slots, "render");
+  if ((slot_fd < 0) && rp_nowait)
+    return (EBUSY);
+  else if (slot_fd < 0)
+  {
+    queue_fd = rp_try_lock (rp_queue_fds, rp_queue_size, "queue");
+    if (queue_fd < 0)
+      return (EBUSY);
+  }
+
+  while (slot_fd < 0)
+  {
+    if (rp_now_ms () >= deadline)
+    {
+      flock (queue_fd, LOCK_UN);
+      return (ETIMEDOUT);
+    }
+
+    usleep (1000 * RENDERPOOL_POLL_MS);
+    slot_fd = rp_try_lock (rp_slot_fds, rp_slots, "render");
+  }
+
+  if (queue_fd >= 0)
+    flock (queue_fd, LOCK_UN);
+
+  /* The render itself runs in this process and can't be interrupted, so the
+   * deadline only limits the time spent waiting. */
+  status = (*callback) (user_data, ret_data, ret_size);
+
+  flock (slot_fd, LOCK_UN);
+
+  return ((status == 0) ? 0 : EIO);
+} /* }}} int renderpool_run */
+
+void renderpool_set_nowait (_Bool nowait) /* {{{ */
+{
+  rp_nowait = nowait;
+} /* }}} void renderpool_set_nowait */
+
+void renderpool_print_unavailable (void) /* {{{ */
+{
+  resp_header ("Status: 503 Service Unavailable");
+  resp_header ("Retry-After: %i", rp_timeout);
+  resp_header ("Content-Type: text/plain");
+  resp_header ("Cache-Control: no-cache");
+  resp_printf ("Too many graphs are being rendered. Please try again later.\n");
+} /* }}} void renderpool_print_unavailable */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,64 @@
+/**
+ * collection4 - utils_renderpool.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_RENDERPOOL_H
+#define UTILS_RENDERPOOL_H 1
+
+#include <stddef.h>
+
+/*
+ * Admission control for renders: the number of graphs rendered at the same
+ * time and of requests waiting for a render slot is limited across all
+ * FastCGI processes using lock files. Requests which can't be admitted or
+ * wait too long are answered with "503 Service Unavailable", so heavy graphs
+ * can't tie up every FastCGI process. Renders run in the requesting process;
+ * a process rendering a graph doesn't serve other requests meanwhile.
+ */
+
+/* Renders into a buffer allocated with malloc(3), which is returned in
+ * "ret_data". On failure, "ret_data" may hold an error message. */
+typedef int (*renderpool_callback_t) (void *user_data,
+    char **ret_data, size_t *ret_size);
+
+/* "dir" holds the lock files. At most "slots" renders run at the same time,
+ * zero disables the limit. Up to "queue_size" requests wait for a slot, for
+ * at most "timeout" seconds. */
+void renderpool_configure (const char *dir, int slots, int queue_size,
+    int timeout);
+
+/* Waits for a render slot and runs "callback" while holding it. Returns
+ * EBUSY if the queue is full, ETIMEDOUT if no slot became free in time and
+ * EIO if the callback failed. */
+int renderpool_run (renderpool_callback_t callback, void *user_data,
+    char **ret_data, size_t *ret_size);
+
+/* While set, "renderpool_run" doesn't wait in the queue but returns EBUSY
+ * right away if no slot is free. Used for background work which must not
+ * delay requests. */
+void renderpool_set_nowait (_Bool nowait);
+
+/* Sends a "503 Service Unavailable" response with a "Retry-After" header. */
+void renderpool_print_unavailable (void);
+
+#endif /* UTILS_RENDERPOOL_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,552 @@
+/**
+ * collection4 - utils_response.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#include <zlib.h>
+
+#include "utils_response.h"
+
+#include <fcgiapp.h>
+#include <fcgi_stdio.h>
+
+/* Size of the body buffer. Writes are passed on to the FastCGI library in
+ * chunks of this size. */
+#define RESP_BUFFER_SIZE 65536
+
+/* Size of the buffer receiving the output of zlib. */
+#define RESP_ZBUFFER_SIZE 16384
+
+enum resp_encoding_e
+{
+  RESP_ENCODING_IDENTITY,
+  RESP_ENCODING_GZIP,
+  RESP_ENCODING_DEFLATE
+};
+typedef enum resp_encoding_e resp_encoding_t;
+
+/*
+ * Global variables
+ */
+static char *resp_headers = NULL;
+static size_t resp_headers_len = 0;
+static size_t resp_headers_alloc = 0;
+static _Bool resp_headers_done = 0;
+
+static char resp_buffer[RESP_BUFFER_SIZE];
+static size_t resp_buffer_len = 0;
+
+static int resp_compression_level = RESP_COMPRESSION_LEVEL_DEFAULT;
+static size_t resp_compression_threshold = RESP_COMPRESSION_THRESHOLD_DEFAULT;
+
+/* Encoding of the current response. Decided when the headers are sent. */
+static resp_encoding_t resp_encoding = RESP_ENCODING_IDENTITY;
+static z_stream resp_zstream;
+static _Bool resp_zstream_init = 0;
+static unsigned char resp_zbuffer[RESP_ZBUFFER_SIZE];
+
+/* If set, the response is generated but not sent, see "resp_begin_discard". */
+static _Bool resp_discard = 0;
+
+/*
+ * Private functions
+ */
+/* Returns the value of the header "name" or NULL. The returned pointer points
+ * into the header buffer, the value is terminated by a newline. */
+static const char *resp_get_header (const char *name) /* {{{ */
+{
+  size_t name_len = strlen (name);
+  size_t pos = 0;
+
+  while (pos < resp_headers_len)
+  {
+    const char *line = resp_headers + pos;
+    const char *eol;
+
+    eol = memchr (line, '\n', resp_headers_len - pos);
+    if (eol == NULL)
+      break;
+
+    if ((((size_t) (eol - line)) > name_len)
+        && (strncasecmp (name, line, name_len) == 0)
+        && (line[name_len] == ':'))
+    {
+      line += name_len + 1;
+      while ((*line == ' ') || (*line == '\t'))
+        line++;
+      return (line);
+    }
+
+    pos += ((size_t) (eol - line)) + 1;
+  }
+
+  return (NULL);
+} /* }}} const char *resp_get_header */
+
+/* Only textual content compresses well. Images, e.g. PNGs, are already
+ * compressed. */
+static _Bool resp_content_compressible (void) /* {{{ */
+{
+  const char *content_types[] =
+  {
+    "text/",
+    "application/json",
+    "application/javascript",
+    "application/octet-stream",
+    "image/svg+xml"
+  };
+  const char *content_type;
+  size_t i;
+
+  /* We'd have to know the compressed size in advance. */
+  if (resp_get_header ("Content-Length") != NULL)
+    return (0);
+
+  content_type = resp_get_header ("Content-Type");
+  if (content_type == NULL)
+    return (0);
+
+  for (i = 0; i < sizeof (content_types) / sizeof (content_types[0]); i++)
+    if (strncasecmp (content_types[i], content_type,
+          strlen (content_types[i])) == 0)
+      return (1);
+
+  return (0);
+} /* }}} _Bool resp_content_compressible */
+
+/* Parses the "Accept-Encoding" header sent by the client. "gzip" is
+ * preferred over "deflate"; codings with a "q" value of zero are not
+ * acceptable. */
+static resp_encoding_t resp_negotiate_encoding (void) /* {{{ */
+{
+  const char *accept;
+  /* 1: acceptable, -1: explicitly refused, 0: not mentioned */
+  int gzip = 0;
+  int deflate = 0;
+  _Bool any = 0;
+
+  accept = getenv ("HTTP_ACCEPT_ENCODING");
+  if (accept == NULL)
+    return (RESP_ENCODING_IDENTITY);
+
+  while (*accept != 0)
+  {
+    const char *coding;
+    size_t coding_len;
+    _Bool acceptable = 1;
+
+    while ((*accept == ' ') || (*accept == '\t') || (*accept == ','))
+      accept++;
+    if (*accept == 0)
+      break;
+
+    coding = accept;
+    coding_len = strcspn (coding, " \t;,");
+    accept += coding_len;
+
+    /* Parameters, e.g. ";q=0.5" */
+    while ((*accept == ' ') || (*accept == '\t'))
+      accept++;
+    while (*accept == ';')
+    {
+      accept++;
+      while ((*accept == ' ') || (*accept == '\t'))
+        accept++;
+
+      if (((accept[0] == 'q') || (accept[0] == 'Q')) && (accept[1] == '='))
+        acceptable = (strtod (accept + 2, NULL) > 0.0);
+
+      accept += strcspn (accept, ";,");
+    }
+
+    if (((coding_len == 4) && (strncasecmp ("gzip", coding, 4) == 0))
+        || ((coding_len == 6) && (strncasecmp ("x-gzip", coding, 6) == 0)))
+      gzip = acceptable ? 1 : -1;
+    else if ((coding_len == 7) && (strncasecmp ("deflate", coding, 7) == 0))
+      deflate = acceptable ? 1 : -1;
+    else if ((coding_len == 1) && (coding[0] == '*') && acceptable)
+      any = 1;
+  }
+
+  /* "*" matches all codings not listed explicitly. */
+  if ((gzip > 0) || ((gzip == 0) && any))
+    return (RESP_ENCODING_GZIP);
+  else if ((deflate > 0) || ((deflate == 0) && any))
+    return (RESP_ENCODING_DEFLATE);
+  return (RESP_ENCODING_IDENTITY);
+} /* }}} resp_encoding_t resp_negotiate_encoding */
+
+static void resp_zstream_end (void) /* {{{ */
+{
+  if (resp_zstream_init)
+    deflateEnd (&resp_zstream);
+  resp_zstream_init = 0;
+} /* }}} void resp_zstream_end */
+
+/* Decides whether to compress the response. Called when the headers are
+ * about to be sent, i.e. when "body_size" bytes of the body are known. A
+ * response is compressed if the client supports it, the content type is
+ * compressible and the body is at least as large as the threshold -- the
+ * latter is certainly the case if the buffer had to be flushed before the
+ * end of the response. */
+static void resp_choose_encoding (size_t body_size) /* {{{ */
+{
+  resp_encoding_t encoding;
+  int window_bits;
+  int status;
+
+  resp_encoding = RESP_ENCODING_IDENTITY;
+
+  if (!resp_content_compressible ())
+    return;
+
+  /* The response depends on "Accept-Encoding" whether it's compressed or
+   * not. */
+  resp_header ("Vary: Accept-Encoding");
+
+  if ((resp_compression_level <= 0) || (body_size == 0)
+      || (body_size < resp_compression_threshold))
+    return;
+
+  encoding = resp_negotiate_encoding ();
+  if (encoding == RESP_ENCODING_IDENTITY)
+    return;
+
+  /* 15 bits is the largest window; adding 16 selects the gzip wrapper,
+   * otherwise the zlib wrapper is used as required for "deflate". */
+  window_bits = (encoding == RESP_ENCODING_GZIP) ? (15 + 16) : 15;
+
+  memset (&resp_zstream, 0, sizeof (resp_zstream));
+  status = deflateInit2 (&resp_zstream, resp_compression_level, Z_DEFLATED,
+      window_bits, /* memLevel = */ 8, Z_DEFAULT_STRATEGY);
+  if (status != Z_OK)
+  {
+    fprintf (stderr, "resp_choose_encoding: deflateInit2 failed with "
+        "status %i\n", status);
+    return;
+  }
+  resp_zstream_init = 1;
+
+  resp_encoding = encoding;
+  resp_header ("Content-Encoding: %s",
+      (encoding == RESP_ENCODING_GZIP) ? "gzip" : "deflate");
+} /* }}} void resp_choose_encoding */
+
+static int resp_send_headers (size_t body_size) /* {{{ */
+{
+  if (resp_headers_done)
+    return (0);
+
+  if (resp_discard)
+  {
+    resp_headers_done = 1;
+    return (0);
+  }
+
+  resp_choose_encoding (body_size);
+
+  if (resp_headers_len > 0)
+    fwrite (resp_headers, /* size = */ 1, /* nmemb = */ resp_headers_len,
+        stdout);
+  fwrite ("\n", /* size = */ 1, /* nmemb = */ 1, stdout);
+
+  resp_headers_done = 1;
+  return (0);
+} /* }}} int resp_send_headers */
+
+/* Passes data to the client, compressing it if appropriate. "flush" is one
+ * of zlib's flush values: Z_NO_FLUSH lets zlib hold back data to improve the
+ * compression ratio, Z_FINISH terminates the compressed stream. */
+static int resp_output (const void *buffer, size_t buffer_size, /* {{{ */
+    int flush)
+{
+  int status;
+
+  if (resp_discard)
+    return (0);
+
+  if (resp_encoding == RESP_ENCODING_IDENTITY)
+  {
+    if (buffer_size > 0)
+      fwrite (buffer, /* size = */ 1, /* nmemb = */ buffer_size, stdout);
+    return (0);
+  }
+
+  if (!resp_zstream_init)
+    return (EINVAL);
+
+  /* The cast is required by zlib's API; the input is not modified. */
+  resp_zstream.next_in = (Bytef *) buffer;
+  resp_zstream.avail_in = (uInt) buffer_size;
+
+  do
+  {
+    size_t have;
+
+    resp_zstream.next_out = resp_zbuffer;
+    resp_zstream.avail_out = (uInt) sizeof (resp_zbuffer);
+
+    status = deflate (&resp_zstream, flush);
+    if (status == Z_STREAM_ERROR)
+    {
+      fprintf (stderr, "resp_output: deflate failed.\n");
+      return (-1);
+    }
+
+    have = sizeof (resp_zbuffer) - resp_zstream.avail_out;
+    if (have > 0)
+      fwrite (resp_zbuffer, /* size = */ 1, /* nmemb = */ have, stdout);
+  } while (resp_zstream.avail_out == 0);
+
+  if (flush == Z_FINISH)
+    resp_zstream_end ();
+
+  return (0);
+} /* }}} int resp_output */
+
+/* Writes the buffered body. */
+static int resp_flush_buffer (int flush) /* {{{ */
+{
+  int status;
+
+  resp_send_headers (resp_buffer_len);
+
+  if ((resp_buffer_len == 0) && (flush == Z_NO_FLUSH))
+    return (0);
+
+  status = resp_output (resp_buffer, resp_buffer_len, flush);
+  resp_buffer_len = 0;
+
+  return (status);
+} /* }}} int resp_flush_buffer */
+
+/*
+ * Public functions
+ */
+int resp_begin (void) /* {{{ */
+{
+  resp_headers_len = 0;
+  resp_headers_done = 0;
+  resp_buffer_len = 0;
+
+  /* Clean up after a request that didn't call resp_end. */
+  resp_zstream_end ();
+  resp_encoding = RESP_ENCODING_IDENTITY;
+  resp_discard = 0;
+
+  return (0);
+} /* }}} int resp_begin */
+
+int resp_begin_discard (void) /* {{{ */
+{
+  int status;
+
+  status = resp_begin ();
+  resp_discard = 1;
+
+  return (status);
+} /* }}} int resp_begin_discard */
+
+int resp_end (void) /* {{{ */
+{
+  int status;
+
+  status = resp_flush_buffer (Z_FINISH);
+  resp_encoding = RESP_ENCODING_IDENTITY;
+
+  free (resp_headers);
+  resp_headers = NULL;
+  resp_headers_len = 0;
+  resp_headers_alloc = 0;
+
+  return (status);
+} /* }}} int resp_end */
+
+int resp_header (const char *format, ...) /* {{{ */
+{
+  char line[4096];
+  size_t line_len;
+  va_list ap;
+  int status;
+
+  if (resp_headers_done)
+  {
+    fprintf (stderr, "resp_header: Headers have already been sent.\n");
+    return (EINVAL);
+  }
+
+  va_start (ap, format);
+  status = vsnprintf (line, sizeof (line) - 1, format, ap);
+  va_end (ap);
+  if ((status < 0) || (((size_t) status) >= (sizeof (line) - 1)))
+  {
+    fprintf (stderr, "resp_header: Header line too long.\n");
+    return (ENOMEM);
+  }
+
+  line_len = (size_t) status;
+  line[line_len] = '\n';
+  line_len++;
+
+  if ((resp_headers_len + line_len) > resp_headers_alloc)
+  {
+    size_t new_alloc = (resp_headers_alloc == 0) ? 1024 : resp_headers_alloc;
+    char *tmp;
+
+    while (new_alloc < (resp_headers_len + line_len))
+      new_alloc *= 2;
+
+    tmp = realloc (resp_headers, new_alloc);
+    if (tmp == NULL)
+      return (ENOMEM);
+    resp_headers = tmp;
+    resp_headers_alloc = new_alloc;
+  }
+
+  memcpy (resp_headers + resp_headers_len, line, line_len);
+  resp_headers_len += line_len;
+
+  return (0);
+} /* }}} int resp_header */
+
+_Bool resp_headers_sent (void) /* {{{ */
+{
+  return (resp_headers_done);
+} /* }}} _Bool resp_headers_sent */
+
+int resp_flush (void) /* {{{ */
+{
+  /* Z_SYNC_FLUSH makes everything written so far decodable by the client. */
+  return (resp_flush_buffer (Z_SYNC_FLUSH));
+} /* }}} int resp_flush */
+
+int resp_write (const void *buffer, size_t buffer_size) /* {{{ */
+{
+  if ((buffer == NULL) && (buffer_size > 0))
+    return (EINVAL);
+
+  if ((resp_buffer_len + buffer_size) > sizeof (resp_buffer))
+  {
+    /* The headers are sent here at the latest, so pass the size of the data
+     * at hand to the compression decision. */
+    if (!resp_headers_done)
+      resp_send_headers (resp_buffer_len + buffer_size);
+    resp_flush_buffer (Z_NO_FLUSH);
+
+    /* Don't copy large blocks, e.g. images, into the buffer. */
+    if (buffer_size >= sizeof (resp_buffer))
+      return (resp_output (buffer, buffer_size, Z_NO_FLUSH));
+  }
+
+  memcpy (resp_buffer + resp_buffer_len, buffer, buffer_size);
+  resp_buffer_len += buffer_size;
+
+  return (0);
+} /* }}} int resp_write */
+
+int resp_write_fd (int fd, size_t size) /* {{{ */
+{
+  char buffer[16384];
+
+  if (fd < 0)
+    return (EINVAL);
+
+  while (size > 0)
+  {
+    ssize_t bytes_read;
+
+    bytes_read = read (fd, buffer,
+        (size < sizeof (buffer)) ? size : sizeof (buffer));
+    if ((bytes_read < 0) && (errno == EINTR))
+      continue;
+    else if (bytes_read < 0)
+      return (errno);
+    else if (bytes_read == 0)
+      return (EIO);
+
+    resp_write (buffer, (size_t) bytes_read);
+    size -= (size_t) bytes_read;
+  }
+
+  return (0);
+} /* }}} int resp_write_fd */
+
+int resp_printf (const char *format, ...) /* {{{ */
+{
+  size_t avail;
+  char *tmp;
+  va_list ap;
+  int status;
+
+  /* Try to format directly into the buffer. */
+  avail = sizeof (resp_buffer) - resp_buffer_len;
+  va_start (ap, format);
+  status = vsnprintf (resp_buffer + resp_buffer_len, avail, format, ap);
+  va_end (ap);
+  if (status < 0)
+    return (status);
+
+  if (((size_t) status) < avail)
+  {
+    resp_buffer_len += (size_t) status;
+    return (status);
+  }
+
+  /* Not enough space: Format into a temporary buffer. */
+  tmp = malloc (((size_t) status) + 1);
+  if (tmp == NULL)
+    return (-ENOMEM);
+
+  va_start (ap, format);
+  vsnprintf (tmp, ((size_t) status) + 1, format, ap);
+  va_end (ap);
+
+  resp_write (tmp, (size_t) status);
+  free (tmp);
+
+  return (status);
+} /* }}} int resp_printf */
+
+int resp_set_compression (int level, size_t threshold) /* {{{ */
+{
+  if ((level < 0) || (level > 9))
+    return (EINVAL);
+
+  resp_compression_level = level;
+  resp_compression_threshold = threshold;
+
+  return (0);
+} /* }}} int resp_set_compression */
+
+void resp_yajl_print (__attribute__((unused)) void *ctx, /* {{{ */
+    const char *str, unsigned int len)
+{
+  resp_write (str, (size_t) len);
+} /* }}} void resp_yajl_print */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,83 @@
+/**
+ * collection4 - utils_response.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_RESPONSE_H
+#define UTILS_RESPONSE_H 1
+
+#include <stddef.h>
+
+#define RESP_COMPRESSION_LEVEL_DEFAULT 6
+#define RESP_COMPRESSION_THRESHOLD_DEFAULT 1024
+
+/*
+ * Response writer: collects the HTTP headers and buffers the body of the
+ * response in large contiguous chunks, so the FastCGI library is called a
+ * few times per response rather than once per token.
+ *
+ * Headers are held back until the first chunk of the body is written. After
+ * that, adding headers fails with EINVAL.
+ *
+ * Textual responses are compressed with gzip or deflate if the client
+ * accepts it (HTTP_ACCEPT_ENCODING) and the body is at least as large as the
+ * compression threshold. Compression is streamed: each chunk is compressed
+ * when it's flushed.
+ */
+
+/* Resets the writer. Must be called at the beginning of each request. */
+int resp_begin (void);
+/* Like "resp_begin", but the response is thrown away instead of being sent
+ * to the client. Used to run actions for their side effects, e.g. filling
+ * caches. */
+int resp_begin_discard (void);
+
+/* Finishes the header section if necessary and flushes the remaining body.
+ * Must be called at the end of each request. */
+int resp_end (void);
+
+/* Adds a header line, e.g. resp_header ("Content-Type: %s", "text/html").
+ * The format must not include the trailing newline. */
+int resp_header (const char *format, ...)
+  __attribute__ ((format (printf, 1, 2)));
+
+/* Returns true if the header section has already been sent. */
+_Bool resp_headers_sent (void);
+
+int resp_write (const void *buffer, size_t buffer_size);
+/* Copies "size" bytes from the file descriptor "fd" to the body. */
+int resp_write_fd (int fd, size_t size);
+int resp_printf (const char *format, ...)
+  __attribute__ ((format (printf, 1, 2)));
+
+/* Sends all buffered data to the client. */
+int resp_flush (void);
+
+/* Sets the zlib compression level (1-9, 0 disables compression) and the
+ * body size in bytes below which responses are sent uncompressed. */
+int resp_set_compression (int level, size_t threshold);
+
+/* Print callback for yajl generators, e.g.
+ *   yajl_gen_alloc2 (resp_yajl_print, &config, NULL, NULL); */
+void resp_yajl_print (void *ctx, const char *str, unsigned int len);
+
+#endif /* UTILS_RESPONSE_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */
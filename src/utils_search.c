@@ -24,27 +24,94 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <errno.h>
+#include <sys/types.h>
+#include <regex.h>
 
 #include "utils_search.h"
+#include "common.h"
 #include "graph_ident.h"
-#include "graph_instance.h"
-#include "utils_array.h"
+#include "graph_index.h"
+#include "utils_idset.h"
+#include "utils_regex.h"
 
 #include <fcgiapp.h>
 #include <fcgi_stdio.h>
 
+enum search_node_type_e
+{
+  SEARCH_AND,
+  SEARCH_OR,
+  SEARCH_NOT,
+  SEARCH_FIELD,
+  SEARCH_TERM
+};
+typedef enum search_node_type_e search_node_type_t;
+
+struct search_node_s;
+typedef struct search_node_s search_node_t;
+struct search_node_s
+{
+  search_node_type_t type;
+
+  /* SEARCH_FIELD only */
+  graph_ident_field_t field;
+  /* SEARCH_FIELD and SEARCH_TERM; always lower case */
+  char *value;
+  /* Set if "value" is a regular expression, i.e. the term was given as
+   * "/pattern/". "literal" is a (lower case) sub-string every match must
+   * contain, or NULL. */
+  regex_t *regex;
+  char *literal;
+
+  /* SEARCH_AND, SEARCH_OR and SEARCH_NOT */
+  search_node_t **children;
+  size_t children_num;
+};
+
 struct search_info_s
 {
-  char *host;
-  char *plugin;
-  char *plugin_instance;
-  char *type;
-  char *type_instance;
+  /* NULL matches all instances. */
+  search_node_t *root;
+};
+
+#define TOKEN_WORD   0
+#define TOKEN_QUOTED 1
+#define TOKEN_OPEN   2
+#define TOKEN_CLOSE  3
+
+struct search_token_s
+{
+  int type;
+  char *str;
+};
+typedef struct search_token_s search_token_t;
 
-  str_array_t *terms;
+struct search_parser_s
+{
+  search_token_t *tokens;
+  size_t tokens_num;
+  size_t pos;
+  int status;
+};
+typedef struct search_parser_s search_parser_t;
+
+static const struct
+{
+  const char *prefix;
+  graph_ident_field_t field;
+} search_fields[] =
+{
+  { "host:",            GIF_HOST },
+  { "plugin:",          GIF_PLUGIN },
+  { "plugin_instance:", GIF_PLUGIN_INSTANCE },
+  { "type:",            GIF_TYPE },
+  { "type_instance:",   GIF_TYPE_INSTANCE }
 };
+static const size_t search_fields_num =
+  sizeof (search_fields) / sizeof (search_fields[0]);
 
 /*
  * Private functions
@@ -110,8 +177,29 @@ static char *read_unquoted_word (const char **buffer) /* {{{ */
   size_t ret_len;
 
   ret_len = 0;
-  while (!isspace ((int) ptr[ret_len]) && (ptr[ret_len] != 0))
+  while (!isspace ((int) ptr[ret_len]) && (ptr[ret_len] != 0)
+      && (ptr[ret_len] != '(') && (ptr[ret_len] != ')'))
+  {
+    /* A slash at the beginning of a value starts a regular expression, which
+     * may contain white space and parentheses. Read up to the closing
+     * slash. */
+    if ((ptr[ret_len] == '/')
+        && ((ret_len == 0) || (ptr[ret_len - 1] == ':')
+          || ((ret_len == 1) && (ptr[0] == '-'))))
+    {
+      ret_len++;
+      while ((ptr[ret_len] != '/') && (ptr[ret_len] != 0))
+      {
+        if ((ptr[ret_len] == '\\') && (ptr[ret_len + 1] != 0))
+          ret_len++;
+        ret_len++;
+      }
+      if (ptr[ret_len] == 0)
+        break;
+    }
+
     ret_len++;
+  }
 
   if (ret_len < 1)
     return (NULL);
@@ -129,74 +217,714 @@ static char *read_unquoted_word (const char **buffer) /* {{{ */
   return (ret);
 } /* }}} char *read_unquoted_word */
 
-static char *next_token (const char **buffer) /* {{{ */
+/* Returns zero and fills "ret_token" if a token was read, ENOENT at the end of
+ * the string and ENOMEM if allocating memory failed. */
+static int next_token (const char **buffer, /* {{{ */
+    search_token_t *ret_token)
 {
   const char *ptr = *buffer;
-  char *ret;
+  char *str;
 
   while (isspace ((int) (*ptr)))
     ptr++;
 
   if (ptr[0] == 0)
-    return (NULL);
+    return (ENOENT);
+
+  if ((ptr[0] == '(') || (ptr[0] == ')'))
+  {
+    ret_token->type = (ptr[0] == '(') ? TOKEN_OPEN : TOKEN_CLOSE;
+    ret_token->str = NULL;
+    *buffer = ptr + 1;
+    return (0);
+  }
   else if (ptr[0] == '"')
   {
-    ret = read_quoted_string (&ptr);
-    if (ret != NULL)
+    str = read_quoted_string (&ptr);
+    if (str != NULL)
     {
+      ret_token->type = TOKEN_QUOTED;
+      ret_token->str = str;
       *buffer = ptr;
-      return (ret);
+      return (0);
     }
   }
 
-  ret = read_unquoted_word (&ptr);
-  if (ret != NULL)
-    *buffer = ptr;
+  str = read_unquoted_word (&ptr);
+  if (str == NULL)
+    return (ENOMEM);
 
-  return (ret);
-} /* }}} char *next_token */
+  ret_token->type = TOKEN_WORD;
+  ret_token->str = str;
+  *buffer = ptr;
 
-static int store_token_field (char **field, const char *token) /* {{{ */
+  return (0);
+} /* }}} int next_token */
+
+static int tokenize (search_parser_t *p, const char *search) /* {{{ */
 {
-  char *copy;
+  const char *ptr = search;
 
-  if ((field == NULL) || (token == NULL))
-    return (EINVAL);
+  while (42)
+  {
+    search_token_t token;
+    search_token_t *tmp;
+    int status;
+
+    memset (&token, 0, sizeof (token));
+    status = next_token (&ptr, &token);
+    if (status == ENOENT)
+      break;
+    else if (status != 0)
+      return (status);
 
-  copy = strdup (token);
-  if (copy == NULL)
+    tmp = realloc (p->tokens, sizeof (*p->tokens) * (p->tokens_num + 1));
+    if (tmp == NULL)
+    {
+      free (token.str);
+      return (ENOMEM);
+    }
+    p->tokens = tmp;
+
+    p->tokens[p->tokens_num] = token;
+    p->tokens_num++;
+  }
+
+  return (0);
+} /* }}} int tokenize */
+
+static void node_destroy (search_node_t *n) /* {{{ */
+{
+  size_t i;
+
+  if (n == NULL)
+    return;
+
+  for (i = 0; i < n->children_num; i++)
+    node_destroy (n->children[i]);
+  free (n->children);
+  free (n->value);
+  if (n->regex != NULL)
+  {
+    regfree (n->regex);
+    free (n->regex);
+  }
+  free (n->literal);
+  free (n);
+} /* }}} void node_destroy */
+
+static search_node_t *node_create (search_node_type_t type) /* {{{ */
+{
+  search_node_t *n;
+
+  n = malloc (sizeof (*n));
+  if (n == NULL)
+    return (NULL);
+  memset (n, 0, sizeof (*n));
+
+  n->type = type;
+  n->value = NULL;
+  n->regex = NULL;
+  n->literal = NULL;
+  n->children = NULL;
+  n->children_num = 0;
+
+  return (n);
+} /* }}} search_node_t *node_create */
+
+static int node_add_child (search_node_t *n, search_node_t *child) /* {{{ */
+{
+  search_node_t **tmp;
+
+  tmp = realloc (n->children, sizeof (*n->children) * (n->children_num + 1));
+  if (tmp == NULL)
     return (ENOMEM);
+  n->children = tmp;
 
-  free (*field);
-  *field = copy;
+  n->children[n->children_num] = child;
+  n->children_num++;
 
   return (0);
-} /* }}} int store_token_field */
+} /* }}} int node_add_child */
+
+/* Checks whether "str" has the form "/pattern/" and, if so, compiles the
+ * pattern and stores it in "n". Returns ENOENT if "str" is not a regular
+ * expression. */
+static int node_set_regex (search_node_t *n, const char *str) /* {{{ */
+{
+  char *pattern;
+  size_t str_len;
+  int status;
+
+  str_len = strlen (str);
+  if ((str_len < 3) || (str[0] != '/') || (str[str_len - 1] != '/'))
+    return (ENOENT);
+
+  pattern = strdup (str + 1);
+  if (pattern == NULL)
+    return (ENOMEM);
+  pattern[str_len - 2] = 0;
+
+  n->regex = malloc (sizeof (*n->regex));
+  if (n->regex == NULL)
+  {
+    free (pattern);
+    return (ENOMEM);
+  }
+
+  status = regcomp (n->regex, pattern, REG_EXTENDED | REG_ICASE | REG_NOSUB);
+  if (status != 0)
+  {
+    char errbuf[256];
+
+    regerror (status, n->regex, errbuf, sizeof (errbuf));
+    fprintf (stderr, "node_set_regex: Compiling \"%s\" failed: %s\n",
+        pattern, errbuf);
+    free (n->regex);
+    n->regex = NULL;
+    free (pattern);
+    return (EINVAL);
+  }
+
+  n->literal = regex_get_literal (pattern);
+  n->value = pattern;
+
+  return (0);
+} /* }}} int node_set_regex */
+
+static search_node_t *node_create_leaf (const char *str, /* {{{ */
+    _Bool quoted)
+{
+  search_node_t *n;
+  size_t i;
+
+  n = node_create (SEARCH_TERM);
+  if (n == NULL)
+    return (NULL);
+
+  for (i = 0; !quoted && (i < search_fields_num); i++)
+  {
+    size_t prefix_len = strlen (search_fields[i].prefix);
+
+    if (strncasecmp (search_fields[i].prefix, str, prefix_len) != 0)
+      continue;
+
+    n->type = SEARCH_FIELD;
+    n->field = search_fields[i].field;
+    str += prefix_len;
+    break;
+  }
+
+  if (!quoted)
+  {
+    int status;
+
+    status = node_set_regex (n, str);
+    if (status == 0)
+      return (n);
+    else if (status == ENOMEM)
+    {
+      free (n);
+      return (NULL);
+    }
+    /* else: Not a regular expression or an invalid one. Search for the
+     * string instead. */
+  }
+
+  n->value = strtolower_copy (str);
+  if (n->value == NULL)
+  {
+    free (n);
+    return (NULL);
+  }
+
+  return (n);
+} /* }}} search_node_t *node_create_leaf */
+
+/* Combines "n0" and "n1" into one node of type "type" (SEARCH_AND or
+ * SEARCH_OR). Nested nodes of the same type are flattened. Either argument
+ * may be NULL. */
+static search_node_t *node_combine (search_parser_t *p, /* {{{ */
+    search_node_type_t type, search_node_t *n0, search_node_t *n1)
+{
+  search_node_t *ret;
+
+  if (n0 == NULL)
+    return (n1);
+  else if (n1 == NULL)
+    return (n0);
+
+  if (n0->type == type)
+    ret = n0;
+  else
+  {
+    ret = node_create (type);
+    if ((ret == NULL) || (node_add_child (ret, n0) != 0))
+    {
+      p->status = ENOMEM;
+      free (ret);
+      node_destroy (n0);
+      node_destroy (n1);
+      return (NULL);
+    }
+  }
+
+  if (n1->type == type)
+  {
+    size_t i;
+
+    /* Move the children of "n1" to "ret". On failure, the children already
+     * moved are owned by "ret" and must not be freed twice. */
+    for (i = 0; i < n1->children_num; i++)
+    {
+      if (node_add_child (ret, n1->children[i]) != 0)
+        break;
+      n1->children[i] = NULL;
+    }
+
+    if (i < n1->children_num)
+    {
+      p->status = ENOMEM;
+      node_destroy (ret);
+      node_destroy (n1);
+      return (NULL);
+    }
+
+    n1->children_num = 0;
+    node_destroy (n1);
+    return (ret);
+  }
+
+  if (node_add_child (ret, n1) != 0)
+  {
+    p->status = ENOMEM;
+    node_destroy (ret);
+    node_destroy (n1);
+    return (NULL);
+  }
+
+  return (ret);
+} /* }}} search_node_t *node_combine */
+
+static search_node_t *node_negate (search_parser_t *p, /* {{{ */
+    search_node_t *child)
+{
+  search_node_t *n;
+
+  if (child == NULL)
+    return (NULL);
+
+  n = node_create (SEARCH_NOT);
+  if ((n == NULL) || (node_add_child (n, child) != 0))
+  {
+    p->status = ENOMEM;
+    free (n);
+    node_destroy (child);
+    return (NULL);
+  }
+
+  return (n);
+} /* }}} search_node_t *node_negate */
+
+/* Cheap nodes are evaluated first within an AND node, so that the expensive
+ * sub-string search only needs to look at the remaining candidates. */
+static int node_cost (const search_node_t *n) /* {{{ */
+{
+  if (n->type == SEARCH_FIELD)
+    return ((n->regex == NULL) ? 0 : 1);
+  else if (n->type == SEARCH_TERM)
+    return ((n->regex == NULL) ? 3 : 4);
+  return (2);
+} /* }}} int node_cost */
+
+static void node_sort_children (search_node_t *n) /* {{{ */
+{
+  size_t i;
+
+  /* Insertion sort: stable and the number of children is small. */
+  for (i = 1; i < n->children_num; i++)
+  {
+    search_node_t *tmp = n->children[i];
+    size_t j = i;
+
+    while ((j > 0) && (node_cost (n->children[j - 1]) > node_cost (tmp)))
+    {
+      n->children[j] = n->children[j - 1];
+      j--;
+    }
+    n->children[j] = tmp;
+  }
+} /* }}} void node_sort_children */
+
+static _Bool token_is_keyword (const search_token_t *t, /* {{{ */
+    const char *keyword)
+{
+  if ((t == NULL) || (t->type != TOKEN_WORD))
+    return (0);
+
+  return (strcasecmp (keyword, t->str) == 0);
+} /* }}} _Bool token_is_keyword */
+
+static search_token_t *parser_peek (search_parser_t *p) /* {{{ */
+{
+  if (p->pos >= p->tokens_num)
+    return (NULL);
+  return (p->tokens + p->pos);
+} /* }}} search_token_t *parser_peek */
+
+static search_node_t *parse_or (search_parser_t *p);
+
+/* unary := ( "NOT" | "-" ) unary | "(" or ")" | word */
+static search_node_t *parse_unary (search_parser_t *p) /* {{{ */
+{
+  search_token_t *t;
+  search_node_t *n;
+
+  t = parser_peek (p);
+  if ((t == NULL) || (t->type == TOKEN_CLOSE))
+    return (NULL);
+
+  p->pos++;
+
+  if (t->type == TOKEN_OPEN)
+  {
+    n = parse_or (p);
 
-static int store_token (search_info_t *si, const char *token) /* {{{ */
+    t = parser_peek (p);
+    if ((t != NULL) && (t->type == TOKEN_CLOSE))
+      p->pos++;
+    /* else: missing closing parenthesis. Be lenient. */
+
+    return (n);
+  }
+  else if (token_is_keyword (t, "NOT") || token_is_keyword (t, "-"))
+  {
+    return (node_negate (p, parse_unary (p)));
+  }
+  else if ((t->type == TOKEN_WORD) && (t->str[0] == '-'))
+  {
+    n = node_create_leaf (t->str + 1, /* quoted = */ 0);
+    if (n == NULL)
+      p->status = ENOMEM;
+    return (node_negate (p, n));
+  }
+
+  n = node_create_leaf (t->str, /* quoted = */ (t->type == TOKEN_QUOTED));
+  if (n == NULL)
+    p->status = ENOMEM;
+  return (n);
+} /* }}} search_node_t *parse_unary */
+
+/* and := unary ( [ "AND" ] unary )* */
+static search_node_t *parse_and (search_parser_t *p) /* {{{ */
+{
+  search_node_t *ret = NULL;
+
+  while (42)
+  {
+    search_token_t *t;
+
+    t = parser_peek (p);
+    if ((t == NULL) || (t->type == TOKEN_CLOSE) || token_is_keyword (t, "OR"))
+      break;
+
+    if (token_is_keyword (t, "AND"))
+    {
+      p->pos++;
+      continue;
+    }
+
+    ret = node_combine (p, SEARCH_AND, ret, parse_unary (p));
+  }
+
+  if ((ret != NULL) && (ret->type == SEARCH_AND))
+    node_sort_children (ret);
+
+  return (ret);
+} /* }}} search_node_t *parse_and */
+
+/* or := and ( "OR" and )* */
+static search_node_t *parse_or (search_parser_t *p) /* {{{ */
+{
+  search_node_t *ret;
+
+  ret = parse_and (p);
+
+  while (token_is_keyword (parser_peek (p), "OR"))
+  {
+    p->pos++;
+    ret = node_combine (p, SEARCH_OR, ret, parse_and (p));
+  }
+
+  return (ret);
+} /* }}} search_node_t *parse_or */
+
+/* Returns the subset of "candidates" which matches the node "n". */
+static idset_t *node_eval (const search_node_t *n, /* {{{ */
+    const graph_index_t *idx, const idset_t *candidates)
+{
+  idset_t *ret;
+  size_t i;
+
+  if ((n->type == SEARCH_FIELD) && (n->regex != NULL))
+  {
+    idset_t *tmp;
+
+    tmp = idx_lookup_field_regex (idx, n->field, n->regex, n->literal);
+    if (tmp == NULL)
+      return (NULL);
+
+    ret = idset_intersect (candidates, tmp);
+    idset_destroy (tmp);
+    return (ret);
+  }
+  else if (n->type == SEARCH_FIELD)
+  {
+    const idset_t *postings;
+
+    postings = idx_lookup_field (idx, n->field, n->value);
+    if (postings == NULL)
+      return (idset_create ());
+    return (idset_intersect (candidates, postings));
+  }
+  else if (n->type == SEARCH_TERM)
+  {
+    const uint32_t *ids = idset_ids (candidates);
+    size_t ids_num = idset_size (candidates);
+
+    ret = idset_create ();
+    if (ret == NULL)
+      return (NULL);
+
+    for (i = 0; i < ids_num; i++)
+    {
+      if (n->regex != NULL)
+      {
+        if ((n->literal != NULL)
+            && !idx_matches_string (idx, ids[i], n->literal))
+          continue;
+        if (!idx_matches_regex (idx, ids[i], n->regex))
+          continue;
+      }
+      else if (!idx_matches_string (idx, ids[i], n->value))
+        continue;
+
+      if (idset_append (ret, ids[i]) != 0)
+      {
+        idset_destroy (ret);
+        return (NULL);
+      }
+    }
+
+    return (ret);
+  }
+  else if (n->type == SEARCH_NOT)
+  {
+    idset_t *tmp;
+
+    tmp = node_eval (n->children[0], idx, candidates);
+    if (tmp == NULL)
+      return (NULL);
+
+    ret = idset_difference (candidates, tmp);
+    idset_destroy (tmp);
+    return (ret);
+  }
+  else if (n->type == SEARCH_AND)
+  {
+    ret = idset_clone (candidates);
+
+    /* Each child only needs to look at the instances matched by all
+     * previous children. */
+    for (i = 0; (i < n->children_num) && (ret != NULL); i++)
+    {
+      idset_t *tmp;
+
+      if (idset_size (ret) == 0)
+        break;
+
+      tmp = node_eval (n->children[i], idx, ret);
+      idset_destroy (ret);
+      ret = tmp;
+    }
+
+    return (ret);
+  }
+  else if (n->type == SEARCH_OR)
+  {
+    ret = idset_create ();
+
+    /* Each child only needs to look at the instances not yet matched by
+     * any previous child. */
+    for (i = 0; (i < n->children_num) && (ret != NULL); i++)
+    {
+      idset_t *remaining;
+      idset_t *matches;
+      idset_t *tmp;
+
+      remaining = idset_difference (candidates, ret);
+      if (remaining == NULL)
+        break;
+
+      if (idset_size (remaining) == 0)
+      {
+        idset_destroy (remaining);
+        break;
+      }
+
+      matches = node_eval (n->children[i], idx, remaining);
+      idset_destroy (remaining);
+      if (matches == NULL)
+      {
+        idset_destroy (ret);
+        return (NULL);
+      }
+
+      tmp = idset_union (ret, matches);
+      idset_destroy (matches);
+      idset_destroy (ret);
+      ret = tmp;
+    }
+
+    return (ret);
+  }
+
+  return (NULL);
+} /* }}} idset_t *node_eval */
+
+/* Returns the value of "field" if the field is required by the top-level
+ * conjunction of the search, NULL otherwise. */
+static const char *search_get_required_field (search_info_t *si, /* {{{ */
+    graph_ident_field_t field)
+{
+  search_node_t *root;
+  size_t i;
+
+  if ((si == NULL) || (si->root == NULL))
+    return (NULL);
+
+  root = si->root;
+  if (root->type == SEARCH_FIELD)
+    return (((root->field == field) && (root->regex == NULL))
+        ? root->value : NULL);
+  else if (root->type != SEARCH_AND)
+    return (NULL);
+
+  for (i = 0; i < root->children_num; i++)
+  {
+    search_node_t *n = root->children[i];
+
+    if ((n->type == SEARCH_FIELD) && (n->field == field)
+        && (n->regex == NULL))
+      return (n->value);
+  }
+
+  return (NULL);
+} /* }}} const char *search_get_required_field */
+
+static int string_compare (const void *v0, const void *v1) /* {{{ */
+{
+  return (strcmp (*(char * const *) v0, *(char * const *) v1));
+} /* }}} int string_compare */
+
+/* Returns the canonical form of "n" as a newly allocated string. Children of
+ * AND and OR nodes are sorted, so that equivalent queries result in the same
+ * string. */
+static char *node_to_string (const search_node_t *n) /* {{{ */
 {
-  if (strncmp ("host:", token, strlen ("host:")) == 0)
-    return (store_token_field (&si->host, token + strlen ("host:")));
-  else if (strncmp ("plugin:", token, strlen ("plugin:")) == 0)
-    return (store_token_field (&si->plugin, token + strlen ("plugin:")));
-  else if (strncmp ("plugin_instance:", token, strlen ("plugin_instance:")) == 0)
-    return (store_token_field (&si->plugin_instance, token + strlen ("plugin_instance:")));
-  else if (strncmp ("type:", token, strlen ("type:")) == 0)
-    return (store_token_field (&si->type, token + strlen ("type:")));
-  else if (strncmp ("type_instance:", token, strlen ("type_instance:")) == 0)
-    return (store_token_field (&si->type_instance, token + strlen ("type_instance:")));
+  char **children;
+  char *ret;
+  size_t ret_len;
+  size_t i;
+
+  if (n->children_num == 0)
+  {
+    char prefix[3];
+    const char *value = n->value;
+
+    /* Leaf: type, field and the quoted value. */
+    if (n->type == SEARCH_FIELD)
+      prefix[0] = (n->regex != NULL) ? 'R' : 'F';
+    else
+      prefix[0] = (n->regex != NULL) ? 'r' : 't';
+    prefix[1] = (n->type == SEARCH_FIELD) ? (char) ('0' + n->field) : '-';
+    prefix[2] = 0;
+
+    ret = malloc (strlen (prefix) + 2 * strlen (value) + 3);
+    if (ret == NULL)
+      return (NULL);
+
+    strcpy (ret, prefix);
+    ret_len = strlen (ret);
+    ret[ret_len++] = '"';
+    for (i = 0; value[i] != 0; i++)
+    {
+      if ((value[i] == '"') || (value[i] == '\\'))
+        ret[ret_len++] = '\\';
+      ret[ret_len++] = value[i];
+    }
+    ret[ret_len++] = '"';
+    ret[ret_len] = 0;
+
+    return (ret);
+  }
+
+  children = calloc (n->children_num, sizeof (*children));
+  if (children == NULL)
+    return (NULL);
 
-  return (array_append (si->terms, token));
-} /* }}} int store_token */
+  /* "X(" + children separated by ',' + ")" */
+  ret_len = 3;
+  for (i = 0; i < n->children_num; i++)
+  {
+    children[i] = node_to_string (n->children[i]);
+    if (children[i] == NULL)
+      break;
+    ret_len += strlen (children[i]) + 1;
+  }
+
+  ret = NULL;
+  if (i == n->children_num)
+  {
+    if (n->type != SEARCH_NOT)
+      qsort (children, n->children_num, sizeof (*children), string_compare);
+
+    ret = malloc (ret_len);
+  }
+
+  if (ret != NULL)
+  {
+    if (n->type == SEARCH_AND)
+      strcpy (ret, "&(");
+    else if (n->type == SEARCH_OR)
+      strcpy (ret, "|(");
+    else
+      strcpy (ret, "!(");
+
+    for (i = 0; i < n->children_num; i++)
+    {
+      if (i != 0)
+        strlcat (ret, ",", ret_len);
+      strlcat (ret, children[i], ret_len);
+    }
+    strlcat (ret, ")", ret_len);
+  }
+
+  for (i = 0; i < n->children_num; i++)
+    free (children[i]);
+  free (children);
+
+  return (ret);
+} /* }}} char *node_to_string */
 
 /*
  * Public functions
  */
 search_info_t *search_parse (const char *search) /* {{{ */
 {
-  const char *ptr;
-  char *token;
+  search_parser_t p;
   search_info_t *si;
+  size_t i;
 
   if (search == NULL)
     return (NULL);
@@ -205,20 +933,30 @@ search_info_t *search_parse (const char *search) /* {{{ */
   if (si == NULL)
     return (NULL);
   memset (si, 0, sizeof (*si));
+  si->root = NULL;
+
+  memset (&p, 0, sizeof (p));
+  p.tokens = NULL;
+  p.status = tokenize (&p, search);
+
+  if (p.status == 0)
+    si->root = parse_or (&p);
 
-  si->terms = array_create ();
-  if (si->terms == NULL)
+  /* Skip unbalanced closing parentheses and AND the remaining expressions. */
+  while ((p.status == 0) && (p.pos < p.tokens_num))
   {
-    free (si);
-    return (NULL);
+    p.pos++;
+    si->root = node_combine (&p, SEARCH_AND, si->root, parse_or (&p));
   }
 
-  ptr = search;
+  for (i = 0; i < p.tokens_num; i++)
+    free (p.tokens[i].str);
+  free (p.tokens);
 
-  while ((token = next_token (&ptr)) != NULL)
+  if (p.status != 0)
   {
-    store_token (si, token);
-    free (token);
+    search_destroy (si);
+    return (NULL);
   }
 
   return (si);
@@ -229,43 +967,46 @@ void search_destroy (search_info_t *si) /* {{{ */
   if (si == NULL)
     return;
 
-  free (si->host);
-  free (si->plugin);
-  free (si->plugin_instance);
-  free (si->type);
-  free (si->type_instance);
-
-  array_destroy (si->terms);
+  node_destroy (si->root);
+  free (si);
 } /* }}} void search_destroy */
 
 _Bool search_has_selector (search_info_t *si) /* {{{ */
 {
-  if (si == NULL)
-    return (0);
+  graph_ident_field_t field;
 
-  if ((si->host != NULL)
-      || (si->plugin != NULL) || (si->plugin_instance != NULL)
-      || (si->type != NULL) || (si->type_instance != NULL))
-    return (1);
+  for (field = 0; field < _GIF_LAST; field++)
+    if (search_get_required_field (si, field) != NULL)
+      return (1);
 
   return (0);
 } /* }}} _Bool search_has_selector */
 
 graph_ident_t *search_to_ident (search_info_t *si) /* {{{ */
 {
+  const char *fields[_GIF_LAST];
+  graph_ident_field_t field;
+
   if (si == NULL)
     return (NULL);
 
-  return (ident_create ((si->host == NULL) ? ANY_TOKEN : si->host,
-        (si->plugin == NULL) ? ANY_TOKEN : si->plugin,
-        (si->plugin_instance == NULL) ? ANY_TOKEN : si->plugin_instance,
-        (si->type == NULL) ? ANY_TOKEN : si->type,
-        (si->type_instance == NULL) ? ANY_TOKEN : si->type_instance));
+  for (field = 0; field < _GIF_LAST; field++)
+  {
+    fields[field] = search_get_required_field (si, field);
+    if (fields[field] == NULL)
+      fields[field] = ANY_TOKEN;
+  }
+
+  return (ident_create (fields[GIF_HOST],
+        fields[GIF_PLUGIN], fields[GIF_PLUGIN_INSTANCE],
+        fields[GIF_TYPE], fields[GIF_TYPE_INSTANCE]));
 } /* }}} graph_ident_t *search_to_ident */
 
 search_info_t *search_from_ident (const graph_ident_t *ident) /* {{{ */
 {
+  search_parser_t p;
   search_info_t *si;
+  size_t i;
 
   if (ident == NULL)
     return (NULL);
@@ -274,93 +1015,69 @@ search_info_t *search_from_ident (const graph_ident_t *ident) /* {{{ */
   if (si == NULL)
     return (NULL);
   memset (si, 0, sizeof (*si));
-  si->terms = NULL;
+  si->root = NULL;
 
-#define COPY_FIELD(f) do {                                                   \
-  const char *tmp = ident_get_##f (ident);                                   \
-  if (tmp == NULL)                                                           \
-    si->f = NULL;                                                            \
-  else                                                                       \
-    si->f = strdup (tmp);                                                    \
-} while (0)
+  memset (&p, 0, sizeof (p));
 
-  COPY_FIELD(host);
-  COPY_FIELD(plugin);
-  COPY_FIELD(plugin_instance);
-  COPY_FIELD(type);
-  COPY_FIELD(type_instance);
+  for (i = 0; i < search_fields_num; i++)
+  {
+    const char *value = ident_get_field (ident, search_fields[i].field);
+    search_node_t *n;
 
-#undef COPY_FIELD
+    if ((value == NULL) || IS_ANY (value) || IS_ALL (value))
+      continue;
+
+    n = node_create (SEARCH_FIELD);
+    if (n != NULL)
+    {
+      n->field = search_fields[i].field;
+      n->value = strtolower_copy (value);
+    }
+    if ((n == NULL) || (n->value == NULL))
+    {
+      free (n);
+      search_destroy (si);
+      return (NULL);
+    }
+
+    si->root = node_combine (&p, SEARCH_AND, si->root, n);
+    if (p.status != 0)
+    {
+      search_destroy (si);
+      return (NULL);
+    }
+  }
 
   return (si);
 } /* }}} search_info_t *search_from_ident */
 
-_Bool search_graph_title_matches (search_info_t *si, /* {{{ */
-    const char *title)
+char *search_to_string (search_info_t *si) /* {{{ */
 {
-  char **argv;
-  int argc;
-  int i;
-
-  if ((si == NULL) || (title == NULL))
-    return (0);
-
-  if (si->terms == NULL)
-    return (1);
+  if (si == NULL)
+    return (NULL);
 
-  argc = array_argc (si->terms);
-  argv = array_argv (si->terms);
-  for (i = 0; i < argc; i++)
-    if (strstr (title, argv[i]) == NULL)
-      return (0);
+  if (si->root == NULL)
+    return (strdup ("*"));
 
-  return (1);
-} /* }}} _Bool search_graph_title_matches */
+  return (node_to_string (si->root));
+} /* }}} char *search_to_string */
 
-_Bool search_graph_inst_matches (search_info_t *si, /* {{{ */
-    graph_config_t *cfg, graph_instance_t *inst,
-    const char *title)
+idset_t *search_eval (search_info_t *si, const graph_index_t *idx) /* {{{ */
 {
-  char **argv;
-  int argc;
-  int i;
-
-  if ((si == NULL) || (cfg == NULL) || (inst == NULL))
-    return (0);
+  idset_t *all;
+  idset_t *ret;
 
-  if ((si->host != NULL)
-      && !inst_matches_field (inst, GIF_HOST, si->host))
-    return (0);
-  else if ((si->plugin != NULL)
-      && !inst_matches_field (inst, GIF_PLUGIN, si->plugin))
-    return (0);
-  else if ((si->plugin_instance != NULL)
-      && !inst_matches_field (inst, GIF_PLUGIN_INSTANCE, si->plugin_instance))
-    return (0);
-  else if ((si->type != NULL)
-      && !inst_matches_field (inst, GIF_TYPE, si->type))
-    return (0);
-  else if ((si->type_instance != NULL)
-      && !inst_matches_field (inst, GIF_TYPE_INSTANCE, si->type_instance))
-    return (0);
+  if ((si == NULL) || (idx == NULL))
+    return (NULL);
 
-  if (si->terms == NULL)
-    return (1);
+  all = idset_create_range (idx_size (idx));
+  if ((all == NULL) || (si->root == NULL))
+    return (all);
 
-  argc = array_argc (si->terms);
-  argv = array_argv (si->terms);
-  for (i = 0; i < argc; i++)
-  {
-    if (inst_matches_string (cfg, inst, argv[i]))
-      continue;
-
-    if ((title != NULL) && (strstr (title, argv[i]) != NULL))
-      continue;
+  ret = node_eval (si->root, idx, all);
+  idset_destroy (all);
 
-    return (0);
-  }
-
-  return (1);
-} /* }}} _Bool search_graph_inst_matches */
+  return (ret);
+} /* }}} idset_t *search_eval */
 
 /* vim: set sw=2 sts=2 et fdm=marker : */
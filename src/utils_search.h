@@ -25,10 +25,21 @@
 #define UTILS_SEARCH_H 1
 
 #include "graph_types.h"
+#include "graph_index.h"
+#include "utils_idset.h"
 
 struct search_info_s;
 typedef struct search_info_s search_info_t;
 
+/* Parses a search string. Terms are separated by whitespace and implicitly
+ * combined using AND. The keywords "OR" and "NOT" (or a leading "-"), as well
+ * as parentheses, can be used to build more complex queries, e.g.
+ *   host:web01 (type:cpu OR type:memory) -type_instance:idle
+ * Terms of the form "field:value" require an exact (case-insensitive) match
+ * of the ident field, all other terms are sub-string searches on the
+ * instance's description and the graph's title. Values enclosed in slashes,
+ * e.g. "host:/^web[0-9]+$/", are case-insensitive extended regular
+ * expressions. */
 search_info_t *search_parse (const char *search);
 void search_destroy (search_info_t *si);
 
@@ -40,11 +51,14 @@ _Bool search_has_selector (search_info_t *si);
 graph_ident_t *search_to_ident (search_info_t *si);
 search_info_t *search_from_ident (const graph_ident_t *ident);
 
-_Bool search_graph_title_matches (search_info_t *si, const char *title);
+/* Returns a normalized representation of the search as a newly allocated
+ * string. Searches which differ only in case, in the order of their terms or
+ * in redundant parentheses return the same string. */
+char *search_to_string (search_info_t *si);
 
-_Bool search_graph_inst_matches (search_info_t *si,
-    graph_config_t *cfg, graph_instance_t *inst,
-    const char *title);
+/* Returns the IDs of all instances in "idx" matching the search. The
+ * returned set must be freed with "idset_destroy". Returns NULL on error. */
+idset_t *search_eval (search_info_t *si, const graph_index_t *idx);
 
 #endif /* UTILS_SEARCH_H */
 /* vim: set sw=2 sts=2 et fdm=marker : */
@@ -0,0 +1,387 @@
+/**
+ * collection4 - utils_shmcache.c
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "utils_shmcache.h"
+
+#define SHMCACHE_MAGIC "C4SHMC\0\0"
+#define SHMCACHE_VERSION 1
+
+/* Layout of the file: the header, followed by "entries_num" entry
+ * descriptions, followed by "entries_num" data blocks of "entry_size"
+ * bytes each. */
+struct shmcache_header_s
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t entries_num;
+  uint64_t entry_size;
+  /* Incremented with each access; used to find the least recently used
+   * entry. */
+  uint64_t clock;
+};
+typedef struct shmcache_header_s shmcache_header_t;
+
+struct shmcache_entry_s
+{
+  uint64_t hash;
+  uint64_t last_used;
+  uint32_t data_size;
+  /* Zero if the entry is unused. */
+  uint32_t key_len;
+  char key[SHMCACHE_KEY_MAX];
+};
+typedef struct shmcache_entry_s shmcache_entry_t;
+
+/*
+ * Global variables
+ */
+static char *shmc_file = NULL;
+static int shmc_fd = -1;
+static void *shmc_map = NULL;
+static size_t shmc_map_size = 0;
+static size_t shmc_entries_num = 0;
+static size_t shmc_entry_size = 0;
+
+/*
+ * Private functions
+ */
+#define SHMC_HEADER() ((shmcache_header_t *) shmc_map)
+#define SHMC_ENTRY(i) (((shmcache_entry_t *) (SHMC_HEADER () + 1)) + (i))
+#define SHMC_DATA(i) (((char *) SHMC_ENTRY (shmc_entries_num)) \
+    + ((i) * shmc_entry_size))
+
+static uint64_t shmc_hash (const char *key) /* {{{ */
+{
+  /* 64 bit FNV-1a */
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  const unsigned char *ptr;
+
+  for (ptr = (const unsigned char *) key; *ptr != 0; ptr++)
+  {
+    hash ^= (uint64_t) *ptr;
+    hash *= 0x100000001b3ULL;
+  }
+
+  return (hash);
+} /* }}} uint64_t shmc_hash */
+
+static int shmc_lock (short type) /* {{{ */
+{
+  struct flock fl;
+  int status;
+
+  memset (&fl, 0, sizeof (fl));
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = 0;
+  fl.l_len = 0;
+
+  do
+  {
+    status = fcntl (shmc_fd, F_SETLKW, &fl);
+  } while ((status != 0) && (errno == EINTR));
+
+  if (status != 0)
+  {
+    status = errno;
+    fprintf (stderr, "shmc_lock: fcntl failed: %s\n", strerror (status));
+    return (status);
+  }
+
+  return (0);
+} /* }}} int shmc_lock */
+
+static void shmc_unlock (void) /* {{{ */
+{
+  shmc_lock (F_UNLCK);
+} /* }}} void shmc_unlock */
+
+/* Initializes the file unless another process did so already. Must be
+ * called with the lock held. */
+static void shmc_init_file (void) /* {{{ */
+{
+  shmcache_header_t *hdr = SHMC_HEADER ();
+
+  if ((memcmp (hdr->magic, SHMCACHE_MAGIC, sizeof (hdr->magic)) == 0)
+      && (hdr->version == SHMCACHE_VERSION)
+      && (hdr->entries_num == (uint32_t) shmc_entries_num)
+      && (hdr->entry_size == (uint64_t) shmc_entry_size))
+    return;
+
+  memset (shmc_map, 0, (size_t) ((char *) SHMC_DATA (0) - (char *) shmc_map));
+  memcpy (hdr->magic, SHMCACHE_MAGIC, sizeof (hdr->magic));
+  hdr->version = SHMCACHE_VERSION;
+  hdr->entries_num = (uint32_t) shmc_entries_num;
+  hdr->entry_size = (uint64_t) shmc_entry_size;
+  hdr->clock = 0;
+} /* }}} void shmc_init_file */
+
+static shmcache_entry_t *shmc_find (const char *key, /* {{{ */
+    uint64_t hash, size_t *ret_index)
+{
+  size_t key_len = strlen (key);
+  size_t i;
+
+  for (i = 0; i < shmc_entries_num; i++)
+  {
+    shmcache_entry_t *e = SHMC_ENTRY (i);
+
+    if ((e->key_len == 0) || (e->hash != hash) || (e->key_len != key_len)
+        || (memcmp (e->key, key, key_len) != 0))
+      continue;
+
+    *ret_index = i;
+    return (e);
+  }
+
+  return (NULL);
+} /* }}} shmcache_entry_t *shmc_find */
+
+/*
+ * Public functions
+ */
+int shmcache_open (const char *file, size_t entries_num, /* {{{ */
+    size_t entry_size)
+{
+  struct stat statbuf;
+  char path[PATH_MAX];
+  size_t map_size;
+  int status;
+
+  if ((file == NULL) || (entries_num == 0) || (entry_size == 0)
+      || (entries_num > UINT32_MAX) || (entry_size > UINT32_MAX))
+    return (EINVAL);
+
+  if ((shmc_map != NULL) && (strcmp (shmc_file, file) == 0)
+      && (shmc_entries_num == entries_num)
+      && (shmc_entry_size == entry_size))
+    return (0);
+
+  shmcache_close ();
+
+  map_size = sizeof (shmcache_header_t)
+    + (entries_num * (sizeof (shmcache_entry_t) + entry_size));
+
+  /* The geometry is part of the file name. Processes which have read a
+   * different configuration use a different file, so the file is never
+   * shrunk or reinitialized while another process maps it. */
+  status = snprintf (path, sizeof (path), "%s.%zux%zu",
+      file, entries_num, entry_size);
+  if ((status < 0) || (((size_t) status) >= sizeof (path)))
+    return (ENAMETOOLONG);
+
+  shmc_fd = open (path, O_RDWR | O_CREAT, 0600);
+  if (shmc_fd < 0)
+  {
+    status = errno;
+    fprintf (stderr, "shmcache_open: open (%s) failed: %s\n",
+        path, strerror (status));
+    return (status);
+  }
+
+  shmc_entries_num = entries_num;
+  shmc_entry_size = entry_size;
+
+  status = shmc_lock (F_WRLCK);
+  if (status != 0)
+  {
+    shmcache_close ();
+    return (status);
+  }
+
+  memset (&statbuf, 0, sizeof (statbuf));
+  status = fstat (shmc_fd, &statbuf);
+  /* Grow new files. Never shrink one, other processes may map it. */
+  if ((status == 0) && (((size_t) statbuf.st_size) < map_size))
+    status = ftruncate (shmc_fd, (off_t) map_size);
+  if (status != 0)
+  {
+    status = errno;
+    fprintf (stderr, "shmcache_open: Resizing %s failed: %s\n",
+        path, strerror (status));
+    shmc_unlock ();
+    shmcache_close ();
+    return (status);
+  }
+
+  shmc_map = mmap (/* addr = */ NULL, map_size, PROT_READ | PROT_WRITE,
+      MAP_SHARED, shmc_fd, /* offset = */ 0);
+  if (shmc_map == MAP_FAILED)
+  {
+    status = errno;
+    fprintf (stderr, "shmcache_open: mmap failed: %s\n", strerror (status));
+    shmc_map = NULL;
+    shmc_unlock ();
+    shmcache_close ();
+    return (status);
+  }
+  shmc_map_size = map_size;
+
+  shmc_init_file ();
+  shmc_unlock ();
+
+  shmc_file = strdup (file);
+  if (shmc_file == NULL)
+  {
+    shmcache_close ();
+    return (ENOMEM);
+  }
+
+  return (0);
+} /* }}} int shmcache_open */
+
+void shmcache_close (void) /* {{{ */
+{
+  if (shmc_map != NULL)
+    munmap (shmc_map, shmc_map_size);
+  shmc_map = NULL;
+  shmc_map_size = 0;
+
+  if (shmc_fd >= 0)
+    close (shmc_fd);
+  shmc_fd = -1;
+
+  free (shmc_file);
+  shmc_file = NULL;
+
+  shmc_entries_num = 0;
+  shmc_entry_size = 0;
+} /* }}} void shmcache_close */
+
+int shmcache_get (const char *key, void **ret_data, /* {{{ */
+    size_t *ret_size)
+{
+  shmcache_entry_t *e;
+  size_t index;
+  void *data;
+  int status;
+
+  if ((key == NULL) || (ret_data == NULL) || (ret_size == NULL))
+    return (EINVAL);
+
+  if (shmc_map == NULL)
+    return (ENOENT);
+
+  status = shmc_lock (F_WRLCK);
+  if (status != 0)
+    return (status);
+
+  e = shmc_find (key, shmc_hash (key), &index);
+  if (e == NULL)
+  {
+    shmc_unlock ();
+    return (ENOENT);
+  }
+
+  data = malloc ((e->data_size > 0) ? e->data_size : 1);
+  if (data == NULL)
+  {
+    shmc_unlock ();
+    return (ENOMEM);
+  }
+  memcpy (data, SHMC_DATA (index), e->data_size);
+  *ret_size = e->data_size;
+
+  SHMC_HEADER ()->clock++;
+  e->last_used = SHMC_HEADER ()->clock;
+
+  shmc_unlock ();
+
+  *ret_data = data;
+  return (0);
+} /* }}} int shmcache_get */
+
+int shmcache_put (const char *key, const void *data, /* {{{ */
+    size_t data_size)
+{
+  shmcache_entry_t *e;
+  uint64_t hash;
+  size_t key_len;
+  size_t index;
+  int status;
+
+  if ((key == NULL) || ((data == NULL) && (data_size > 0)))
+    return (EINVAL);
+
+  if (shmc_map == NULL)
+    return (ENOENT);
+
+  key_len = strlen (key);
+  if ((key_len == 0) || (key_len >= SHMCACHE_KEY_MAX)
+      || (data_size > shmc_entry_size))
+    return (EMSGSIZE);
+
+  hash = shmc_hash (key);
+
+  status = shmc_lock (F_WRLCK);
+  if (status != 0)
+    return (status);
+
+  e = shmc_find (key, hash, &index);
+  if (e == NULL)
+  {
+    size_t i;
+
+    /* Use an unused entry or the least recently used one. */
+    index = 0;
+    for (i = 0; i < shmc_entries_num; i++)
+    {
+      if (SHMC_ENTRY (i)->key_len == 0)
+      {
+        index = i;
+        break;
+      }
+
+      if (SHMC_ENTRY (i)->last_used < SHMC_ENTRY (index)->last_used)
+        index = i;
+    }
+    e = SHMC_ENTRY (index);
+  }
+
+  if (data_size > 0)
+    memcpy (SHMC_DATA (index), data, data_size);
+  e->hash = hash;
+  e->data_size = (uint32_t) data_size;
+  e->key_len = (uint32_t) key_len;
+  memcpy (e->key, key, key_len + 1);
+
+  SHMC_HEADER ()->clock++;
+  e->last_used = SHMC_HEADER ()->clock;
+
+  shmc_unlock ();
+  return (0);
+} /* }}} int shmcache_put */
+
+/* vim: set sw=2 sts=2 et fdm=marker : */
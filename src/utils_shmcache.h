@@ -0,0 +1,58 @@
+/**
+ * collection4 - utils_shmcache.h
+ * Copyright (C) 2010  Florian octo Forster
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *   Florian octo Forster <ff at octo.it>
+ **/
+
+#ifndef UTILS_SHMCACHE_H
+#define UTILS_SHMCACHE_H 1
+
+#include <stddef.h>
+
+/*
+ * Cache of small blobs, e.g. response bodies, in a memory mapped file shared
+ * by all FastCGI processes. The cache has a fixed number of entries of a
+ * fixed maximum size; when it is full, the least recently used entry is
+ * replaced. Access is serialized with an fcntl(2) lock on the file.
+ */
+
+/* Maximum length of a key, including the terminating null byte. */
+#define SHMCACHE_KEY_MAX 512
+
+/* Maps the cache file, creating and initializing it if necessary. The number
+ * of entries and their size are appended to "file", so processes using a
+ * different geometry use a different file. Calling this function again with
+ * the same arguments is a no-op; different arguments close the current cache
+ * first. */
+int shmcache_open (const char *file, size_t entries_num, size_t entry_size);
+void shmcache_close (void);
+
+/* Looks up "key". On success, "ret_data" points to a copy of the data which
+ * has to be freed by the caller. Returns ENOENT if the key is not in the
+ * cache. */
+int shmcache_get (const char *key, void **ret_data, size_t *ret_size);
+
+/* Stores "data" under "key", replacing an existing entry with the same key or
+ * the least recently used entry. Returns EMSGSIZE if "data" or "key" is too
+ * large. */
+int shmcache_put (const char *key, const void *data, size_t data_size);
+
+#endif /* UTILS_SHMCACHE_H */
+/* vim: set sw=2 sts=2 et fdm=marker : */